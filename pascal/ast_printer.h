@@ -27,7 +27,8 @@ class Printer : public Visitor {
       assert(binary_op->type_checked());
     if (binary_op->type_checked()) {
       pre_print_depth() << "BinaryOperation: "
-                        << ValueAST::type_to_string(binary_op->type()) << '\n';
+                        << ValueAST::type_to_string(binary_op->type())
+                        << (binary_op->checked() ? "" : " unchecked") << '\n';
     } else {
       pre_print_depth() << "BinaryOperation\n";
     }
@@ -50,7 +51,8 @@ class Printer : public Visitor {
       assert(unary_op->type_checked());
     if (unary_op->type_checked()) {
       pre_print_depth() << "UnaryOperation: "
-                        << ValueAST::type_to_string(unary_op->type()) << '\n';
+                        << ValueAST::type_to_string(unary_op->type())
+                        << (unary_op->checked() ? "" : " unchecked") << '\n';
     } else {
       pre_print_depth() << "UnaryOperation\n";
     }
@@ -77,6 +79,18 @@ class Printer : public Visitor {
       pre_print_depth() << "Value: " << std::get<double>(number->value())
                         << '\n';
       return 0;
+    } else if (std::holds_alternative<int64_t>(number->value())) {
+      pre_print_depth() << "Value: " << std::get<int64_t>(number->value())
+                        << '\n';
+      return 0;
+    } else if (std::holds_alternative<String>(number->value())) {
+      pre_print_depth() << "Value: "
+                        << std::get<String>(number->value()).to_string()
+                        << '\n';
+      return 0;
+    } else if (std::holds_alternative<void*>(number->value())) {
+      pre_print_depth() << "Value: NIL\n";
+      return 0;
     } else {
       pre_print_depth() << "Value: " << std::get<int>(number->value()) << '\n';
       return 0;
@@ -110,6 +124,33 @@ class Printer : public Visitor {
 
   Value visit(const Pascal::Variable* variable) override {
     pre_print_depth() << "Value: " << variable->value() << '\n';
+    if (!variable->indices().empty()) {
+      ++depth_;
+      pre_print_depth() << "Indices"
+                        << (variable->checked() ? "" : " unchecked") << ": \n";
+      for (const auto& index : variable->indices()) {
+        index->accept(this);
+      }
+      --depth_;
+    }
+    if (!variable->fields().empty()) {
+      ++depth_;
+      pre_print_depth() << "Field:";
+      for (const auto& field : variable->fields()) {
+        std::cout << ' ' << field;
+      }
+      std::cout << " at " << variable->offset() << '\n';
+      --depth_;
+    }
+    for (const auto& dereference : variable->dereferences()) {
+      ++depth_;
+      pre_print_depth() << "Dereference:";
+      for (const auto& field : dereference.fields) {
+        std::cout << ' ' << field;
+      }
+      std::cout << " at " << dereference.offset << '\n';
+      --depth_;
+    }
     return 0;
   }
 
@@ -175,10 +216,224 @@ class Printer : public Visitor {
   void visit(const Pascal::ProcedureDeclaration* procedure_decl) override {
     pre_print_depth() << "ProcedureDeclaration\n";
     pre_print_depth() << "name: " << procedure_decl->name() << '\n';
+    if (procedure_decl->is_function()) {
+      pre_print_depth() << "Return type: \n";
+      ++depth_;
+      procedure_decl->return_type()->accept(this);
+      --depth_;
+    }
 
     ++depth_;
-    pre_print_depth() << "Block: \n";
-    procedure_decl->block()->accept(this);
+    pre_print_depth() << procedure_decl->parameters().size()
+                      << " parameters: \n";
+    for (const auto& parameter : procedure_decl->parameters()) {
+      parameter->accept(this);
+    }
+    --depth_;
+
+    ++depth_;
+    if (procedure_decl->parsed()) {
+      pre_print_depth() << "Block: \n";
+      procedure_decl->block()->accept(this);
+    } else {
+      pre_print_depth() << "Block: (not parsed yet)\n";
+    }
+    --depth_;
+  }
+
+  void visit(const Pascal::Parameter* parameter) override {
+    pre_print_depth() << (parameter->by_reference() ? "VAR " : "")
+                      << "Parameter\n";
+
+    ++depth_;
+    parameter->variable()->accept(this);
+    parameter->type()->accept(this);
+    --depth_;
+  }
+
+  void visit(const Pascal::ProcedureCall* call) override {
+    pre_print_depth() << (call->tail() ? "Tail " : "") << "ProcedureCall\n";
+    pre_print_depth() << "name: " << call->name() << '\n';
+
+    ++depth_;
+    pre_print_depth() << "Arguments: \n";
+    for (const auto& argument : call->arguments()) {
+      argument->accept(this);
+    }
+    --depth_;
+  }
+
+  Value visit(const Pascal::FunctionCall* call) override {
+    if (type_checked_)
+      assert(call->type_checked());
+    pre_print_depth() << (call->tail() ? "Tail " : "") << "FunctionCall";
+    if (call->type_checked()) {
+      std::cout << ": " << ValueAST::type_to_string(call->type());
+    }
+    std::cout << '\n';
+    pre_print_depth() << "name: " << call->name() << '\n';
+
+    ++depth_;
+    pre_print_depth() << "Arguments: \n";
+    for (const auto& argument : call->arguments()) {
+      argument->accept(this);
+    }
+    --depth_;
+
+    return 0;
+  }
+
+  Value visit(const Pascal::SetConstructor* constructor) override {
+    if (type_checked_)
+      assert(constructor->type_checked());
+    pre_print_depth() << "SetConstructor";
+    if (constructor->constant().has_value()) {
+      std::cout << ": " << constructor->constant()->to_string();
+    }
+    std::cout << '\n';
+
+    ++depth_;
+    pre_print_depth() << "Elements: \n";
+    for (const auto& element : constructor->elements()) {
+      element.low->accept(this);
+      if (element.high != nullptr) {
+        pre_print_depth() << "..\n";
+        element.high->accept(this);
+      }
+    }
+    --depth_;
+
+    return 0;
+  }
+
+  void visit(const Pascal::If* statement) override {
+    pre_print_depth() << "If\n";
+
+    ++depth_;
+    pre_print_depth() << "Condition: \n";
+    statement->condition()->accept(this);
+    pre_print_depth() << "Then: \n";
+    statement->then_statement()->accept(this);
+    if (statement->else_statement() != nullptr) {
+      pre_print_depth() << "Else: \n";
+      statement->else_statement()->accept(this);
+    }
+    --depth_;
+  }
+
+  void visit(const Pascal::While* loop) override {
+    pre_print_depth() << "While\n";
+
+    ++depth_;
+    pre_print_depth() << "Condition: \n";
+    loop->condition()->accept(this);
+    pre_print_depth() << "Body: \n";
+    loop->body()->accept(this);
+    --depth_;
+  }
+
+  void visit(const Pascal::Repeat* loop) override {
+    pre_print_depth() << "Repeat\n";
+
+    ++depth_;
+    pre_print_depth() << "Body: \n";
+    loop->body()->accept(this);
+    pre_print_depth() << "Until: \n";
+    loop->condition()->accept(this);
+    --depth_;
+  }
+
+  void visit(const Pascal::For* loop) override {
+    pre_print_depth() << (loop->kernel() != nullptr ? "Vector "
+                          : loop->counted()         ? "Counted "
+                                                    : "")
+                      << "For "
+                      << (loop->down() ? "DOWNTO" : "TO") << '\n';
+
+    ++depth_;
+    pre_print_depth() << "Variable: \n";
+    loop->variable()->accept(this);
+    pre_print_depth() << "Start: \n";
+    loop->start()->accept(this);
+    pre_print_depth() << "End: \n";
+    loop->end()->accept(this);
+    pre_print_depth() << "Body: \n";
+    loop->body()->accept(this);
+    --depth_;
+  }
+
+  void visit(const Pascal::Case* statement) override {
+    static constexpr const char* DISPATCH[] = {"Linear", "Table", "Search"};
+    pre_print_depth() << DISPATCH[static_cast<int>(statement->dispatch())]
+                      << " Case\n";
+
+    ++depth_;
+    pre_print_depth() << "Selector: \n";
+    statement->selector()->accept(this);
+    for (const auto& branch : statement->branches()) {
+      pre_print_depth() << "Labels:";
+      for (const auto& label : branch.labels) {
+        std::cout << ' ' << label.low;
+        if (label.high != label.low) {
+          std::cout << ".." << label.high;
+        }
+      }
+      std::cout << '\n';
+      branch.statement->accept(this);
+    }
+    if (statement->else_statement() != nullptr) {
+      pre_print_depth() << "Else: \n";
+      statement->else_statement()->accept(this);
+    }
+    --depth_;
+  }
+
+  void visit(const Pascal::HeapOperation* operation) override {
+    pre_print_depth()
+        << (operation->op() == HeapOperation::Operator::NEW ? "New"
+                                                            : "Dispose")
+        << '\n';
+
+    ++depth_;
+    operation->variable()->accept(this);
+    --depth_;
+  }
+
+  void visit(const Pascal::Write* write) override {
+    pre_print_depth() << (write->line() ? "WriteLn\n" : "Write\n");
+
+    ++depth_;
+    for (const auto& argument : write->arguments()) {
+      argument.value->accept(this);
+      if (argument.width != nullptr) {
+        pre_print_depth() << "Width: \n";
+        argument.width->accept(this);
+      }
+      if (argument.precision != nullptr) {
+        pre_print_depth() << "Precision: \n";
+        argument.precision->accept(this);
+      }
+    }
+    --depth_;
+  }
+
+  void visit(const Pascal::Read* read) override {
+    pre_print_depth() << (read->line() ? "ReadLn\n" : "Read\n");
+
+    ++depth_;
+    for (const auto& variable : read->variables()) {
+      variable->accept(this);
+    }
+    --depth_;
+  }
+
+  void visit(const Pascal::Reset* reset) override {
+    pre_print_depth() << "Reset\n";
+
+    ++depth_;
+    reset->variable()->accept(this);
+    pre_print_depth() << "Path: \n";
+    reset->path()->accept(this);
     --depth_;
   }
 
@@ -0,0 +1,62 @@
+// Copyright 2023 Zhu Junhui
+
+#include "batch_runner.h"
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include "output.h"
+
+namespace Pascal {
+
+BatchRunner::BatchRunner(std::shared_ptr<const CompiledProgram> program,
+                         ThreadPool* pool)
+    : program_(std::move(program)), pool_(pool), contexts_(pool->size()) {}
+
+size_t BatchRunner::run(size_t count, const Prepare& prepare,
+                        const Collect& collect,
+                        std::span<std::string> outputs,
+                        std::span<std::string> errors) {
+  if ((!outputs.empty() && outputs.size() != count) ||
+      (!errors.empty() && errors.size() != count)) {
+    throw std::runtime_error("a batch of " + std::to_string(count) +
+                             " records needs a slot per record");
+  }
+  std::atomic<size_t> failed = 0;
+  pool_->parallel_for(
+      (count + CHUNK - 1) / CHUNK, [&](size_t chunk, size_t worker) {
+        auto& context = contexts_[worker];
+        if (context == nullptr) {
+          context = std::make_unique<ExecutionContext>(program_);
+        }
+        size_t failures = 0;
+        const size_t end = std::min(count, (chunk + 1) * CHUNK);
+        for (size_t record = chunk * CHUNK; record < end; ++record) {
+          StringSink sink(outputs.empty() ? nullptr : &outputs[record]);
+          if (!outputs.empty()) {
+            context->set_output(&sink);
+          }
+          // tasks of the pool must not throw
+          try {
+            if (prepare != nullptr) {
+              prepare(context.get(), record);
+            }
+            context->run();
+            if (collect != nullptr) {
+              collect(*context, record);
+            }
+          } catch (const std::exception& error) {
+            ++failures;
+            if (!errors.empty()) {
+              errors[record] = error.what();
+            }
+          }
+          if (!outputs.empty()) {
+            context->set_output(nullptr);
+          }
+        }
+        failed += failures;
+      });
+  return failed;
+}
+
+}  // namespace Pascal
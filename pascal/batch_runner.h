@@ -0,0 +1,57 @@
+// Copyright 2023 Zhu Junhui
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+#include "compiled_program.h"
+#include "thread_pool.h"
+
+namespace Pascal {
+
+// Runs one compiled program once per record on the workers of a pool.
+// Records are handed out in chunks, which idle workers steal from busy
+// ones. Every worker keeps one ExecutionContext for all the records it
+// runs, in this and later batches, so a record costs its run and nothing
+// else.
+class BatchRunner {
+ public:
+  // records handed out at a time
+  static constexpr size_t CHUNK = 64;
+
+  // before the run of a record: bind its memory or set its input
+  using Prepare = std::function<void(ExecutionContext* context, size_t record)>;
+
+  // after a run that did not fail: read what it computed, e.g. into the
+  // record's slot of an array the caller allocated
+  using Collect =
+      std::function<void(const ExecutionContext& context, size_t record)>;
+
+ private:
+  std::shared_ptr<const CompiledProgram> program_;
+  ThreadPool* pool_;
+
+  // by worker, made by the worker itself on its first record
+  std::vector<std::unique_ptr<ExecutionContext>> contexts_;
+
+ public:
+  BatchRunner(std::shared_ptr<const CompiledProgram> program,
+              ThreadPool* pool);
+
+  // Run the program for records 0 to count - 1 and return how many runs
+  // failed; prepare and collect are called on the workers, for different
+  // records at once. What the run of record i writes is appended to
+  // outputs[i] and the message it fails with to errors[i], unless those
+  // are empty; otherwise the text goes to stdout as runs end. Not
+  // reentrant: one batch at a time.
+  size_t run(size_t count, const Prepare& prepare,
+             const Collect& collect = nullptr,
+             std::span<std::string> outputs = {},
+             std::span<std::string> errors = {});
+};
+
+}  // namespace Pascal
@@ -0,0 +1,209 @@
+// Copyright 2023 Zhu Junhui
+
+#pragma once
+
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include "value_ast.h"
+
+namespace Pascal {
+
+// A value of any scalar type in 8 bytes, for the paths that do not know
+// the type of what they read: the globals dump and the host API. The
+// interpreter itself keeps raw slots, whose types the analyzer fixed.
+//
+// A REAL is stored as itself, a NaN as one canonical quiet NaN. Every
+// other value lives in the 48-bit payload of a negative quiet NaN, which
+// no stored REAL is, with a 3-bit tag above it: INTEGER and BOOLEAN values
+// and INT64 values of up to 48 bits directly, wider INT64 values, sets
+// and strings as pointers to where the run keeps them, and POINTER values
+// as themselves. So whether a cell is a REAL, or has a given tag, is a
+// single mask compare.
+class Boxed {
+ private:
+  static constexpr uint64_t BOXED = 0xFFF8'0000'0000'0000;
+  static constexpr uint64_t TAG_MASK = 0xFFFF'0000'0000'0000;
+  static constexpr uint64_t PAYLOAD = 0x0000'FFFF'FFFF'FFFF;
+  static constexpr uint64_t CANONICAL_NAN = 0x7FF8'0000'0000'0000;
+  static constexpr int TAG_SHIFT = 48;
+
+  enum class Tag : uint64_t {
+    INTEGER = 1,
+    BOOLEAN,
+    INT64,
+    // an INT64 that needs more than 48 bits
+    WIDE_INT64,
+    SET,
+    STRING,
+    POINTER,
+  };
+
+  uint64_t bits_ = CANONICAL_NAN;
+
+  static constexpr uint64_t header(Tag tag) {
+    return BOXED | static_cast<uint64_t>(tag) << TAG_SHIFT;
+  }
+
+  static Boxed tagged(Tag tag, uint64_t payload) {
+    Boxed cell;
+    cell.bits_ = header(tag) | (payload & PAYLOAD);
+    return cell;
+  }
+
+  bool is(Tag tag) const { return (bits_ & TAG_MASK) == header(tag); }
+
+  // the payload as a signed 48-bit integer
+  int64_t signed_payload() const {
+    return static_cast<int64_t>(bits_ << (64 - TAG_SHIFT)) >>
+           (64 - TAG_SHIFT);
+  }
+
+  template <class T>
+  const T* pointer() const {
+    return reinterpret_cast<const T*>(bits_ & PAYLOAD);
+  }
+
+ public:
+  static Boxed from_real(double value) {
+    Boxed cell;
+    if (!std::isnan(value)) {
+      cell.bits_ = std::bit_cast<uint64_t>(value);
+    }
+    return cell;
+  }
+
+  static Boxed from_integer(int value) {
+    return tagged(Tag::INTEGER, static_cast<uint32_t>(value));
+  }
+
+  static Boxed from_boolean(bool value) {
+    return tagged(Tag::BOOLEAN, value);
+  }
+
+  // value is only read if it needs more than 48 bits, and then has to
+  // outlive the cell
+  static Boxed from_int64(const int64_t* value) {
+    constexpr int64_t LIMIT = int64_t{1} << (TAG_SHIFT - 1);
+    if (*value >= -LIMIT && *value < LIMIT) {
+      return tagged(Tag::INT64, static_cast<uint64_t>(*value));
+    }
+    return tagged(Tag::WIDE_INT64, reinterpret_cast<uintptr_t>(value));
+  }
+
+  // the set or string has to outlive the cell
+  static Boxed from_set(const Set* value) {
+    return tagged(Tag::SET, reinterpret_cast<uintptr_t>(value));
+  }
+
+  static Boxed from_string(const String* value) {
+    return tagged(Tag::STRING, reinterpret_cast<uintptr_t>(value));
+  }
+
+  // the block NEW allocated, nullptr for NIL
+  static Boxed from_pointer(const void* value) {
+    return tagged(Tag::POINTER, reinterpret_cast<uintptr_t>(value));
+  }
+
+  bool is_real() const { return (bits_ & BOXED) != BOXED; }
+
+  ValueAST::ValueType type() const {
+    if (is_real()) {
+      return ValueAST::ValueType::REAL;
+    }
+    switch (static_cast<Tag>((bits_ & TAG_MASK & ~BOXED) >> TAG_SHIFT)) {
+      case Tag::INTEGER:
+        return ValueAST::ValueType::INTEGER;
+      case Tag::BOOLEAN:
+        return ValueAST::ValueType::BOOLEAN;
+      case Tag::INT64:
+      case Tag::WIDE_INT64:
+        return ValueAST::ValueType::INT64;
+      case Tag::SET:
+        return ValueAST::ValueType::SET;
+      case Tag::POINTER:
+        return ValueAST::ValueType::POINTER;
+      default:
+        return ValueAST::ValueType::STRING;
+    }
+  }
+
+  double real() const { return std::bit_cast<double>(bits_); }
+
+  int integer() const { return static_cast<int>(bits_ & 0xFFFF'FFFF); }
+
+  bool boolean() const { return (bits_ & 1) != 0; }
+
+  int64_t int64() const {
+    return is(Tag::INT64) ? signed_payload() : *pointer<int64_t>();
+  }
+
+  const Set& set() const { return *pointer<Set>(); }
+
+  const String& string() const { return *pointer<String>(); }
+
+  const void* address() const { return pointer<void>(); }
+
+  // the value as the interpreter computes it; a BOOLEAN is 0 or 1
+  ValueAST::Value value() const {
+    switch (type()) {
+      case ValueAST::ValueType::REAL:
+        return real();
+      case ValueAST::ValueType::INTEGER:
+        return integer();
+      case ValueAST::ValueType::BOOLEAN:
+        return static_cast<int>(boolean());
+      case ValueAST::ValueType::INT64:
+        return int64();
+      case ValueAST::ValueType::SET:
+        return set();
+      case ValueAST::ValueType::POINTER:
+        return const_cast<void*>(address());
+      default:
+        return string();
+    }
+  }
+
+  // cells are equal if they hold the same value of the same type
+  bool operator==(const Boxed& other) const {
+    if (bits_ == other.bits_) {
+      return true;
+    }
+    return type() == other.type() && value() == other.value();
+  }
+
+  std::string to_string() const {
+    switch (type()) {
+      case ValueAST::ValueType::REAL: {
+        char text[32];
+        const auto end = std::to_chars(text, text + sizeof(text), real()).ptr;
+        return std::string(text, end);
+      }
+      case ValueAST::ValueType::INTEGER:
+        return std::to_string(integer());
+      case ValueAST::ValueType::BOOLEAN:
+        return boolean() ? "TRUE" : "FALSE";
+      case ValueAST::ValueType::INT64:
+        return std::to_string(int64());
+      case ValueAST::ValueType::SET:
+        return set().to_string();
+      case ValueAST::ValueType::POINTER: {
+        if (address() == nullptr) {
+          return "NIL";
+        }
+        char text[24] = "0x";
+        const auto end = std::to_chars(text + 2, text + sizeof(text),
+                                       bits_ & PAYLOAD, 16).ptr;
+        return std::string(text, end);
+      }
+      default:
+        return string().to_string();
+    }
+  }
+};
+
+static_assert(sizeof(Boxed) == 8);
+
+}  // namespace Pascal
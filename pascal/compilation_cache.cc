@@ -0,0 +1,39 @@
+// Copyright 2023 Zhu Junhui
+
+#include "compilation_cache.h"
+#include <utility>
+
+namespace Pascal {
+
+std::optional<CompilationCache::Body> CompilationCache::find(const Key& key) {
+  std::lock_guard lock(mutex_);
+  if (auto it = blocks_.find(key); it != blocks_.end()) {
+    it->second.used = true;
+    return it->second.body;
+  }
+  return std::nullopt;
+}
+
+void CompilationCache::insert(const Key& key, Body body) {
+  std::lock_guard lock(mutex_);
+  blocks_[key] = Entry{std::move(body), true};
+}
+
+void CompilationCache::sweep() {
+  std::lock_guard lock(mutex_);
+  for (auto it = blocks_.begin(); it != blocks_.end();) {
+    if (!it->second.used) {
+      it = blocks_.erase(it);
+    } else {
+      it->second.used = false;
+      ++it;
+    }
+  }
+}
+
+size_t CompilationCache::size() {
+  std::lock_guard lock(mutex_);
+  return blocks_.size();
+}
+
+}  // namespace Pascal
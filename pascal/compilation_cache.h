@@ -0,0 +1,63 @@
+// Copyright 2023 Zhu Junhui
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ast.h"
+
+namespace Pascal {
+
+// Checked procedure bodies kept across reloads of a program. A body is
+// reused when both its tokens and the scopes it was declared in are
+// unchanged, so an edit only re-parses and re-checks the procedures it
+// touches and those whose view of the enclosing declarations changed.
+class CompilationCache {
+ public:
+  struct Key {
+    uint64_t body;
+    uint64_t scope;
+
+    bool operator==(const Key&) const = default;
+  };
+
+  struct Body {
+    std::shared_ptr<Block> block;
+
+    // pre-parsed procedures outside the body that it calls; they must be
+    // checked as well when the body is reused
+    std::vector<std::string> callees;
+  };
+
+ private:
+  struct KeyHash {
+    size_t operator()(const Key& key) const {
+      return hash_combine(key.body, key.scope);
+    }
+  };
+
+  struct Entry {
+    Body body;
+    bool used;
+  };
+
+  std::mutex mutex_;
+  std::unordered_map<Key, Entry, KeyHash> blocks_;
+
+ public:
+  std::optional<Body> find(const Key& key);
+
+  void insert(const Key& key, Body body);
+
+  // drop bodies not used since the previous sweep, e.g. after a reload
+  void sweep();
+
+  size_t size();
+};
+
+}  // namespace Pascal
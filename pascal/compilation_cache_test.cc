@@ -0,0 +1,106 @@
+// Copyright 2023 Zhu Junhui
+
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include "compiled_program.h"
+
+// Reloads edited versions of one program through a CompilationCache and
+// checks that only the procedures an edit touches get new bodies: the
+// edited procedure and those declared inside it. Every other procedure has
+// to come back with the very block the previous version checked.
+
+namespace {
+
+// A holds B and C; D and E are its siblings
+std::string source(const std::string& a_locals, const std::string& e_body) {
+  return "PROGRAM Reload; "
+         "VAR g : INTEGER; "
+         "PROCEDURE A; "
+         "VAR " + a_locals + " : INTEGER; "
+         "PROCEDURE B; BEGIN x := x + 1 END; "
+         "PROCEDURE C; BEGIN B; B; g := g + x END; "
+         "BEGIN x := 10; C END; "
+         "PROCEDURE D; BEGIN g := g * 2 END; "
+         "PROCEDURE E; BEGIN " + e_body + " END; "
+         "BEGIN g := 1; A; D; E END.";
+}
+
+using Blocks = std::map<std::string, const Pascal::Block*>;
+
+void collect(const Pascal::Block& block, Blocks* blocks) {
+  for (const auto& procedure : block.procedures_declarations()) {
+    (*blocks)[procedure->name()] = procedure->shared_block().get();
+    if (procedure->parsed()) {
+      collect(*procedure->block(), blocks);
+    }
+  }
+}
+
+Blocks blocks(const Pascal::CompiledProgram& program) {
+  Blocks blocks;
+  collect(*program.program().block(), &blocks);
+  return blocks;
+}
+
+std::string global(std::shared_ptr<const Pascal::CompiledProgram> program) {
+  Pascal::ExecutionContext context(std::move(program));
+  context.run();
+  return context.global("g").to_string();
+}
+
+// the procedures whose block changed from before to after, or "?" for one
+// that is not checked at all
+std::string changed(const Blocks& before, const Blocks& after) {
+  std::string names;
+  for (const auto& [name, block] : after) {
+    if (block == nullptr) {
+      names += "?";
+    } else if (before.at(name) != block) {
+      names += name;
+    }
+  }
+  return names;
+}
+
+bool expect(const std::string& what, const std::string& actual,
+            const std::string& expected) {
+  if (actual == expected) {
+    return true;
+  }
+  std::cerr << what << ": " << actual << " instead of " << expected << "\n";
+  return false;
+}
+
+}  // namespace
+
+int main() {
+  Pascal::CompilationCache cache;
+  const Pascal::CompileOptions options{.cache = &cache};
+
+  const auto first =
+      Pascal::CompiledProgram::reload(source("x", "g := g + 3"), options);
+  // an edit of E's body
+  const auto second =
+      Pascal::CompiledProgram::reload(source("x", "g := g - 3"), options);
+  // an edit of the declarations around B and C
+  const auto third =
+      Pascal::CompiledProgram::reload(source("x, y", "g := g - 3"), options);
+
+  bool ok = expect("first run", global(first), "29");
+  ok &= expect("second run", global(second), "23");
+  ok &= expect("third run", global(third), "23");
+  ok &= expect("checked first", changed(blocks(*first), blocks(*first)), "");
+  ok &= expect("reparsed after editing E",
+               changed(blocks(*first), blocks(*second)), "E");
+  ok &= expect("reparsed after editing A's variables",
+               changed(blocks(*second), blocks(*third)), "ABC");
+  // B and C are parsed with A, only A, D and E are cached
+  ok &= expect("cached bodies", std::to_string(cache.size()), "3");
+  if (!ok) {
+    return 1;
+  }
+  std::cout << "reloads reparse only the edited procedures\n";
+  return 0;
+}
@@ -0,0 +1,107 @@
+// Copyright 2023 Zhu Junhui
+
+#include "compiled_program.h"
+#include <stdexcept>
+#include "parser.h"
+#include "semantic_analyzer.h"
+
+namespace Pascal {
+
+std::shared_ptr<const CompiledProgram> CompiledProgram::compile(
+    std::string source, const CompileOptions& options) {
+  // only pre-parsed bodies are looked up in the cache
+  Parser parser(std::move(source));
+  parser.set_lazy_procedures(options.lazy || options.cache != nullptr);
+  auto program = parser.parse();
+
+  // a pre-parsed body is parsed and checked here once it is referenced,
+  // so the runs never touch one that is not
+  SemanticAnalyzer analyzer;
+  analyzer.set_thread_pool(options.pool);
+  analyzer.set_optimize(options.optimize);
+  analyzer.set_host_functions(options.functions.get());
+  analyzer.set_cache(options.cache);
+  analyzer.analyze(program.get());
+
+  return std::shared_ptr<const CompiledProgram>(
+      new CompiledProgram(options.functions, std::move(program)));
+}
+
+std::shared_ptr<const CompiledProgram> CompiledProgram::reload(
+    std::string source, const CompileOptions& options) {
+  if (options.cache == nullptr) {
+    throw std::runtime_error("reload needs a compilation cache");
+  }
+  // a version that fails to compile leaves the cache as it was
+  auto program = compile(std::move(source), options);
+  options.cache->sweep();
+  return program;
+}
+
+void ExecutionContext::bind(const std::string& name, const Host& host) {
+  const VariableDeclaration* declaration = nullptr;
+  const Variable* variable = nullptr;
+  for (const auto& candidate :
+       program_->program().block()->var_declarations()) {
+    for (const auto& declared : candidate->variables()) {
+      if (declared->value() == name) {
+        declaration = candidate.get();
+        variable = declared.get();
+      }
+    }
+  }
+  if (variable == nullptr) {
+    throw std::runtime_error("global variable " + name + " not found");
+  }
+
+  // the host value, or each element of the host array, has to be stored
+  // like the variable, or each of its elements
+  const auto type = declaration->type();
+  const auto& array = type->array();
+  if (host.array != (array != nullptr)) {
+    throw std::runtime_error("global variable " + name + " of type " +
+                             type->to_string() + " cannot be bound to " +
+                             (host.array ? "an array" : "a single value"));
+  }
+  const auto element = array != nullptr ? array->element : type->value();
+  const auto& record = array != nullptr ? array->record : type->record();
+  const bool plain =
+      record != nullptr
+          ? record->plain() && (array == nullptr || !array->packed)
+          : Pascal::plain(element, array != nullptr ? array->range
+                                                    : type->range(),
+                          array == nullptr && type->packed());
+  int64_t size = scalar_size(element, std::nullopt, false);
+  if (array != nullptr) {
+    size = array->element_size();
+  } else if (record != nullptr) {
+    size = record->size;
+  }
+  if (!plain || element != host.type ||
+      size != static_cast<int64_t>(host.size)) {
+    throw std::runtime_error("global variable " + name + " of type " +
+                             type->to_string() +
+                             " cannot be bound to this host memory");
+  }
+  if (array != nullptr && static_cast<int64_t>(host.count) != array->size()) {
+    throw std::runtime_error("global variable " + name + " has " +
+                             std::to_string(array->size()) +
+                             " elements, not " + std::to_string(host.count));
+  }
+
+  const auto begin = static_cast<const std::byte*>(host.data);
+  const auto end = begin + host.size * host.count;
+  for (const auto& other : bound_) {
+    if (other.name != name && begin < other.end && other.begin < end) {
+      throw std::runtime_error("host memory of " + name +
+                               " overlaps that of " + other.name);
+    }
+  }
+  std::erase_if(bound_,
+                [&](const Bound& other) { return other.name == name; });
+  bound_.push_back({name, begin, end});
+  interpreter_.bind(variable->slot(), host.data,
+                    record != nullptr || array != nullptr ? 0 : host.size);
+}
+
+}  // namespace Pascal
@@ -0,0 +1,156 @@
+// Copyright 2023 Zhu Junhui
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include "ast.h"
+#include "boxed_value.h"
+#include "compilation_cache.h"
+#include "host_function.h"
+#include "interpreter.h"
+#include "output.h"
+#include "thread_pool.h"
+
+namespace Pascal {
+
+struct CompileOptions {
+  // only pre-parse procedure bodies until they are referenced
+  bool lazy = false;
+  // run the Optimizer over every checked block
+  bool optimize = true;
+  // checks the procedures of large blocks in parallel if set
+  ThreadPool* pool = nullptr;
+  // C++ functions the program may call; the compiled program keeps them
+  std::shared_ptr<const HostFunctions> functions = nullptr;
+  // checked procedure bodies shared with earlier and later compilations,
+  // see reload; procedures are pre-parsed when it is set
+  CompilationCache* cache = nullptr;
+};
+
+// A program parsed and analyzed once. Running it only reads the checked
+// tree; every run keeps its variables, strings, heap blocks and files in
+// its own ExecutionContext. So one compiled program may run on any number
+// of threads at once, with no locking.
+class CompiledProgram {
+ private:
+  // the checked calls point to the host functions
+  std::shared_ptr<const HostFunctions> functions_;
+  std::unique_ptr<Program> program_;
+
+  CompiledProgram(std::shared_ptr<const HostFunctions> functions,
+                  std::unique_ptr<Program> program)
+      : functions_(std::move(functions)), program_(std::move(program)) {}
+
+ public:
+  // throws std::runtime_error if source does not parse or check
+  static std::shared_ptr<const CompiledProgram> compile(
+      std::string source, const CompileOptions& options = {});
+
+  // compile a version of a program whose earlier versions were loaded
+  // into options.cache, this way too: only the procedures whose text or
+  // enclosing declarations changed are parsed and checked again, the
+  // others reuse their checked bodies. The cache then keeps the bodies of
+  // this version and drops those only earlier ones used.
+  static std::shared_ptr<const CompiledProgram> reload(
+      std::string source, const CompileOptions& options);
+
+  const Program& program() const { return *program_; }
+};
+
+// The state of the runs of one compiled program on one thread. A context
+// may run its program again; each run starts from fresh storage, and what
+// the last one left behind stays readable until the next.
+class ExecutionContext {
+ private:
+  // host memory to bind: one value or an array of them, each an INTEGER,
+  // INT64 or REAL, or a RECORD for a struct
+  struct Host {
+    void* data;
+    ValueAST::ValueType type;
+    size_t size;
+    bool array;
+    size_t count;
+  };
+
+  // the bytes bound to each global variable, by name
+  struct Bound {
+    std::string name;
+    const std::byte* begin;
+    const std::byte* end;
+  };
+
+  std::shared_ptr<const CompiledProgram> program_;
+  Interpreter interpreter_;
+  std::vector<Bound> bound_;
+
+  template <class T>
+  static constexpr ValueAST::ValueType host_type() {
+    if constexpr (std::is_same_v<T, int>) {
+      return ValueAST::ValueType::INTEGER;
+    } else if constexpr (std::is_same_v<T, int64_t>) {
+      return ValueAST::ValueType::INT64;
+    } else if constexpr (std::is_same_v<T, double>) {
+      return ValueAST::ValueType::REAL;
+    } else {
+      static_assert(std::is_class_v<T> && std::is_standard_layout_v<T> &&
+                        std::is_trivially_copyable_v<T>,
+                    "only int, int64_t, double and plain structs bind");
+      return ValueAST::ValueType::RECORD;
+    }
+  }
+
+  void bind(const std::string& name, const Host& host);
+
+ public:
+  explicit ExecutionContext(std::shared_ptr<const CompiledProgram> program)
+      : program_(std::move(program)) {}
+
+  ExecutionContext(const ExecutionContext&) = delete;
+  ExecutionContext& operator=(const ExecutionContext&) = delete;
+
+  // throws std::runtime_error if the program fails
+  void run() { program_->program().accept(&interpreter_); }
+
+  // stdout for nullptr; the sink has to outlive the runs
+  void set_output(OutputSink* sink) { interpreter_.set_output(sink); }
+
+  // stdin unless set; contexts running at once need inputs of their own
+  void set_input(std::string_view text) { interpreter_.set_input(text); }
+
+  void set_input(std::FILE* file) { interpreter_.set_input(file); }
+
+  // Run the global variable name in host memory from the next run on, see
+  // Interpreter::bind. An INTEGER, INT64 or REAL variable binds to an int,
+  // int64_t or double, a RECORD of them to a struct with the same fields
+  // in the same order, and an ARRAY of either to a span of exactly as many
+  // elements; subranges, BOOLEAN and PACKED records do not bind. Binding a
+  // variable again replaces its memory, which must not overlap that of
+  // another variable. Throws std::runtime_error for any other shape.
+  template <class T>
+  void bind(const std::string& name, T* value) {
+    bind(name, Host{value, host_type<T>(), sizeof(T), false, 1});
+  }
+
+  template <class T, size_t N>
+  void bind(const std::string& name, std::span<T, N> elements) {
+    bind(name, Host{elements.data(), host_type<T>(), sizeof(T), true,
+                    elements.size()});
+  }
+
+  // see Interpreter::global
+  Boxed global(const std::string& name) const {
+    return interpreter_.global(name);
+  }
+
+  void print_global_scope() const { interpreter_.print_global_scope(); }
+};
+
+}  // namespace Pascal
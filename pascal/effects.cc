@@ -0,0 +1,180 @@
+// Copyright 2023 Zhu Junhui
+
+#include "effects.h"
+#include <algorithm>
+
+namespace Pascal {
+
+bool Effects::may_write(const Variable* variable) const {
+  // any pointer or reference may point to what a pointer points to
+  if (!variable->dereferences().empty()) {
+    return writes_heap_ || writes_references_ || calls() ||
+           may_write_slot(variable);
+  }
+  return may_write_slot(variable);
+}
+
+bool Effects::may_write_slot(const Variable* variable) const {
+  // a reference may point to any variable of an outer frame, or into the
+  // heap
+  if (variable->by_reference()) {
+    return writes_references_ || writes_heap_ || calls() ||
+           std::any_of(writes_.begin(), writes_.end(), [&](const auto& write) {
+             return write.first < scope_->level();
+           });
+  }
+
+  return writes_.count({variable->level(), variable->slot()}) > 0 ||
+         variable->level() <= callee_level_ ||
+         (writes_references_ && variable->level() < scope_->level());
+}
+
+// writing an element counts as writing the whole array, writing through
+// a pointer as writing the whole heap
+void Effects::write(const Variable* variable) {
+  if (!variable->dereferences().empty()) {
+    writes_heap_ = true;
+  } else if (variable->by_reference()) {
+    writes_references_ = true;
+  } else {
+    writes_.insert({variable->level(), variable->slot()});
+  }
+  for (const auto& index : variable->indices()) {
+    index->accept(this);
+  }
+}
+
+void Effects::call(const std::string& name, int level,
+                   const std::vector<std::unique_ptr<ValueAST>>& arguments) {
+  callee_level_ = std::max(callee_level_, level);
+  const auto callee = scope_->lookup(name)->procedure;
+  for (size_t i = 0; i < arguments.size(); ++i) {
+    if (callee->parameters()[i]->by_reference()) {
+      write(static_cast<const Variable*>(arguments[i].get()));
+    } else {
+      arguments[i]->accept(this);
+    }
+  }
+}
+
+ValueAST::Value Effects::visit(const BinaryOperation* op) {
+  op->left()->accept(this);
+  op->right()->accept(this);
+  return 0;
+}
+
+ValueAST::Value Effects::visit(const UnaryOperation* op) {
+  op->expr()->accept(this);
+  return 0;
+}
+
+ValueAST::Value Effects::visit(const Variable* variable) {
+  reads_.push_back(variable);
+  for (const auto& index : variable->indices()) {
+    index->accept(this);
+  }
+  return 0;
+}
+
+ValueAST::Value Effects::visit(const FunctionCall* call) {
+  // a host function takes values and cannot reach any variable
+  if (call->host() != nullptr) {
+    for (const auto& argument : call->arguments()) {
+      argument->accept(this);
+    }
+    return 0;
+  }
+  this->call(call->name(), call->level(), call->arguments());
+  return 0;
+}
+
+ValueAST::Value Effects::visit(const SetConstructor* constructor) {
+  for (const auto& element : constructor->elements()) {
+    element.low->accept(this);
+    if (element.high != nullptr) {
+      element.high->accept(this);
+    }
+  }
+  return 0;
+}
+
+void Effects::visit(const Compound* compound) {
+  for (const auto& child : compound->children()) {
+    child->accept(this);
+  }
+}
+
+void Effects::visit(const Assign* assign) {
+  write(assign->left());
+  assign->right()->accept(this);
+}
+
+void Effects::visit(const HeapOperation* operation) {
+  write(operation->variable());
+  writes_heap_ = true;
+}
+
+void Effects::visit(const Write* write) {
+  for (const auto& argument : write->arguments()) {
+    argument.value->accept(this);
+    if (argument.width != nullptr) {
+      argument.width->accept(this);
+    }
+    if (argument.precision != nullptr) {
+      argument.precision->accept(this);
+    }
+  }
+}
+
+// reading a FILE moves it on
+void Effects::visit(const Read* read) {
+  for (const auto& variable : read->variables()) {
+    write(variable.get());
+  }
+}
+
+void Effects::visit(const Reset* reset) {
+  write(reset->variable());
+  reset->path()->accept(this);
+}
+
+void Effects::visit(const ProcedureCall* call) {
+  this->call(call->name(), call->level(), call->arguments());
+}
+
+void Effects::visit(const If* statement) {
+  statement->condition()->accept(this);
+  statement->then_statement()->accept(this);
+  if (statement->else_statement() != nullptr) {
+    statement->else_statement()->accept(this);
+  }
+}
+
+void Effects::visit(const While* loop) {
+  loop->condition()->accept(this);
+  loop->body()->accept(this);
+}
+
+void Effects::visit(const Repeat* loop) {
+  loop->body()->accept(this);
+  loop->condition()->accept(this);
+}
+
+void Effects::visit(const For* loop) {
+  write(loop->variable());
+  loop->start()->accept(this);
+  loop->end()->accept(this);
+  loop->body()->accept(this);
+}
+
+void Effects::visit(const Case* statement) {
+  statement->selector()->accept(this);
+  for (const auto& branch : statement->branches()) {
+    branch.statement->accept(this);
+  }
+  if (statement->else_statement() != nullptr) {
+    statement->else_statement()->accept(this);
+  }
+}
+
+}  // namespace Pascal
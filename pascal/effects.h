@@ -0,0 +1,82 @@
+// Copyright 2023 Zhu Junhui
+
+#pragma once
+
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+#include "ast.h"
+#include "symbol_table.h"
+
+namespace Pascal {
+
+// Collects, without running it, which variables a checked statement or
+// expression may write and which it reads. The answers are conservative:
+// may_write is true whenever a write cannot be ruled out.
+class Effects : public Visitor {
+ private:
+  // scope the visited code was checked in, to find callees
+  const T::SymbolTable* scope_;
+
+  // (level, slot) of variables assigned directly
+  std::set<std::pair<int, int>> writes_;
+
+  // something is assigned through a reference, e.g. a VAR parameter
+  bool writes_references_ = false;
+
+  // something is assigned through a pointer, or NEW or DISPOSE runs
+  bool writes_heap_ = false;
+
+  // highest declaring level of any procedure or function called; a callee
+  // declared at level l can reach the variables of levels up to l
+  int callee_level_ = -1;
+
+  std::vector<const Variable*> reads_;
+
+  void write(const Variable* variable);
+
+  // whether the slot of a variable, or what it refers to, may be written
+  bool may_write_slot(const Variable* variable) const;
+
+  void call(const std::string& name, int level,
+            const std::vector<std::unique_ptr<ValueAST>>& arguments);
+
+ public:
+  explicit Effects(const T::SymbolTable* scope) : scope_(scope) {}
+
+  bool may_write(const Variable* variable) const;
+
+  bool calls() const { return callee_level_ >= 0; }
+
+  const std::vector<const Variable*>& reads() const { return reads_; }
+
+  ValueAST::Value visit(const BinaryOperation* op) override;
+  ValueAST::Value visit(const UnaryOperation* op) override;
+  ValueAST::Value visit(const Number*) override { return 0; }
+  ValueAST::Value visit(const Variable* variable) override;
+  ValueAST::Value visit(const FunctionCall* call) override;
+  ValueAST::Value visit(const SetConstructor* constructor) override;
+  ValueAST::ValueType visit(const Type* type) override {
+    return type->value();
+  }
+  void visit(const Compound* compound) override;
+  void visit(const Assign* assign) override;
+  void visit(const Program*) override {}
+  void visit(const Block*) override {}
+  void visit(const VariableDeclaration*) override {}
+  void visit(const ProcedureDeclaration*) override {}
+  void visit(const Parameter*) override {}
+  void visit(const ProcedureCall* call) override;
+  void visit(const If* statement) override;
+  void visit(const While* loop) override;
+  void visit(const Repeat* loop) override;
+  void visit(const For* loop) override;
+  void visit(const Case* statement) override;
+  void visit(const HeapOperation* operation) override;
+  void visit(const Write* write) override;
+  void visit(const Read* read) override;
+  void visit(const Reset* reset) override;
+};
+
+}  // namespace Pascal
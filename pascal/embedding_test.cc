@@ -0,0 +1,226 @@
+// Copyright 2023 Zhu Junhui
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <set>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "batch_runner.h"
+#include "compiled_program.h"
+
+// Embeds programs the ways a host does: binds its own variables, structs
+// and arrays to global variables, which runs read and write in place;
+// lets programs call its functions, checked like Pascal ones; and runs a
+// program once per record on a pool, whose outputs and errors have to
+// come back by record, from one context per worker.
+
+namespace {
+
+struct Point {
+  int x;
+  double y;
+};
+
+const char* const BOUND =
+    "PROGRAM Bound; "
+    "TYPE point = RECORD x : INTEGER; y : REAL END; "
+    "VAR n : INTEGER; big : INT64; r : REAL; "
+    "v : ARRAY[1..4] OF INTEGER; p : ARRAY[1..3] OF point; "
+    "PROCEDURE Local; VAR hidden : INTEGER; BEGIN hidden := 1 END; "
+    "BEGIN "
+    "n := n + v[1] + v[4]; big := big * 2; r := r / 2; v[2] := n; "
+    "p[2].x := p[1].x + p[3].x; p[2].y := p[1].y * p[3].y "
+    "END.";
+
+// std::atomic, the batch calls Twice on every worker
+std::atomic<int> twice_calls = 0;
+
+int twice(int value) {
+  ++twice_calls;
+  return 2 * value;
+}
+
+double length(double x, double y) { return std::sqrt(x * x + y * y); }
+
+// reads a number, writes its double and divides by it
+const char* const RECORDS =
+    "PROGRAM Records; "
+    "VAR n, q : INTEGER; "
+    "BEGIN READ(n); WRITELN(Twice(n)); q := 1000 DIV n END.";
+
+bool expect(const std::string& what, const std::string& actual,
+            const std::string& expected) {
+  if (actual == expected) {
+    return true;
+  }
+  std::cerr << what << ": " << actual << " instead of " << expected << "\n";
+  return false;
+}
+
+// the error binding fails with, or "" if it does not
+template <class Bind>
+std::string error(Bind bind) {
+  try {
+    bind();
+  } catch (const std::runtime_error& error) {
+    return error.what();
+  }
+  return "";
+}
+
+bool binds() {
+  Pascal::ExecutionContext context(Pascal::CompiledProgram::compile(BOUND));
+  int n = 1;
+  int64_t big = int64_t{1} << 40;
+  double r = 3;
+  std::vector<int> v = {10, 0, 0, 40};
+  std::vector<Point> p = {{1, 1.5}, {0, 0}, {2, 4}};
+  context.bind("n", &n);
+  context.bind("big", &big);
+  context.bind("r", &r);
+  context.bind("v", std::span(v));
+  context.bind("p", std::span(p));
+  // each run reads what the one before wrote, in the host's memory
+  context.run();
+  context.run();
+
+  bool ok = expect("bound INTEGER", std::to_string(n), "101");
+  ok &= expect("read from the program", context.global("n").to_string(),
+               "101");
+  ok &= expect("bound INT64", std::to_string(big),
+               std::to_string(int64_t{1} << 42));
+  ok &= expect("bound REAL", std::to_string(r), std::to_string(0.75));
+  ok &= expect("bound array", std::to_string(v[1]), "101");
+  ok &= expect("bound records",
+               std::to_string(p[1].x) + " " + std::to_string(p[1].y),
+               "3 " + std::to_string(6.0));
+
+  int scalar = 0;
+  double real = 0;
+  std::vector<int> short_array(3);
+  ok &= expect("binding no variable",
+               error([&] { context.bind("missing", &scalar); }),
+               "global variable missing not found");
+  ok &= expect("binding a local variable",
+               error([&] { context.bind("hidden", &scalar); }),
+               "global variable hidden not found");
+  ok &= expect("binding another type",
+               error([&] { context.bind("n", &real); }),
+               "global variable n of type INTEGER cannot be bound to this "
+               "host memory");
+  ok &= expect("binding a scalar to an array",
+               error([&] { context.bind("n", std::span(short_array)); }),
+               "global variable n of type INTEGER cannot be bound to an "
+               "array");
+  ok &= expect("binding too few elements",
+               error([&] { context.bind("v", std::span(short_array)); }),
+               "global variable v has 4 elements, not 3");
+  return ok;
+}
+
+bool calls(std::shared_ptr<const Pascal::HostFunctions> functions) {
+  const Pascal::CompileOptions options{.functions = functions};
+  Pascal::ExecutionContext context(Pascal::CompiledProgram::compile(
+      "PROGRAM Calls; VAR i, s : INTEGER; r : REAL; "
+      "BEGIN s := 0; FOR i := 1 TO 1000 DO s := s + Twice(i); "
+      "r := Hypot(3, 4.0) END.",
+      options));
+  twice_calls = 0;
+  context.run();
+  bool ok = expect("host call in a loop", context.global("s").to_string(),
+                   "1001000");
+  ok &= expect("host calls", std::to_string(twice_calls.load()), "1000");
+  // INTEGER arguments are promoted to REAL parameters
+  ok &= expect("host call", context.global("r").to_string(),
+               Pascal::Boxed::from_real(5).to_string());
+
+  const auto compiles = [&](const std::string& body) {
+    return error([&] {
+      Pascal::CompiledProgram::compile(
+          "PROGRAM Wrong; VAR s : INTEGER; BEGIN " + body + " END.",
+          options);
+    });
+  };
+  ok &= expect("REAL argument of an INTEGER parameter",
+               compiles("s := Twice(1.5)"),
+               "type of argument 1 of Twice does not match its parameter!");
+  ok &= expect("too many arguments", compiles("s := Twice(1, 2)"),
+               "function Twice expects 1 arguments!");
+  ok &= expect("REAL result of an INTEGER", compiles("s := Hypot(1, 2)"),
+               compiles("s := 1.5"));
+  return ok;
+}
+
+bool batches(std::shared_ptr<const Pascal::HostFunctions> functions) {
+  constexpr size_t RECORDS_RUN = 1000;
+  Pascal::ThreadPool pool(4);
+  Pascal::BatchRunner runner(
+      Pascal::CompiledProgram::compile(RECORDS, {.functions = functions}),
+      &pool);
+
+  std::vector<std::string> inputs;
+  for (size_t record = 0; record < RECORDS_RUN; ++record) {
+    inputs.push_back(std::to_string(record));
+  }
+  bool ok = true;
+  std::set<const Pascal::ExecutionContext*> used;
+  for (int batch = 0; batch < 2; ++batch) {
+    std::vector<std::string> outputs(RECORDS_RUN);
+    std::vector<std::string> errors(RECORDS_RUN);
+    std::vector<std::string> quotients(RECORDS_RUN);
+    std::vector<const Pascal::ExecutionContext*> contexts(RECORDS_RUN);
+    const size_t failed = runner.run(
+        RECORDS_RUN,
+        [&](Pascal::ExecutionContext* context, size_t record) {
+          contexts[record] = context;
+          context->set_input(inputs[record]);
+        },
+        [&](const Pascal::ExecutionContext& context, size_t record) {
+          quotients[record] = context.global("q").to_string();
+        },
+        outputs, errors);
+
+    // only 1000 DIV 0 fails
+    ok &= expect("failed runs", std::to_string(failed), "1");
+    ok &= expect("error of record 0", errors[0], "division by zero");
+    for (size_t record = 1; record < RECORDS_RUN; ++record) {
+      ok &= expect("output of record " + std::to_string(record),
+                   outputs[record], std::to_string(2 * record) + "\n");
+      ok &= expect("error of record " + std::to_string(record),
+                   errors[record], "");
+      ok &= expect("result of record " + std::to_string(record),
+                   quotients[record], std::to_string(1000 / record));
+    }
+
+    used.insert(contexts.begin(), contexts.end());
+  }
+  // every worker runs all its records, of both batches, in one context
+  if (used.size() > pool.size()) {
+    std::cerr << used.size() << " contexts for " << pool.size()
+              << " workers\n";
+    ok = false;
+  }
+  return ok;
+}
+
+}  // namespace
+
+int main() {
+  auto functions = std::make_shared<Pascal::HostFunctions>();
+  functions->add("Twice", &twice);
+  functions->add("Hypot", &length);
+
+  bool ok = binds();
+  ok &= calls(functions);
+  ok &= batches(functions);
+  if (!ok) {
+    return 1;
+  }
+  std::cout << "host memory, functions and batches work\n";
+  return 0;
+}
@@ -0,0 +1,53 @@
+// Copyright 2023 Zhu Junhui
+
+#include "heap.h"
+#include <cstring>
+#include <new>
+#include <utility>
+
+namespace Pascal {
+
+void* Heap::allocate(size_t bytes) {
+  if (bytes > MAX_POOLED) {
+    auto block = std::make_unique<std::byte[]>(bytes);
+    const auto address = block.get();
+    large_.emplace(address, std::move(block));
+    return address;
+  }
+
+  const size_t k = size_class(bytes);
+  const size_t size = (k + 1) * GRANULE;
+  if (const auto block = free_[k]; block != nullptr) {
+    free_[k] = block->next;
+    std::memset(block, 0, size);
+    return block;
+  }
+
+  // slabs start zeroed; what is left of a full one is not used
+  if (static_cast<size_t>(end_ - top_) < size) {
+    slabs_.push_back(std::make_unique<std::byte[]>(SLAB));
+    top_ = slabs_.back().get();
+    end_ = top_ + SLAB;
+  }
+  const auto block = top_;
+  top_ += size;
+  return block;
+}
+
+void Heap::release(void* block, size_t bytes) {
+  if (bytes > MAX_POOLED) {
+    large_.erase(block);
+    return;
+  }
+  const size_t k = size_class(bytes);
+  free_[k] = new (block) FreeBlock{free_[k]};
+}
+
+void Heap::clear() {
+  free_.fill(nullptr);
+  slabs_.clear();
+  top_ = end_ = nullptr;
+  large_.clear();
+}
+
+}  // namespace Pascal
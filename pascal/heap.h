@@ -0,0 +1,55 @@
+// Copyright 2023 Zhu Junhui
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace Pascal {
+
+// The blocks NEW allocates during a run. A block of up to MAX_POOLED bytes
+// is rounded up to a multiple of GRANULE and taken from the free list of
+// its size class, or carved from the current slab; DISPOSE pushes it back
+// on that list. Larger blocks are allocated one by one. Nothing goes back
+// to the system until the heap is cleared, which drops every slab at once.
+class Heap {
+ public:
+  static constexpr size_t GRANULE = 16;
+  static constexpr size_t MAX_POOLED = 1024;
+  static constexpr size_t SLAB = 1 << 20;
+
+ private:
+  // a disposed block links to the next free one of its class
+  struct FreeBlock {
+    FreeBlock* next;
+  };
+
+  std::array<FreeBlock*, MAX_POOLED / GRANULE> free_{};
+
+  std::vector<std::unique_ptr<std::byte[]>> slabs_;
+
+  // the part of the last slab not carved yet
+  std::byte* top_ = nullptr;
+  std::byte* end_ = nullptr;
+
+  std::unordered_map<void*, std::unique_ptr<std::byte[]>> large_;
+
+  static size_t size_class(size_t bytes) {
+    return (std::max<size_t>(bytes, 1) + GRANULE - 1) / GRANULE - 1;
+  }
+
+ public:
+  // zeroed bytes, aligned for any scalar
+  void* allocate(size_t bytes);
+
+  // block was allocated with the same number of bytes
+  void release(void* block, size_t bytes);
+
+  void clear();
+};
+
+}  // namespace Pascal
@@ -0,0 +1,131 @@
+// Copyright 2023 Zhu Junhui
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "meta.h"
+#include "symbol_table.h"
+
+namespace Pascal {
+
+// A C++ function a program calls like one of its own functions. The
+// analyzer checks calls against its parameter types; at run time the
+// arguments are evaluated into raw slots, as for a call of a Pascal
+// function, and a thunk made for its exact signature reads them as those
+// types and calls it directly. Nothing is looked up or boxed per call.
+struct HostFunction {
+  static constexpr size_t MAX_PARAMETERS = 8;
+
+  std::string name;
+  ValueAST::ValueType result;
+  std::vector<ValueAST::ValueType> parameters;
+  void (*function)();
+  V::Slot (*thunk)(void (*function)(), const V::Slot* arguments);
+
+  V::Slot call(const V::Slot* arguments) const {
+    return thunk(function, arguments);
+  }
+};
+
+// The host functions programs compiled with them may call, by name. A
+// declaration of the program hides a host function of the same name.
+class HostFunctions {
+ private:
+  // nodes stay where they are, checked calls point to them
+  std::map<std::string, HostFunction, std::less<>> functions_;
+
+  // int, int64_t, double and bool are INTEGER, INT64, REAL and BOOLEAN
+  template <class T>
+  static constexpr ValueAST::ValueType type() {
+    if constexpr (std::is_same_v<T, int>) {
+      return ValueAST::ValueType::INTEGER;
+    } else if constexpr (std::is_same_v<T, int64_t>) {
+      return ValueAST::ValueType::INT64;
+    } else if constexpr (std::is_same_v<T, double>) {
+      return ValueAST::ValueType::REAL;
+    } else {
+      static_assert(std::is_same_v<T, bool>,
+                    "host functions take and return int, int64_t, double "
+                    "and bool");
+      return ValueAST::ValueType::BOOLEAN;
+    }
+  }
+
+  // a BOOLEAN is 0 or 1 in the integer member of its slot
+  template <class T>
+  static T get(const V::Slot& slot) {
+    if constexpr (std::is_same_v<T, int64_t>) {
+      return slot.int64;
+    } else if constexpr (std::is_same_v<T, double>) {
+      return slot.real;
+    } else if constexpr (std::is_same_v<T, bool>) {
+      return slot.integer != 0;
+    } else {
+      return slot.integer;
+    }
+  }
+
+  template <class T>
+  static V::Slot put(T value) {
+    V::Slot slot{};
+    if constexpr (std::is_same_v<T, int64_t>) {
+      slot.int64 = value;
+    } else if constexpr (std::is_same_v<T, double>) {
+      slot.real = value;
+    } else {
+      slot.integer = static_cast<int>(value);
+    }
+    return slot;
+  }
+
+  template <class R, class... A>
+  static V::Slot invoke(void (*function)(), const V::Slot* arguments) {
+    const auto typed = reinterpret_cast<R (*)(A...)>(function);
+    return [&]<size_t... I>(std::index_sequence<I...>) {
+      return put<R>(typed(get<A>(arguments[I])...));
+    }(std::index_sequence_for<A...>{});
+  }
+
+ public:
+  // replaces an earlier function of the same name; programs already
+  // compiled keep calling that one, so it must not be replaced while they
+  // may run
+  template <class R, class... A>
+  void add(const std::string& name, R (*function)(A...)) {
+    static_assert(sizeof...(A) <= HostFunction::MAX_PARAMETERS,
+                  "too many parameters for a host function");
+    functions_.insert_or_assign(
+        name, HostFunction{name, type<R>(), {type<A>()...},
+                           reinterpret_cast<void (*)()>(function),
+                           &invoke<R, A...>});
+  }
+
+  // nullptr if there is none
+  const HostFunction* find(const std::string& name) const {
+    const auto it = functions_.find(name);
+    return it != functions_.end() ? &it->second : nullptr;
+  }
+
+  // hash of every name and signature, so that bodies checked against one
+  // set of host functions are not reused with another
+  uint64_t fingerprint() const {
+    uint64_t seed = functions_.size();
+    for (const auto& [name, function] : functions_) {
+      seed = hash_combine(seed, std::hash<std::string>{}(name));
+      seed = hash_combine(seed, static_cast<uint64_t>(function.result));
+      for (const auto parameter : function.parameters) {
+        seed = hash_combine(seed, static_cast<uint64_t>(parameter));
+      }
+    }
+    return seed;
+  }
+};
+
+}  // namespace Pascal
@@ -0,0 +1,203 @@
+// Copyright 2023 Zhu Junhui
+
+#include "input.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+
+namespace Pascal {
+
+namespace {
+
+bool blank(char c) {
+  return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\f' ||
+         c == '\v';
+}
+
+// the whole token has to be one number; from_chars takes no plus sign
+template <class T>
+TextInput::Status parse(std::string_view token, T* value) {
+  const char* begin = token.data();
+  const char* end = begin + token.size();
+  if (begin != end && *begin == '+') {
+    ++begin;
+    if (begin != end && *begin == '-') {
+      return TextInput::Status::INVALID;
+    }
+  }
+  const auto [ptr, error] = std::from_chars(begin, end, *value);
+  if (error == std::errc::result_out_of_range) {
+    return TextInput::Status::RANGE;
+  }
+  if (error != std::errc() || ptr != end) {
+    return TextInput::Status::INVALID;
+  }
+  return TextInput::Status::OK;
+}
+
+}  // namespace
+
+MappedFile::MappedFile(const std::string& path) {
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("cannot open " + path);
+  }
+  struct stat status;
+  if (::fstat(fd, &status) != 0) {
+    ::close(fd);
+    throw std::runtime_error("cannot read " + path);
+  }
+  size_ = static_cast<size_t>(status.st_size);
+  if (size_ > 0) {
+    void* data = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      ::close(fd);
+      throw std::runtime_error("cannot map " + path);
+    }
+    ::madvise(data, size_, MADV_SEQUENTIAL);
+    data_ = static_cast<const char*>(data);
+  }
+  ::close(fd);
+}
+
+MappedFile::~MappedFile() {
+  if (data_ != nullptr) {
+    ::munmap(const_cast<char*>(data_), size_);
+  }
+}
+
+void TextInput::set_text(std::string_view text) {
+  file_ = nullptr;
+  next_ = text.data();
+  end_ = text.data() + text.size();
+  drained_ = true;
+}
+
+void TextInput::set_file(std::FILE* file) {
+  file_ = file;
+  next_ = end_ = nullptr;
+  drained_ = false;
+}
+
+// a read returns what the stream has, so a terminal is not waited on
+// until the buffer is full
+bool TextInput::refill() {
+  if (file_ == nullptr || drained_) {
+    return false;
+  }
+  if (buffer_ == nullptr) {
+    buffer_ = std::make_unique_for_overwrite<char[]>(CAPACITY);
+  }
+  const size_t rest = end_ - next_;
+  if (rest == CAPACITY) {
+    throw std::runtime_error("input has a token longer than " +
+                             std::to_string(CAPACITY) + " characters");
+  }
+  if (rest > 0) {
+    std::memmove(buffer_.get(), next_, rest);
+  }
+  next_ = buffer_.get();
+  end_ = next_ + rest;
+
+  ssize_t count;
+  do {
+    count = ::read(::fileno(file_), buffer_.get() + rest, CAPACITY - rest);
+  } while (count < 0 && errno == EINTR);
+  if (count < 0) {
+    throw std::runtime_error("cannot read input");
+  }
+  if (count == 0) {
+    drained_ = true;
+    return false;
+  }
+  end_ += count;
+  return true;
+}
+
+bool TextInput::skip_blanks() {
+  while (true) {
+    while (next_ != end_ && blank(*next_)) {
+      ++next_;
+    }
+    if (next_ != end_) {
+      return true;
+    }
+    if (!refill()) {
+      return false;
+    }
+  }
+}
+
+std::string_view TextInput::token() {
+  size_t scanned = 0;
+  while (true) {
+    const char* stop = next_ + scanned;
+    while (stop != end_ && !blank(*stop)) {
+      ++stop;
+    }
+    if (stop != end_) {
+      return {next_, static_cast<size_t>(stop - next_)};
+    }
+    scanned = end_ - next_;
+    if (!refill()) {
+      return {next_, scanned};
+    }
+  }
+}
+
+template <class T>
+TextInput::Status TextInput::read_number(T* value) {
+  if (!skip_blanks()) {
+    return Status::END;
+  }
+  const auto text = token();
+  const auto status = parse(text, value);
+  if (status == Status::OK) {
+    next_ += text.size();
+  }
+  return status;
+}
+
+TextInput::Status TextInput::read(int* value) { return read_number(value); }
+
+TextInput::Status TextInput::read(int64_t* value) {
+  return read_number(value);
+}
+
+TextInput::Status TextInput::read(double* value) {
+  return read_number(value);
+}
+
+std::string TextInput::next_token() {
+  constexpr size_t SHOWN = 32;
+  if (!skip_blanks()) {
+    return "";
+  }
+  const auto text = token();
+  return text.size() > SHOWN ? std::string(text.substr(0, SHOWN)) + "..."
+                             : std::string(text);
+}
+
+void TextInput::skip_line() {
+  while (true) {
+    const auto line_break =
+        next_ != end_ ? static_cast<const char*>(
+                            std::memchr(next_, '\n', end_ - next_))
+                      : nullptr;
+    if (line_break != nullptr) {
+      next_ = line_break + 1;
+      return;
+    }
+    next_ = end_;
+    if (!refill()) {
+      return;
+    }
+  }
+}
+
+}  // namespace Pascal
@@ -0,0 +1,102 @@
+// Copyright 2023 Zhu Junhui
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace Pascal {
+
+// A file mapped read-only into memory, so that reading it costs no copy
+// and no system call per chunk. An empty file maps to an empty view.
+class MappedFile {
+ private:
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+
+ public:
+  explicit MappedFile(const std::string& path);
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  ~MappedFile();
+
+  std::string_view view() const { return {data_, size_}; }
+};
+
+// Where a FILE variable is in the file RESET mapped; it lives in the
+// aggregate arena like the fields of a record. A FILE that has not been
+// reset is empty.
+struct FileCursor {
+  const std::byte* next;
+  const std::byte* end;
+};
+
+// The text READ and READLN parse: either all of it in memory, e.g. a
+// mapped file, or a stream read in large chunks into one buffer that is
+// reused, the unread tail moved to its front. Numbers are separated by
+// blanks and line breaks and parsed in place by std::from_chars.
+class TextInput {
+ public:
+  static constexpr size_t CAPACITY = 1 << 20;
+
+  enum class Status {
+    OK,
+    // only blanks and line breaks are left
+    END,
+    // what comes next is not a number of the type read
+    INVALID,
+    // the number does not fit in the type read
+    RANGE,
+  };
+
+ private:
+  // nullptr when the whole text is in memory
+  std::FILE* file_;
+  std::unique_ptr<char[]> buffer_;
+
+  const char* next_ = nullptr;
+  const char* end_ = nullptr;
+
+  // the stream has no more to read
+  bool drained_ = false;
+
+  // move the unread part to the front of the buffer and fill the rest;
+  // false if nothing more could be read
+  bool refill();
+
+  // skip blanks and line breaks; false at the end of the text
+  bool skip_blanks();
+
+  // the characters up to the next blank or line break, all in the buffer
+  std::string_view token();
+
+  template <class T>
+  Status read_number(T* value);
+
+ public:
+  explicit TextInput(std::FILE* file) : file_(file) {}
+
+  // read from text, which has to outlive the reads
+  void set_text(std::string_view text);
+
+  // read from a stream the caller opened
+  void set_file(std::FILE* file);
+
+  Status read(int* value);
+  Status read(int64_t* value);
+  Status read(double* value);
+
+  // what the next token is, for an error message
+  std::string next_token();
+
+  // skip past the next line break, or to the end of the text
+  void skip_line();
+};
+
+}  // namespace Pascal
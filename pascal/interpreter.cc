@@ -1,18 +1,390 @@
 // Copyright 2023 Zhu Junhui
 
 #include "interpreter.h"
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <limits>
 #include <string>
+#include <type_traits>
+#include <utility>
+#include "host_function.h"
+#include "kernel.h"
 #include "value_ast.h"
 
 namespace Pascal {
+
+namespace {
+
+// BOOLEAN values live in the integer member of a slot, a SET or a STRING
+// in the storage its slot points to
+void store(V::Slot* slot, ValueAST::ValueType type,
+           const ValueAST::Value& value) {
+  if (type == ValueAST::ValueType::REAL) {
+    slot->real = std::get<double>(value);
+  } else if (type == ValueAST::ValueType::POINTER) {
+    slot->pointer = std::get<void*>(value);
+  } else if (type == ValueAST::ValueType::INT64) {
+    slot->int64 = std::get<int64_t>(value);
+  } else if (type == ValueAST::ValueType::SET) {
+    *slot->set = std::get<Set>(value);
+  } else if (type == ValueAST::ValueType::STRING) {
+    *slot->string = std::get<String>(value);
+  } else {
+    slot->integer = std::get<int>(value);
+  }
+}
+
+ValueAST::Value load(const V::Slot& slot, ValueAST::ValueType type) {
+  if (type == ValueAST::ValueType::REAL) {
+    return slot.real;
+  }
+  if (type == ValueAST::ValueType::INT64) {
+    return slot.int64;
+  }
+  if (type == ValueAST::ValueType::SET) {
+    return *slot.set;
+  }
+  if (type == ValueAST::ValueType::STRING) {
+    return *slot.string;
+  }
+  if (type == ValueAST::ValueType::POINTER) {
+    return slot.pointer;
+  }
+  return slot.integer;
+}
+
+// an INTEGER, INT64 or BOOLEAN stored in size bytes, which packed storage
+// narrows to 1, 2 or 4; a subrange with negative values is sign-extended
+int64_t load_integer(const std::byte* bytes, int64_t size, bool is_signed) {
+  switch (size) {
+    case 1: {
+      uint8_t value;
+      std::memcpy(&value, bytes, 1);
+      return is_signed ? static_cast<int8_t>(value) : value;
+    }
+    case 2: {
+      uint16_t value;
+      std::memcpy(&value, bytes, 2);
+      return is_signed ? static_cast<int16_t>(value) : value;
+    }
+    case 4: {
+      uint32_t value;
+      std::memcpy(&value, bytes, 4);
+      return is_signed ? int64_t{static_cast<int32_t>(value)} : value;
+    }
+    default: {
+      int64_t value;
+      std::memcpy(&value, bytes, sizeof(int64_t));
+      return value;
+    }
+  }
+}
+
+// the value is within the subrange, so its low bytes are all there is
+void store_integer(std::byte* bytes, int64_t size, int64_t value) {
+  const auto bits = static_cast<uint64_t>(value);
+  switch (size) {
+    case 1: {
+      const auto narrow = static_cast<uint8_t>(bits);
+      std::memcpy(bytes, &narrow, 1);
+    } break;
+    case 2: {
+      const auto narrow = static_cast<uint16_t>(bits);
+      std::memcpy(bytes, &narrow, 2);
+    } break;
+    case 4: {
+      const auto narrow = static_cast<uint32_t>(bits);
+      std::memcpy(bytes, &narrow, 4);
+    } break;
+    default:
+      std::memcpy(bytes, &value, sizeof(int64_t));
+      break;
+  }
+}
+
+// the value of an INTEGER or INT64
+int64_t integer_value(const ValueAST::Value& value) {
+  return std::holds_alternative<int>(value) ? std::get<int>(value)
+                                            : std::get<int64_t>(value);
+}
+
+bool is_signed(const std::optional<Interval>& range) {
+  return !range.has_value() || range->low < 0;
+}
+
+bool excludes_zero(const std::optional<Interval>& range) {
+  return range.has_value() && (range->low > 0 || range->high < 0);
+}
+
+// subranges without 0 in zeroed aggregate storage start at their lower
+// bound, like scalar variables
+void initialize(const ArrayType* array, const RecordType* record,
+                std::byte* bytes) {
+  if (array != nullptr && array->record == nullptr) {
+    if (excludes_zero(array->range)) {
+      const int64_t size = array->element_size();
+      for (int64_t k = 0; k < array->size(); ++k) {
+        store_integer(bytes + k * size, size, array->range->low);
+      }
+    }
+    return;
+  }
+  for (const auto& scalar : record->scalars()) {
+    if (!excludes_zero(scalar.range)) {
+      continue;
+    }
+    const int64_t low = scalar.range->low;
+    if (array == nullptr) {
+      store_integer(bytes + scalar.offset, scalar.size, low);
+      continue;
+    }
+    const auto [stride, start] = array->field(scalar.offset, scalar.size);
+    for (int64_t k = 0; k < array->size(); ++k) {
+      store_integer(bytes + start + k * stride, scalar.size, low);
+    }
+  }
+}
+
+std::string scalar_text(const std::byte* bytes, ValueAST::ValueType type,
+                        const std::optional<Interval>& range, int64_t size) {
+  if (type == ValueAST::ValueType::REAL) {
+    double value;
+    std::memcpy(&value, bytes, sizeof(double));
+    return std::to_string(value);
+  }
+  if (type == ValueAST::ValueType::POINTER) {
+    void* value;
+    std::memcpy(&value, bytes, sizeof(void*));
+    return Boxed::from_pointer(value).to_string();
+  }
+  const auto value = load_integer(bytes, size, is_signed(range));
+  if (type == ValueAST::ValueType::BOOLEAN) {
+    return value ? "TRUE" : "FALSE";
+  }
+  return std::to_string(value);
+}
+
+// the fields of a record, e.g. (x: 1, p: (a: TRUE)); the scalar at offset
+// in the record, taking size bytes, is stored at at(offset, size)
+template <class At>
+std::string record_text(const RecordType& record, int64_t base, At&& at) {
+  std::string text = "(";
+  for (const auto& field : record.fields) {
+    text += (text.size() > 1 ? ", " : "") + field.name + ": ";
+    const auto offset = base + field.offset;
+    text += field.record != nullptr
+                ? record_text(*field.record, offset, at)
+                : scalar_text(at(offset, field.size), field.type, field.range,
+                              field.size);
+  }
+  return text + ")";
+}
+
+// the first elements of an array in row-major order
+std::string elements(const ArrayType& array, const void* elements) {
+  constexpr int64_t SHOWN = 32;
+  const auto bytes = static_cast<const std::byte*>(elements);
+  std::string text = "[";
+  for (int64_t i = 0; i < std::min(array.size(), SHOWN); ++i) {
+    if (i > 0) {
+      text += ", ";
+    }
+    if (array.record != nullptr) {
+      text += record_text(*array.record, 0, [&](int64_t offset, int64_t size) {
+        const auto [stride, start] = array.field(offset, size);
+        return bytes + i * stride + start;
+      });
+    } else {
+      const int64_t size = array.element_size();
+      text += scalar_text(bytes + i * size, array.element, array.range, size);
+    }
+  }
+  return text + (array.size() > SHOWN ? ", ...]" : "]");
+}
+
+// a cell for the value of a scalar slot, pointing into its storage for a
+// set, a string or a wide INT64
+Boxed box(const V::Slot& slot, ValueAST::ValueType type) {
+  switch (type) {
+    case ValueAST::ValueType::REAL:
+      return Boxed::from_real(slot.real);
+    case ValueAST::ValueType::BOOLEAN:
+      return Boxed::from_boolean(slot.integer != 0);
+    case ValueAST::ValueType::INT64:
+      return Boxed::from_int64(&slot.int64);
+    case ValueAST::ValueType::SET:
+      return Boxed::from_set(slot.set);
+    case ValueAST::ValueType::STRING:
+      return Boxed::from_string(slot.string);
+    case ValueAST::ValueType::POINTER:
+      return Boxed::from_pointer(slot.pointer);
+    default:
+      return Boxed::from_integer(slot.integer);
+  }
+}
+
+// the most decimals WRITE shows of a REAL; with that many, any REAL in
+// fixed notation fits in FORMATTED characters
+constexpr int MAX_DECIMALS = 64;
+constexpr size_t FORMATTED = 400;
+
+// what WRITE shows for a value: a string as it is, without quotes, and a
+// REAL in its shortest form, or in fixed notation with decimals >= 0;
+// numbers are formatted in text
+std::string_view format(const ValueAST::Value& value,
+                        ValueAST::ValueType type, int decimals,
+                        char (&text)[FORMATTED]) {
+  std::to_chars_result result;
+  switch (type) {
+    case ValueAST::ValueType::STRING:
+      return std::get<String>(value).view();
+    case ValueAST::ValueType::BOOLEAN:
+      return std::get<int>(value) != 0 ? "TRUE" : "FALSE";
+    case ValueAST::ValueType::REAL:
+      result = decimals < 0
+                   ? std::to_chars(text, text + FORMATTED,
+                                   std::get<double>(value))
+                   : std::to_chars(text, text + FORMATTED,
+                                   std::get<double>(value),
+                                   std::chars_format::fixed, decimals);
+      break;
+    case ValueAST::ValueType::INT64:
+      result = std::to_chars(text, text + FORMATTED, std::get<int64_t>(value));
+      break;
+    default:
+      result = std::to_chars(text, text + FORMATTED, std::get<int>(value));
+  }
+  return std::string_view(text, result.ptr - text);
+}
+
+bool test(const ValueAST* condition, ValueASTVisitor* visitor) {
+  return std::get<int>(condition->accept(visitor)) != 0;
+}
+
+}  // namespace
+
 void Interpreter::error(const std::string& msg) {
   throw std::runtime_error(msg);
 }
 
+V::Slot& Interpreter::slot(const Variable* variable) {
+  auto& slot = symbol_table_.slot(variable->level(), variable->slot());
+  auto& value = variable->by_reference() ? *slot.reference : slot;
+  if (variable->whole()) {
+    return value;
+  }
+  auto selected = &value;
+  if (!variable->indices().empty() || !variable->fields().empty()) {
+    selected = &element(variable, variable->indices().empty() ? value.record
+                                                              : value.array);
+  }
+  // each dereference lands at an offset into the block a pointer points to
+  for (const auto& dereference : variable->dereferences()) {
+    if (selected->pointer == nullptr) {
+      error("NIL pointer dereferenced in " + variable->value());
+    }
+    selected = reinterpret_cast<V::Slot*>(
+        static_cast<std::byte*>(selected->pointer) + dereference.offset);
+  }
+  return *selected;
+}
+
+// an element or field is accessed like a slot through the member of its
+// type, the bytes after it are never touched; one packed into fewer bytes
+// is accessed through load_integer and store_integer
+V::Slot& Interpreter::element(const Variable* variable, void* elements) {
+  const auto array = variable->array();
+  const auto& indices = variable->indices();
+  int64_t offset = 0;
+  for (size_t i = 0; i < indices.size(); ++i) {
+    const auto& dimension = array->dimensions[i];
+    const int index = std::get<int>(indices[i]->accept(this));
+    if (variable->checked() &&
+        (index < dimension.low || index > dimension.high)) {
+      error("index " + std::to_string(index) + " is out of range for " +
+            variable->value());
+    }
+    offset += (static_cast<int64_t>(index) - dimension.low) * dimension.stride;
+  }
+  const auto bytes = static_cast<std::byte*>(elements);
+  return *reinterpret_cast<V::Slot*>(bytes + offset * variable->stride() +
+                                     variable->offset());
+}
+
+void Interpreter::check_range(const Variable* variable, int64_t value) {
+  const auto& range = variable->range();
+  if (range.has_value() && (value < range->low || value > range->high)) {
+    error("value " + std::to_string(value) + " is out of range for " +
+          variable->value());
+  }
+}
+
+void Interpreter::check_members(const Variable* variable, const Set& value) {
+  Set allowed;
+  allowed.insert(static_cast<int>(variable->range()->low),
+                 static_cast<int>(variable->range()->high));
+  if (!value.subset_of(allowed)) {
+    error("member " + std::to_string((value - allowed).first()) +
+          " is out of range for " + variable->value());
+  }
+}
+
 void Interpreter::visit(const Program* program) {
-  symbol_table_.enter_scope(program->name());
-  program->block()->accept(this);
-  symbol_table_.exit_scope();
+  // the program's frame stays on the stack after the run, so that
+  // print_global_scope can read it, and so do the strings, the heap
+  // blocks and the files it built or mapped
+  symbol_table_.reset();
+  strings_.clear();
+  heap_.clear();
+  files_.clear();
+  tail_callee_ = nullptr;
+  char base;
+  stack_base_ = reinterpret_cast<uintptr_t>(&base);
+  auto frame = symbol_table_.push_frame(program->block(), 0);
+  symbol_table_.enter_frame(frame);
+  global_frame_ = frame;
+  // what the program wrote before it failed is still shown
+  try {
+    program->block()->accept(this);
+  } catch (...) {
+    // the run's own error is the one reported, not one of the output
+    try {
+      output_.flush();
+    } catch (...) {
+    }
+    store_bound();
+    throw;
+  }
+  output_.flush();
+  store_bound();
+}
+
+const Interpreter::Binding* Interpreter::bound(const Variable* variable) const {
+  if (static_cast<size_t>(variable->slot()) >= bound_.size() ||
+      symbol_table_.frame(variable->level()) != global_frame_ ||
+      bound_[variable->slot()].data == nullptr) {
+    return nullptr;
+  }
+  return &bound_[variable->slot()];
+}
+
+void Interpreter::store_bound() noexcept {
+  for (size_t slot = 0; slot < bound_.size(); ++slot) {
+    if (bound_[slot].scalar > 0) {
+      std::memcpy(bound_[slot].data, &global_frame_->slots[slot],
+                  bound_[slot].scalar);
+    }
+  }
+}
+
+void Interpreter::bind(int slot, void* data, size_t scalar) {
+  if (bound_.size() <= static_cast<size_t>(slot)) {
+    bound_.resize(slot + 1);
+  }
+  bound_[slot] = Binding{data, data != nullptr ? scalar : 0};
 }
 
 void Interpreter::visit(const Block* block) {
@@ -27,27 +399,263 @@ void Interpreter::visit(const Block* block) {
   block->compound_statement()->accept(this);
 }
 
+void Interpreter::visit(const ProcedureDeclaration*) {
+  // nothing to do until the procedure is called
+}
+
+void Interpreter::visit(const Parameter*) {
+  // parameters are stored by the caller
+}
+
+template <class Call>
+V::Slot Interpreter::call(const Call* call) {
+  const auto caller = symbol_table_.frame(call->level());
+  const auto procedure =
+      caller->block->procedures_declarations()[call->index()].get();
+
+  // arguments are evaluated in the caller's scope, the frame is not
+  // entered yet
+  auto frame = symbol_table_.push_frame(procedure->block(), call->level() + 1);
+  const auto& parameters = procedure->parameters();
+  const auto& arguments = call->arguments();
+  for (size_t i = 0; i < arguments.size(); ++i) {
+    auto& slot = frame->slots[i];
+    const auto argument = arguments[i].get();
+    if (parameters[i]->by_reference()) {
+      slot.reference = &this->slot(static_cast<const Variable*>(argument));
+    } else if (argument->type() == ValueAST::ValueType::ARRAY) {
+      // a copy in the callee's part of the arena
+      const auto array = static_cast<const Variable*>(argument);
+      const auto bytes = array->array()->bytes();
+      slot.array = symbol_table_.allocate(bytes);
+      std::memcpy(slot.array, this->slot(array).array, bytes);
+    } else if (argument->type() == ValueAST::ValueType::RECORD) {
+      const auto record = static_cast<const Variable*>(argument);
+      const auto bytes = record->record()->size;
+      slot.record = symbol_table_.allocate(bytes);
+      std::memcpy(slot.record, this->slot(record).record, bytes);
+    } else {
+      const auto value = argument->accept(this);
+      if (argument->type() == ValueAST::ValueType::INTEGER ||
+          argument->type() == ValueAST::ValueType::INT64) {
+        check_range(parameters[i]->variable(), integer_value(value));
+      } else if (argument->type() == ValueAST::ValueType::SET) {
+        check_members(parameters[i]->variable(), std::get<Set>(value));
+        slot.set = static_cast<Set*>(symbol_table_.allocate(sizeof(Set)));
+      } else if (argument->type() == ValueAST::ValueType::STRING) {
+        slot.string =
+            static_cast<String*>(symbol_table_.allocate(sizeof(String)));
+      }
+      store(&slot, argument->type(), value);
+    }
+  }
+
+  if (call->tail()) {
+    tail_callee_ = procedure;
+    return {};
+  }
+  return run(procedure, frame);
+}
+
+// A tail call is the last statement of its body, so it just returns after
+// pushing its callee's frame. The callee then runs in place of the caller,
+// and a chain of tail calls takes one frame and one native call in total.
+V::Slot Interpreter::run(const ProcedureDeclaration* procedure,
+                         V::Frame* frame) {
+  char here;
+  if (stack_base_ - reinterpret_cast<uintptr_t>(&here) > NATIVE_STACK_LIMIT) {
+    error("stack overflow");
+  }
+
+  symbol_table_.enter_frame(frame);
+  procedure->block()->accept(this);
+  while (tail_callee_ != nullptr) {
+    procedure = std::exchange(tail_callee_, nullptr);
+    frame = symbol_table_.replace_frame();
+    symbol_table_.enter_frame(frame);
+    procedure->block()->accept(this);
+  }
+
+  V::Slot result{};
+  if (procedure->is_function()) {
+    result = frame->slots[procedure->result_slot()];
+  }
+  symbol_table_.exit_frame();
+  return result;
+}
+
+void Interpreter::visit(const ProcedureCall* call) {
+  this->call(call);
+}
+
+ValueAST::Value Interpreter::visit(const FunctionCall* call) {
+  if (const auto host = call->host(); host != nullptr) {
+    V::Slot arguments[HostFunction::MAX_PARAMETERS];
+    for (size_t i = 0; i < call->arguments().size(); ++i) {
+      store(&arguments[i], host->parameters[i],
+            call->arguments()[i]->accept(this));
+    }
+    return load(host->call(arguments), call->type());
+  }
+  // a tail call has no value yet, the callee's result is returned in
+  // place of the caller's
+  const auto result = this->call(call);
+  if (tail_callee_ != nullptr) {
+    return {};
+  }
+  return load(result, call->type());
+}
+
+void Interpreter::visit(const If* statement) {
+  if (test(statement->condition(), this)) {
+    statement->then_statement()->accept(this);
+  } else if (statement->else_statement() != nullptr) {
+    statement->else_statement()->accept(this);
+  }
+}
+
+void Interpreter::visit(const While* loop) {
+  while (test(loop->condition(), this)) {
+    loop->body()->accept(this);
+  }
+}
+
+void Interpreter::visit(const Repeat* loop) {
+  do {
+    loop->body()->accept(this);
+  } while (!test(loop->condition(), this));
+}
+
+void Interpreter::visit(const For* loop) {
+  // the control variable keeps its address for the whole loop, and the
+  // bounds have its type
+  auto& control = slot(loop->variable());
+  if (loop->start()->type() == ValueAST::ValueType::INT64) {
+    run_loop(loop, &control.int64);
+  } else {
+    run_loop(loop, &control.integer);
+  }
+}
+
+template <class I>
+void Interpreter::run_loop(const For* loop, I* control) {
+  const I step = loop->down() ? -1 : 1;
+
+  // both values are evaluated once, on entry; the body changing what the
+  // final value was computed from does not change the number of trips
+  const I start = std::get<I>(loop->start()->accept(this));
+  const I end = std::get<I>(loop->end()->accept(this));
+  if (loop->down() ? start < end : start > end) {
+    return;
+  }
+  // a counted loop only takes values between the two
+  check_range(loop->variable(), start);
+  check_range(loop->variable(), end);
+
+  // kernels only run INTEGER loops
+  if constexpr (std::is_same_v<I, int>) {
+    if (loop->kernel() != nullptr) {
+      loop->kernel()->run(&symbol_table_, start, end, loop->down());
+      *control = end;
+      return;
+    }
+  }
+
+  // stop on reaching the final value rather than passing it, which could
+  // overflow
+  if (loop->counted()) {
+    for (I value = start;; value += step) {
+      *control = value;
+      loop->body()->accept(this);
+      if (value == end) {
+        return;
+      }
+    }
+  }
+
+  *control = start;
+  while (true) {
+    loop->body()->accept(this);
+    if (loop->down() ? *control <= end : *control >= end) {
+      break;
+    }
+    *control += step;
+    check_range(loop->variable(), *control);
+  }
+}
+
 ValueAST::ValueType Interpreter::visit(const Type* type) {
   return type->value();
 }
 
-void Interpreter::visit(const VariableDeclaration* var_decl) {
-  const auto& variables = var_decl->variables();
-  for (const auto& variable : variables) {
-    const auto& var_ptr = variable.get();
-    assert(var_ptr->type_checked());
-
-    if (const auto typed_ptr = dynamic_cast<TypeChecked<Variable>*>(var_ptr);
-        typed_ptr) {
-      const auto type = typed_ptr->type();
-      if (type == ValueAST::ValueType::INTEGER) {
-        symbol_table_.define(typed_ptr->value(), 0);
-      } else {
-        symbol_table_.define(typed_ptr->value(), 0.0);
+void Interpreter::visit(const VariableDeclaration* declaration) {
+  // frames are zeroed when pushed, which is 0 and 0.0 for every slot;
+  // a subrange without 0 starts at its lower bound, so that a variable is
+  // always within its subrange; arrays get zeroed elements in the arena,
+  // sets, strings and files start empty there, and records get their
+  // fields there; a bound global uses host memory instead
+  const auto type = declaration->type();
+  if (type->value() == ValueAST::ValueType::SET) {
+    for (const auto& variable : declaration->variables()) {
+      symbol_table_.slot(variable->level(), variable->slot()).set =
+          static_cast<Set*>(symbol_table_.allocate(sizeof(Set)));
+    }
+    return;
+  }
+  if (type->value() == ValueAST::ValueType::STRING) {
+    for (const auto& variable : declaration->variables()) {
+      symbol_table_.slot(variable->level(), variable->slot()).string =
+          static_cast<String*>(symbol_table_.allocate(sizeof(String)));
+    }
+    return;
+  }
+  if (type->value() == ValueAST::ValueType::FILE) {
+    for (const auto& variable : declaration->variables()) {
+      symbol_table_.slot(variable->level(), variable->slot()).file =
+          static_cast<FileCursor*>(symbol_table_.allocate(sizeof(FileCursor)));
+    }
+    return;
+  }
+  if (const auto& record = type->record(); record != nullptr) {
+    for (const auto& variable : declaration->variables()) {
+      auto& slot = symbol_table_.slot(variable->level(), variable->slot());
+      if (const auto binding = bound(variable.get()); binding != nullptr) {
+        slot.record = binding->data;
+        continue;
       }
-    } else {
-      assert(false);
+      slot.record = symbol_table_.allocate(record->size);
+      initialize(nullptr, record.get(), static_cast<std::byte*>(slot.record));
+    }
+    return;
+  }
+  if (const auto& range = type->range(); excludes_zero(range)) {
+    for (const auto& variable : declaration->variables()) {
+      store(&symbol_table_.slot(variable->level(), variable->slot()),
+            type->value(),
+            type->value() == ValueAST::ValueType::INT64
+                ? ValueAST::Value(range->low)
+                : ValueAST::Value(static_cast<int>(range->low)));
+    }
+  }
+  const auto& array = type->array();
+  if (array == nullptr) {
+    for (const auto& variable : declaration->variables()) {
+      if (const auto binding = bound(variable.get()); binding != nullptr) {
+        std::memcpy(&symbol_table_.slot(variable->level(), variable->slot()),
+                    binding->data, binding->scalar);
+      }
+    }
+    return;
+  }
+  for (const auto& variable : declaration->variables()) {
+    auto& slot = symbol_table_.slot(variable->level(), variable->slot());
+    if (const auto binding = bound(variable.get()); binding != nullptr) {
+      slot.array = binding->data;
+      continue;
     }
+    slot.array = symbol_table_.allocate(array->bytes());
+    initialize(array.get(), array->record.get(),
+               static_cast<std::byte*>(slot.array));
   }
 }
 
@@ -56,47 +664,185 @@ ValueAST::Value Interpreter::visit(const Number* number) {
 }
 
 void Interpreter::visit(const Assign* assign) {
-  const auto var_name = assign->left()->value();
-  const auto var_value = assign->right()->accept(this);
-  global_scope_[var_name] = var_value;
+  const auto right = assign->right();
+  if (right->type() == ValueAST::ValueType::ARRAY) {
+    // the arrays are either the same or disjoint
+    const auto source = static_cast<const Variable*>(right);
+    std::memmove(slot(assign->left()).array, slot(source).array,
+                 source->array()->bytes());
+    return;
+  }
+  if (right->type() == ValueAST::ValueType::RECORD) {
+    const auto source = static_cast<const Variable*>(right);
+    std::memmove(slot(assign->left()).record, slot(source).record,
+                 source->record()->size);
+    return;
+  }
+  // the value first, then the element it is stored in; a tail call has
+  // none, its callee stores and checks the result in place of this frame
+  const auto value = right->accept(this);
+  if (tail_callee_ != nullptr) {
+    return;
+  }
+  const auto left = assign->left();
+  if (assign->checked() && (right->type() == ValueAST::ValueType::INTEGER ||
+                            right->type() == ValueAST::ValueType::INT64)) {
+    check_range(left, integer_value(value));
+  } else if (assign->checked() && right->type() == ValueAST::ValueType::SET) {
+    check_members(left, std::get<Set>(value));
+  }
+  if (left->packed_size() != 0) {
+    store_integer(reinterpret_cast<std::byte*>(&slot(left)),
+                  left->packed_size(), integer_value(value));
+    return;
+  }
+  store(&slot(left), right->type(), value);
 }
 
 ValueAST::Value Interpreter::visit(const Variable* variable) {
-  if (auto it = global_scope_.find(variable->value());
-      it != global_scope_.end()) {
-    return it->second;
-  } else {
-    error("variable " + variable->value() + " does not exist!");
-    return -1;
+  if (variable->packed_size() != 0) {
+    const auto value =
+        load_integer(reinterpret_cast<const std::byte*>(&slot(variable)),
+                     variable->packed_size(), is_signed(variable->range()));
+    if (variable->type() == ValueAST::ValueType::INT64) {
+      return value;
+    }
+    return static_cast<int>(value);
+  }
+  return load(slot(variable), variable->type());
+}
+
+ValueAST::Value Interpreter::visit(const SetConstructor* constructor) {
+  if (constructor->constant().has_value()) {
+    return *constructor->constant();
   }
+  Set result;
+  for (const auto& element : constructor->elements()) {
+    const int low = std::get<int>(element.low->accept(this));
+    const int high = element.high != nullptr
+                         ? std::get<int>(element.high->accept(this))
+                         : low;
+    if (low > high) {
+      continue;
+    }
+    if (low < 0 || high > Set::MAX_MEMBER) {
+      error("set member " + std::to_string(low < 0 ? low : high) +
+            " is out of range");
+    }
+    result.insert(low, high);
+  }
+  return result;
 }
 
+template <class F>
+ValueAST::Value Interpreter::setOperate(const BinaryOperation* node, F&& f) {
+  const auto left = std::get<Set>(node->left()->accept(this));
+  return f(left, std::get<Set>(node->right()->accept(this)));
+}
+
+// the semantic analyzer gave both operands one type, so the alternatives
+// they hold follow from it
 template <class F>
 ValueAST::Value Interpreter::binaryOperateValueAST(const ValueAST* left,
                                                    const ValueAST* right,
                                                    F&& f) {
   const auto left_value = left->accept(this);
   const auto right_value = right->accept(this);
-  if (std::holds_alternative<int>(left_value) &&
-      std::holds_alternative<int>(right_value)) {
-    return f(std::get<int>(left_value), std::get<int>(right_value));
-  } else if (std::holds_alternative<double>(left_value) &&
-             std::holds_alternative<double>(right_value)) {
-    return f(std::get<double>(left_value), std::get<double>(right_value));
-  } else if (std::holds_alternative<int>(left_value) &&
-             std::holds_alternative<double>(right_value)) {
-    return f(std::get<int>(left_value), std::get<double>(right_value));
-  } else if (std::holds_alternative<double>(left_value) &&
-             std::holds_alternative<int>(right_value)) {
-    return f(std::get<double>(left_value), std::get<int>(right_value));
-  } else {
-    throw std::runtime_error("Invalid ValueAST::Value");
+  switch (left->type()) {
+    case ValueAST::ValueType::REAL:
+      return f(std::get<double>(left_value), std::get<double>(right_value));
+    case ValueAST::ValueType::INT64:
+      return f(std::get<int64_t>(left_value), std::get<int64_t>(right_value));
+    default:
+      return f(std::get<int>(left_value), std::get<int>(right_value));
   }
 }
 
+ValueAST::Value Interpreter::string_operation(const BinaryOperation* node) {
+  using BinaryOperator = BinaryOperation::Operator;
+  const auto left = std::get<String>(node->left()->accept(this));
+  const auto right = std::get<String>(node->right()->accept(this));
+  switch (node->op()) {
+    case BinaryOperator::PLUS:
+      return strings_.concat(left, right);
+    case BinaryOperator::EQUAL:
+      return static_cast<int>(left == right);
+    case BinaryOperator::NOT_EQUAL:
+      return static_cast<int>(left != right);
+    case BinaryOperator::LESS:
+      return static_cast<int>(left < right);
+    case BinaryOperator::LESS_EQUAL:
+      return static_cast<int>(left <= right);
+    case BinaryOperator::GREATER:
+      return static_cast<int>(left > right);
+    default:
+      return static_cast<int>(left >= right);
+  }
+}
+
+// INTEGER and INT64 results that do not fit wrap around, which is only
+// seen when the operation is not checked: the range analyzer proved that
+// they fit, or the optimizer made the operation and does not use such a
+// result
+template <class I>
+ValueAST::Value Interpreter::integer_arithmetic(const BinaryOperation* node) {
+  using BinaryOperator = BinaryOperation::Operator;
+  const I left = std::get<I>(node->left()->accept(this));
+  const I right = std::get<I>(node->right()->accept(this));
+  I result;
+  bool overflow;
+  switch (node->op()) {
+    case BinaryOperator::PLUS:
+      overflow = __builtin_add_overflow(left, right, &result);
+      break;
+    case BinaryOperator::MINUS:
+      overflow = __builtin_sub_overflow(left, right, &result);
+      break;
+    case BinaryOperator::MULTIPLY:
+      overflow = __builtin_mul_overflow(left, right, &result);
+      break;
+    default:
+      if (node->checked() && right == 0) {
+        error("division by zero");
+      }
+      overflow = right == -1 && left == std::numeric_limits<I>::min();
+      result = overflow ? left : left / right;
+      break;
+  }
+  if (overflow && node->checked()) {
+    error("integer overflow");
+  }
+  return result;
+}
+
 ValueAST::Value Interpreter::visit(const BinaryOperation* node) {
   using BinaryOperator = BinaryOperation::Operator;
 
+  if (node->type() == ValueAST::ValueType::INTEGER) {
+    switch (node->op()) {
+      case BinaryOperator::PLUS:
+      case BinaryOperator::MINUS:
+      case BinaryOperator::MULTIPLY:
+      case BinaryOperator::INTEGER_DIV:
+        return integer_arithmetic<int>(node);
+      default:
+        break;
+    }
+  }
+  if (node->type() == ValueAST::ValueType::INT64) {
+    return integer_arithmetic<int64_t>(node);
+  }
+  if (node->left()->type() == ValueAST::ValueType::STRING) {
+    return string_operation(node);
+  }
+  // pointers are only compared for identity
+  if (node->left()->type() == ValueAST::ValueType::POINTER) {
+    const auto left = std::get<void*>(node->left()->accept(this));
+    const auto right = std::get<void*>(node->right()->accept(this));
+    return static_cast<int>((left == right) ==
+                            (node->op() == BinaryOperator::EQUAL));
+  }
+
   // get runtime value of std::variant
   switch (node->op()) {
     case BinaryOperator::PLUS:
@@ -111,15 +857,87 @@ ValueAST::Value Interpreter::visit(const BinaryOperation* node) {
       return binaryOperateValueAST(
           node->left(), node->right(),
           [](auto&& left, auto&& right) { return left * right; });
-    case BinaryOperator::INTEGER_DIV:
-      return binaryOperateValueAST(
-          node->left(), node->right(), [](auto&& left, auto&& right) {
-            return static_cast<int>(left) / static_cast<int>(right);
-          });
+    case BinaryOperator::SHIFT_DIV: {
+      // DIV truncates toward zero, so negative dividends are biased by
+      // 2^k - 1 before the arithmetic shift
+      const int left = std::get<int>(node->left()->accept(this));
+      const int shift = std::get<int>(node->right()->accept(this));
+      return (left + ((left >> 31) & ((1 << shift) - 1))) >> shift;
+    }
     case BinaryOperator::REAL_DIV:
       return binaryOperateValueAST(
           node->left(), node->right(),
           [](auto&& left, auto&& right) { return left / right; });
+    case BinaryOperator::EQUAL:
+      return binaryOperateValueAST(
+          node->left(), node->right(), [](auto&& left, auto&& right) {
+            return static_cast<int>(left == right);
+          });
+    case BinaryOperator::NOT_EQUAL:
+      return binaryOperateValueAST(
+          node->left(), node->right(), [](auto&& left, auto&& right) {
+            return static_cast<int>(left != right);
+          });
+    case BinaryOperator::LESS:
+      return binaryOperateValueAST(
+          node->left(), node->right(), [](auto&& left, auto&& right) {
+            return static_cast<int>(left < right);
+          });
+    case BinaryOperator::LESS_EQUAL:
+      return binaryOperateValueAST(
+          node->left(), node->right(), [](auto&& left, auto&& right) {
+            return static_cast<int>(left <= right);
+          });
+    case BinaryOperator::GREATER:
+      return binaryOperateValueAST(
+          node->left(), node->right(), [](auto&& left, auto&& right) {
+            return static_cast<int>(left > right);
+          });
+    case BinaryOperator::GREATER_EQUAL:
+      return binaryOperateValueAST(
+          node->left(), node->right(), [](auto&& left, auto&& right) {
+            return static_cast<int>(left >= right);
+          });
+    // the right operand is only evaluated when it decides the result
+    case BinaryOperator::AND:
+      return static_cast<int>(test(node->left(), this) &&
+                              test(node->right(), this));
+    case BinaryOperator::OR:
+      return static_cast<int>(test(node->left(), this) ||
+                              test(node->right(), this));
+    case BinaryOperator::IN: {
+      const int member = std::get<int>(node->left()->accept(this));
+      return static_cast<int>(
+          std::get<Set>(node->right()->accept(this)).contains(member));
+    }
+    case BinaryOperator::UNION:
+      return setOperate(node, [](const Set& left, const Set& right) {
+        return left | right;
+      });
+    case BinaryOperator::INTERSECTION:
+      return setOperate(node, [](const Set& left, const Set& right) {
+        return left & right;
+      });
+    case BinaryOperator::DIFFERENCE:
+      return setOperate(node, [](const Set& left, const Set& right) {
+        return left - right;
+      });
+    case BinaryOperator::SET_EQUAL:
+      return setOperate(node, [](const Set& left, const Set& right) {
+        return static_cast<int>(left == right);
+      });
+    case BinaryOperator::SET_NOT_EQUAL:
+      return setOperate(node, [](const Set& left, const Set& right) {
+        return static_cast<int>(left != right);
+      });
+    case BinaryOperator::SUBSET:
+      return setOperate(node, [](const Set& left, const Set& right) {
+        return static_cast<int>(left.subset_of(right));
+      });
+    case BinaryOperator::SUPERSET:
+      return setOperate(node, [](const Set& left, const Set& right) {
+        return static_cast<int>(right.subset_of(left));
+      });
     default:
       throw std::runtime_error("Invalid BinaryOperator");
   }
@@ -128,12 +946,13 @@ ValueAST::Value Interpreter::visit(const BinaryOperation* node) {
 template <class F>
 ValueAST::Value Interpreter::unaryOperate(const ValueAST* expr, F&& f) {
   const auto expr_value = expr->accept(this);
-  if (std::holds_alternative<int>(expr_value)) {
-    return f(std::get<int>(expr_value));
-  } else if (std::holds_alternative<double>(expr_value)) {
-    return f(std::get<double>(expr_value));
-  } else {
-    throw std::runtime_error("Invalid ValueAST::Value");
+  switch (expr->type()) {
+    case ValueAST::ValueType::REAL:
+      return f(std::get<double>(expr_value));
+    case ValueAST::ValueType::INT64:
+      return f(std::get<int64_t>(expr_value));
+    default:
+      return f(std::get<int>(expr_value));
   }
 }
 
@@ -143,7 +962,43 @@ ValueAST::Value Interpreter::visit(const UnaryOperation* node) {
     case UnaryOperator::PLUS:
       return unaryOperate(node->expr(), [](auto&& expr) { return expr; });
     case UnaryOperator::MINUS:
+      if (node->type() == ValueAST::ValueType::INTEGER) {
+        const int value = std::get<int>(node->expr()->accept(this));
+        if (value == std::numeric_limits<int>::min() && node->checked()) {
+          error("integer overflow");
+        }
+        return static_cast<int>(0u - static_cast<unsigned>(value));
+      }
+      if (node->type() == ValueAST::ValueType::INT64) {
+        const auto value = std::get<int64_t>(node->expr()->accept(this));
+        if (value == std::numeric_limits<int64_t>::min() && node->checked()) {
+          error("integer overflow");
+        }
+        return static_cast<int64_t>(0ull - static_cast<uint64_t>(value));
+      }
       return unaryOperate(node->expr(), [](auto&& expr) { return -expr; });
+    case UnaryOperator::NOT:
+      return static_cast<int>(!test(node->expr(), this));
+    case UnaryOperator::CARD:
+      return std::get<Set>(node->expr()->accept(this)).size();
+    case UnaryOperator::END_OF_FILE: {
+      const auto cursor = slot(static_cast<const Variable*>(node->expr())).file;
+      return static_cast<int>(cursor->next == cursor->end);
+    }
+    case UnaryOperator::CONVERT: {
+      const auto value = node->expr()->accept(this);
+      if (node->type() == ValueAST::ValueType::INT64) {
+        return integer_value(value);
+      }
+      if (node->type() == ValueAST::ValueType::REAL) {
+        return static_cast<double>(integer_value(value));
+      }
+      const auto wide = std::get<int64_t>(value);
+      if (node->checked() && !Interval::integer().contains({wide, wide})) {
+        error("value " + std::to_string(wide) + " does not fit in INTEGER");
+      }
+      return static_cast<int>(wide);
+    }
     default:
       throw std::runtime_error("Invalid UnaryOperator");
   }
@@ -155,17 +1010,237 @@ void Interpreter::visit(const Compound* node) {
   }
 }
 
+void Interpreter::visit(const Case* statement) {
+  const auto value = integer_value(statement->selector()->accept(this));
+  if (const int branch = statement->branch(value); branch >= 0) {
+    statement->branches()[branch].statement->accept(this);
+  } else if (statement->else_statement() != nullptr) {
+    statement->else_statement()->accept(this);
+  }
+}
+
+// a new block is initialized like a variable of its target type
+void Interpreter::visit(const Write* write) {
+  char text[FORMATTED];
+  for (const auto& argument : write->arguments()) {
+    const auto value = argument.value->accept(this);
+    int decimals = -1;
+    if (argument.precision != nullptr) {
+      decimals = std::get<int>(argument.precision->accept(this));
+      if (decimals < 0 || decimals > MAX_DECIMALS) {
+        error("cannot write " + std::to_string(decimals) + " decimals");
+      }
+    }
+    const auto formatted = format(value, argument.type, decimals, text);
+    if (argument.width != nullptr) {
+      const int width = std::get<int>(argument.width->accept(this));
+      output_.append(formatted, std::max(width, 0));
+    } else {
+      output_.append(formatted);
+    }
+  }
+  if (write->line()) {
+    output_.append("\n");
+  }
+}
+
+void Interpreter::set_output(OutputSink* sink) {
+  output_.set_sink(sink != nullptr ? sink : &stdout_sink_);
+}
+
+void Interpreter::store_read(const Variable* variable,
+                             ValueAST::ValueType type,
+                             const ValueAST::Value& value) {
+  if (type != ValueAST::ValueType::REAL) {
+    check_range(variable, integer_value(value));
+  }
+  if (variable->packed_size() != 0) {
+    store_integer(reinterpret_cast<std::byte*>(&slot(variable)),
+                  variable->packed_size(), integer_value(value));
+    return;
+  }
+  store(&slot(variable), type, value);
+}
+
+void Interpreter::visit(const Read* read) {
+  const auto& variables = read->variables();
+  const auto& types = read->types();
+  if (!read->from_file()) {
+    for (size_t i = 0; i < variables.size(); ++i) {
+      const auto variable = variables[i].get();
+      ValueAST::Value value;
+      TextInput::Status status;
+      if (types[i] == ValueAST::ValueType::REAL) {
+        double number;
+        status = input_.read(&number);
+        value = number;
+      } else if (types[i] == ValueAST::ValueType::INT64) {
+        int64_t number;
+        status = input_.read(&number);
+        value = number;
+      } else {
+        int number;
+        status = input_.read(&number);
+        value = number;
+      }
+      if (status == TextInput::Status::END) {
+        error("end of input reading " + variable->value());
+      } else if (status == TextInput::Status::INVALID) {
+        error("input " + input_.next_token() + " cannot be read into " +
+              variable->value());
+      } else if (status == TextInput::Status::RANGE) {
+        error("input " + input_.next_token() + " is out of range for " +
+              variable->value());
+      }
+      store_read(variable, types[i], value);
+    }
+    if (read->line()) {
+      input_.skip_line();
+    }
+    return;
+  }
+
+  // the elements are copied as they are; an array takes as many as it has
+  // in one copy
+  auto& cursor = *slot(variables[0].get()).file;
+  for (size_t i = 1; i < variables.size(); ++i) {
+    const auto variable = variables[i].get();
+    size_t bytes;
+    void* target = nullptr;
+    if (types[i] == ValueAST::ValueType::ARRAY) {
+      bytes = variable->array()->bytes();
+      target = slot(variable).array;
+    } else if (types[i] == ValueAST::ValueType::RECORD) {
+      bytes = variable->record()->size;
+      target = slot(variable).record;
+    } else {
+      bytes = scalar_size(types[i], std::nullopt, false);
+    }
+    if (static_cast<size_t>(cursor.end - cursor.next) < bytes) {
+      error("end of file " + variables[0]->value() + " reading " +
+            variable->value());
+    }
+    if (target != nullptr) {
+      std::memcpy(target, cursor.next, bytes);
+    } else if (types[i] == ValueAST::ValueType::REAL) {
+      double number;
+      std::memcpy(&number, cursor.next, bytes);
+      store_read(variable, types[i], number);
+    } else if (types[i] == ValueAST::ValueType::INT64) {
+      int64_t number;
+      std::memcpy(&number, cursor.next, bytes);
+      store_read(variable, types[i], number);
+    } else {
+      int number;
+      std::memcpy(&number, cursor.next, bytes);
+      store_read(variable, types[i], number);
+    }
+    cursor.next += bytes;
+  }
+}
+
+// a file RESET more than once in a run is mapped once
+void Interpreter::visit(const Reset* reset) {
+  const auto path = std::string(
+      std::get<String>(reset->path()->accept(this)).view());
+  auto it = files_.find(path);
+  if (it == files_.end()) {
+    try {
+      it = files_.try_emplace(path, path).first;
+    } catch (const std::runtime_error& failure) {
+      error(failure.what());
+    }
+  }
+  const auto text = it->second.view();
+  if (text.size() % reset->element_size() != 0) {
+    error("file " + path + " does not hold whole elements of " +
+          reset->variable()->value());
+  }
+  auto& cursor = *slot(reset->variable()).file;
+  cursor.next = reinterpret_cast<const std::byte*>(text.data());
+  cursor.end = cursor.next + text.size();
+}
+
+void Interpreter::visit(const HeapOperation* operation) {
+  auto& pointer = slot(operation->variable()).pointer;
+  if (operation->op() == HeapOperation::Operator::NEW) {
+    const auto bytes =
+        static_cast<std::byte*>(heap_.allocate(operation->size()));
+    if (operation->record() != nullptr) {
+      initialize(nullptr, operation->record().get(), bytes);
+    } else if (excludes_zero(operation->range())) {
+      store_integer(bytes, operation->size(), operation->range()->low);
+    }
+    pointer = bytes;
+    return;
+  }
+  if (pointer == nullptr) {
+    error("NIL pointer disposed of in " + operation->variable()->value());
+  }
+  heap_.release(pointer, operation->size());
+  pointer = nullptr;
+}
+
+Boxed Interpreter::global(const std::string& name) const {
+  if (global_frame_ != nullptr) {
+    for (const auto& declaration : global_frame_->block->var_declarations()) {
+      for (const auto& variable : declaration->variables()) {
+        if (variable->value() == name) {
+          if (declaration->type()->array() != nullptr) {
+            throw std::runtime_error("global variable " + name +
+                                     " is an array");
+          }
+          if (declaration->type()->record() != nullptr) {
+            throw std::runtime_error("global variable " + name +
+                                     " is a record");
+          }
+          if (declaration->type()->file() != nullptr) {
+            throw std::runtime_error("global variable " + name +
+                                     " is a file");
+          }
+          return box(global_frame_->slots[variable->slot()],
+                     declaration->type()->value());
+        }
+      }
+    }
+  }
+  throw std::runtime_error("global variable " + name + " not found");
+}
+
 void Interpreter::print_global_scope() const {
-  // use spdlog to print global scope
-  auto logger = spdlog::stdout_color_mt("Interpreter");
+  // use spdlog to print global scope; the logger is registered once, by
+  // whichever context prints first
+  static const auto logger = [] {
+    auto logger = spdlog::get("Interpreter");
+    return logger != nullptr ? logger
+                             : spdlog::stdout_color_mt("Interpreter");
+  }();
   logger->info("Global scope:");
-  for (const auto& [key, value] : global_scope_) {
-    if (std::holds_alternative<int>(value)) {
-      logger->info("{}: {}", key, std::get<int>(value));
-    } else if (std::holds_alternative<double>(value)) {
-      logger->info("{}: {}", key, std::get<double>(value));
-    } else {
-      throw std::runtime_error("Invalid ValueAST::Value");
+  if (global_frame_ == nullptr) {
+    return;
+  }
+  for (const auto& declaration : global_frame_->block->var_declarations()) {
+    const auto type = declaration->type()->value();
+    for (const auto& variable : declaration->variables()) {
+      const auto& slot = global_frame_->slots[variable->slot()];
+      if (type == ValueAST::ValueType::ARRAY) {
+        logger->info("{}: {}", variable->value(),
+                     elements(*declaration->type()->array(), slot.array));
+      } else if (type == ValueAST::ValueType::RECORD) {
+        const auto bytes = static_cast<const std::byte*>(slot.record);
+        logger->info("{}: {}", variable->value(),
+                     record_text(*declaration->type()->record(), 0,
+                                 [&](int64_t offset, int64_t) {
+                                   return bytes + offset;
+                                 }));
+      } else if (type == ValueAST::ValueType::FILE) {
+        const auto& file = *declaration->type()->file();
+        logger->info("{}: {}, {} unread", variable->value(), file.to_string(),
+                     (slot.file->end - slot.file->next) / file.element_size());
+      } else {
+        logger->info("{}: {}", variable->value(),
+                     box(slot, type).to_string());
+      }
     }
   }
 }
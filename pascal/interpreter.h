@@ -2,9 +2,17 @@
 
 #pragma once
 
+#include <cstdint>
+#include <cstdio>
+#include <map>
 #include <string>
-#include <unordered_map>
+#include <string_view>
+#include <vector>
 #include "ast.h"
+#include "boxed_value.h"
+#include "heap.h"
+#include "input.h"
+#include "output.h"
 #include "symbol_table.h"
 
 namespace Pascal {
@@ -12,8 +20,87 @@ namespace Pascal {
 class Interpreter : public Visitor {
  private:
   V::SymbolTable symbol_table_;
+
+  // the strings built by the last run
+  StringHeap strings_;
+
+  // the blocks NEW allocated in the last run
+  Heap heap_;
+
+  // what WRITE and WRITELN produce goes to stdout unless the caller sets
+  // another sink
+  FileSink stdout_sink_{stdout};
+  OutputBuffer output_{&stdout_sink_};
+
+  // what READ parses, stdin unless the caller sets another input; a run
+  // reads on where the last one stopped
+  TextInput input_{stdin};
+
+  // the files RESET mapped in the last run, by path
+  std::map<std::string, MappedFile> files_;
+
+  // host memory bound to global variables, by slot; see bind
+  struct Binding {
+    void* data = nullptr;
+    // bytes of a scalar, which is copied; 0 for an array or record
+    size_t scalar = 0;
+  };
+  std::vector<Binding> bound_;
+
+  // the program's frame, kept after the run
+  const V::Frame* global_frame_ = nullptr;
+
+  // callee of a call in tail position; its frame has been pushed on top of
+  // the running one, which run replaces with it
+  const ProcedureDeclaration* tail_callee_ = nullptr;
+
+  // every call that is not a tail call recurses on the native stack, so
+  // calls nest at most this many bytes below the start of the run
+  static constexpr uintptr_t NATIVE_STACK_LIMIT = 4 << 20;
+  uintptr_t stack_base_ = 0;
+
   void error(const std::string& msg);
 
+  // what is bound to a variable of the global frame, nullptr for a
+  // variable that is not bound or not global
+  const Binding* bound(const Variable* variable) const;
+
+  // store the bound scalars back into host memory; cannot fail, so it also
+  // runs while the error of a run propagates
+  void store_bound() noexcept;
+
+  V::Slot& slot(const Variable* variable);
+
+  // the element of the array stored at elements a variable selects
+  V::Slot& element(const Variable* variable, void* elements);
+
+  // fail unless value is within the subrange of variable, if it has one
+  void check_range(const Variable* variable, int64_t value);
+
+  // store a value READ parsed or copied from a file
+  void store_read(const Variable* variable, ValueAST::ValueType type,
+                  const ValueAST::Value& value);
+
+  // fail unless every member of value is one variable, a set, may have
+  void check_members(const Variable* variable, const Set& value);
+
+  template <class I>
+  ValueAST::Value integer_arithmetic(const BinaryOperation* node);
+
+  // a FOR loop whose control variable is the I member of its slot
+  template <class I>
+  void run_loop(const For* loop, I* control);
+
+  // concatenation and comparison of two strings
+  ValueAST::Value string_operation(const BinaryOperation* node);
+
+  // push the callee's frame with its arguments and run it unless the call
+  // is a tail call; returns the result of a function
+  template <class Call>
+  V::Slot call(const Call* call);
+
+  V::Slot run(const ProcedureDeclaration* procedure, V::Frame* frame);
+
   template <class F>
   ValueAST::Value binaryOperateValueAST(const ValueAST* left,
                                         const ValueAST* right, F&& f);
@@ -21,9 +108,33 @@ class Interpreter : public Visitor {
   template <class F>
   ValueAST::Value unaryOperate(const ValueAST* expr, F&& f);
 
+  template <class F>
+  ValueAST::Value setOperate(const BinaryOperation* node, F&& f);
+
  public:
   void print_global_scope() const;
 
+  // where the output of later runs goes, stdout for nullptr; the sink has
+  // to outlive the runs
+  void set_output(OutputSink* sink);
+
+  // what READ parses in later runs; text has to outlive them, a stream is
+  // read in large chunks
+  void set_input(std::string_view text) { input_.set_text(text); }
+
+  void set_input(std::FILE* file) { input_.set_file(file); }
+
+  // run the global variable in slot in host memory data from the next
+  // run on, nullptr unbinds it; data has to outlive the runs. The
+  // elements of an ARRAY and the fields of a RECORD are used in place, a
+  // scalar of that many bytes is loaded into its slot when a run starts
+  // and stored back when it ends, also if it fails
+  void bind(int slot, void* data, size_t scalar = 0);
+
+  // value of a global scalar variable after the run; a cell that points
+  // into the run's storage stays valid until the next run
+  Boxed global(const std::string& name) const;
+
   ValueAST::Value visit(const BinaryOperation* binary_op) override;
 
   ValueAST::Value visit(const UnaryOperation* unary_op) override;
@@ -32,6 +143,10 @@ class Interpreter : public Visitor {
 
   ValueAST::Value visit(const Variable* variable) override;
 
+  ValueAST::Value visit(const FunctionCall* call) override;
+
+  ValueAST::Value visit(const SetConstructor* constructor) override;
+
   void visit(const Compound* compound) override;
 
   void visit(const Assign* assign) override;
@@ -44,6 +159,28 @@ class Interpreter : public Visitor {
 
   void visit(const ProcedureDeclaration*) override;
 
+  void visit(const Parameter*) override;
+
+  void visit(const ProcedureCall* call) override;
+
+  void visit(const If* statement) override;
+
+  void visit(const While* loop) override;
+
+  void visit(const Repeat* loop) override;
+
+  void visit(const For* loop) override;
+
+  void visit(const Case* statement) override;
+
+  void visit(const HeapOperation* operation) override;
+
+  void visit(const Write* write) override;
+
+  void visit(const Read* read) override;
+
+  void visit(const Reset* reset) override;
+
   ValueAST::ValueType visit(const Type* type) override;
 };
 }  // namespace Pascal
@@ -1,41 +1,171 @@
 // Copyright 2023 Zhu Junhui
 
+#include <algorithm>
+#include <cstdio>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <string>
-// #include "interpreter.h"
+#include <string_view>
+#include <thread>
+#include <vector>
 #include "ast_printer.h"
+#include "batch_runner.h"
+#include "compiled_program.h"
 #include "io.h"
 #include "meta.h"
 #include "parser.h"
-#include "semantic_analyzer.h"
+#include "thread_pool.h"
+
+namespace {
+
+// records run at a time, so that their outputs need not all be kept
+constexpr size_t BATCH_RECORDS = 1 << 20;
+
+// run program once per line of input, the line being all it reads, and
+// write what the runs write in the order of the lines; returns how many
+// runs failed
+size_t run_batch(std::shared_ptr<const Pascal::CompiledProgram> program,
+                 Pascal::ThreadPool* pool, std::string_view input,
+                 Pascal::OutputSink* sink) {
+  std::vector<std::string_view> lines;
+  while (!input.empty()) {
+    const auto end = input.find('\n');
+    lines.push_back(input.substr(0, end));
+    input.remove_prefix(end == std::string_view::npos ? input.size()
+                                                      : end + 1);
+  }
+
+  Pascal::BatchRunner runner(std::move(program), pool);
+  std::vector<std::string> outputs;
+  std::vector<std::string> errors;
+  size_t failed = 0;
+  for (size_t first = 0; first < lines.size(); first += BATCH_RECORDS) {
+    const size_t count = std::min(BATCH_RECORDS, lines.size() - first);
+    outputs.assign(count, std::string());
+    errors.assign(count, std::string());
+    failed += runner.run(
+        count,
+        [&](Pascal::ExecutionContext* context, size_t record) {
+          context->set_input(lines[first + record]);
+        },
+        nullptr, outputs, errors);
+    for (size_t record = 0; record < count; ++record) {
+      sink->write(outputs[record]);
+      if (!errors[record].empty()) {
+        std::cerr << "record " << first + record + 1 << ": "
+                  << errors[record] << "\n";
+      }
+    }
+  }
+  return failed;
+}
+
+}  // namespace
 
 int main(int argc, char* argv[]) {
-  if (argc != 2) {
-    std::cerr << "Usage: " << argv[0] << " <filename>\n";
+  // --lazy: only pre-parse procedure bodies until they are referenced
+  // --no-optimize: run the checked tree as written
+  // --output FILE: what the program writes goes to FILE, not stdout
+  // --input FILE: what the program reads comes from FILE, mapped, not
+  // from stdin
+  // --batch: run the program once per line of the input, on every core,
+  // each run reading only its line; the globals are not shown
+  // --threads N: workers of a batch, one per core by default
+  bool lazy = false;
+  bool optimize = true;
+  bool batch = false;
+  size_t threads = std::thread::hardware_concurrency();
+  const char* output = nullptr;
+  const char* input = nullptr;
+  int arg = 1;
+  for (; arg < argc - 1; ++arg) {
+    if (std::string(argv[arg]) == "--lazy") {
+      lazy = true;
+    } else if (std::string(argv[arg]) == "--no-optimize") {
+      optimize = false;
+    } else if (std::string(argv[arg]) == "--batch") {
+      batch = true;
+    } else if (std::string(argv[arg]) == "--threads" && arg < argc - 2) {
+      threads = std::stoul(argv[++arg]);
+    } else if (std::string(argv[arg]) == "--output" && arg < argc - 2) {
+      output = argv[++arg];
+    } else if (std::string(argv[arg]) == "--input" && arg < argc - 2) {
+      input = argv[++arg];
+    } else {
+      break;
+    }
+  }
+  if (arg != argc - 1 || (batch && input == nullptr)) {
+    std::cerr << "Usage: " << argv[0]
+              << " [--lazy] [--no-optimize] [--output FILE] [--input FILE]"
+                 " [--batch [--threads N]] <filename>\n"
+                 "--batch needs --input\n";
     return 1;
   }
 
-  const auto text = Pascal::read_file(argv[1]);
+  const auto text = Pascal::read_file(argv[argc - 1]);
 
-  Pascal::Parser parser(text);
-  auto tree = parser.parse();
+  // a batch keeps every worker busy on its own core
+  Pascal::ThreadPool pool(threads, batch);
+  // errors in the program are reported, not thrown out of main
+  std::shared_ptr<const Pascal::CompiledProgram> program;
+  try {
+    if constexpr (Pascal::DEBUG) {
+      Pascal::Parser parser(text);
+      parser.set_lazy_procedures(lazy);
+      auto tree = parser.parse();
+      auto printer = Pascal::Printer();
+      std::cout << "Before semantic analysis:\n";
+      tree->accept(&printer);
+    }
+    program = Pascal::CompiledProgram::compile(
+        text, {.lazy = lazy, .optimize = optimize, .pool = &pool});
+  } catch (const std::exception& error) {
+    std::cerr << error.what() << "\n";
+    return 1;
+  }
 
   if constexpr (Pascal::DEBUG) {
     auto printer = Pascal::Printer();
-    std::cout << "Before semantic analysis:\n";
-    tree->accept(&printer);
+    printer.set_type_checked(true);
+    std::cout << "After semantic analysis:\n";
+    program->program().accept(&printer);
   }
 
-  Pascal::SemanticAnalyzer analyzer;
-  analyzer.analyze(tree.get());
+  std::unique_ptr<std::FILE, decltype(&std::fclose)> file(nullptr,
+                                                           &std::fclose);
+  if (output != nullptr) {
+    file.reset(std::fopen(output, "w"));
+    if (file == nullptr) {
+      std::cerr << "cannot open " << output << "\n";
+      return 1;
+    }
+  }
+  Pascal::FileSink sink(file != nullptr ? file.get() : stdout);
+  std::unique_ptr<Pascal::MappedFile> mapped;
+  if (input != nullptr) {
+    mapped = std::make_unique<Pascal::MappedFile>(input);
+  }
 
-  if constexpr (Pascal::DEBUG) {
-    auto printer = Pascal::Printer();
-    printer.set_type_checked(true);
-    std::cout << "Before semantic analysis:\n";
-    tree->accept(&printer);
+  if (batch) {
+    return run_batch(program, &pool, mapped->view(), &sink) == 0 ? 0 : 1;
+  }
+
+  Pascal::ExecutionContext context(program);
+  if (file != nullptr) {
+    context.set_output(&sink);
+  }
+  if (mapped != nullptr) {
+    context.set_input(mapped->view());
+  }
+  try {
+    context.run();
+  } catch (const std::exception& error) {
+    std::cerr << error.what() << "\n";
+    return 1;
   }
+  context.print_global_scope();
 
   return 0;
 }
@@ -0,0 +1,159 @@
+// Copyright 2023 Zhu Junhui
+
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "compiled_program.h"
+
+// Runs small programs, optimized and as written, and checks the global
+// variables they end with or the error they stop with: tail calls, which
+// must neither grow the stack nor skip the range of a result, FOR loops,
+// which run as many times as their bounds said on entry, the three ways
+// CASE finds a branch, and loops run as kernels, which have to fail like
+// the loops they replace.
+
+namespace {
+
+// "name=value" of every name after the run, or the error it stopped with
+std::string run(const std::string& source, bool optimize,
+                const std::vector<std::string>& names) {
+  Pascal::ExecutionContext context(
+      Pascal::CompiledProgram::compile(source, {.optimize = optimize}));
+  try {
+    context.run();
+  } catch (const std::runtime_error& error) {
+    return error.what();
+  }
+  std::string globals;
+  for (const auto& name : names) {
+    globals += (globals.empty() ? "" : " ") + name + "=" +
+               context.global(name).to_string();
+  }
+  return globals;
+}
+
+// the dispatch of every CASE the first procedure consists of, L, T or S
+std::string dispatches(const std::string& source) {
+  static constexpr char KIND[] = {'L', 'T', 'S'};
+  const auto program = Pascal::CompiledProgram::compile(source);
+  const auto& procedure =
+      program->program().block()->procedures_declarations().front();
+  std::string kinds;
+  for (const auto& child :
+       procedure->block()->compound_statement()->children()) {
+    if (const auto statement = dynamic_cast<const Pascal::Case*>(&*child)) {
+      kinds += KIND[static_cast<int>(statement->dispatch())];
+    }
+  }
+  return kinds;
+}
+
+bool expect(const std::string& what, const std::string& source,
+            const std::vector<std::string>& names,
+            const std::string& expected) {
+  bool ok = true;
+  for (const bool optimize : {true, false}) {
+    const auto actual = run(source, optimize, names);
+    if (actual != expected) {
+      std::cerr << what << (optimize ? "" : " unoptimized") << ": " << actual
+                << " instead of " << expected << "\n";
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+// far deeper than the stack of frames, unless the calls reuse theirs
+const char* const TAIL_CALLS =
+    "PROGRAM Tail; "
+    "VAR r, s : INTEGER; "
+    "FUNCTION F(n : INTEGER) : 1..100; "
+    "BEGIN IF n = 0 THEN F := 7 ELSE F := F(n - 1) END; "
+    "FUNCTION Pong(n : INTEGER) : INTEGER; "
+    "BEGIN IF n = 0 THEN Pong := 2 ELSE Pong := Ping(n - 1) END; "
+    "FUNCTION Ping(n : INTEGER) : INTEGER; "
+    "BEGIN IF n = 0 THEN Ping := 1 ELSE Ping := Pong(n - 1) END; "
+    "BEGIN r := F(100000); s := Ping(100001) END.";
+
+// G's result is no BYTE, so F has to check it
+const char* const NARROWING =
+    "PROGRAM Narrow; "
+    "VAR r : INTEGER; "
+    "FUNCTION G(n : INTEGER) : INTEGER; BEGIN G := n END; "
+    "FUNCTION F(n : INTEGER) : BYTE; BEGIN F := G(n) END; "
+    "BEGIN r := F(500) END.";
+
+// bodies moving the final value, which was evaluated before them
+const char* const BOUNDS =
+    "PROGRAM Bounds; "
+    "VAR i, n, t, d : INTEGER; "
+    "BEGIN n := 3; t := 0; d := 0; "
+    "FOR i := 1 TO n DO BEGIN n := n + 1; t := t + i END; "
+    "FOR i := n DIV 2 DOWNTO 1 DO BEGIN n := n - 1; d := d + 1 END "
+    "END.";
+
+// a jump table, a binary search and two linear ones, the last on INT64
+const char* const CASES =
+    "PROGRAM Cases; "
+    "VAR i, t, s, l, e, g, n : INTEGER; "
+    "PROCEDURE Count(i : INTEGER); "
+    "VAR big : INT64; "
+    "BEGIN "
+    "CASE i OF 0: t := t + 1; 1, 2: t := t + 10; 3..5: t := t + 100; "
+    "6: t := t + 1000; 7: t := t + 10000 END; "
+    "CASE i * 1000 OF 0: s := s + 1; 2000: s := s + 10; "
+    "4000..5000: s := s + 100; 9000: s := s + 1000; "
+    "12000: s := s + 10000 END; "
+    "CASE i OF 1: l := l + 1; 11, 12: l := l + 10 ELSE e := e + 1 END; "
+    "big := i; "
+    "CASE big * 1000000000 OF 0: g := g + 1; "
+    "2000000000..3000000000: g := g + 10; 12000000000: g := g + 100 END "
+    "END; "
+    "BEGIN "
+    "t := 0; s := 0; l := 0; e := 0; g := 0; "
+    "FOR i := -2 TO 12 DO Count(i); "
+    "n := 5; CASE n OF 1: n := 0; 2: n := 0 END "
+    "END.";
+
+// a[i] := b[i] + 1 from first to last
+std::string kernel(const std::string& first, const std::string& direction,
+                   const std::string& last) {
+  return "PROGRAM Kernel; "
+         "VAR a, b : ARRAY[1..10] OF INTEGER; i : INTEGER; "
+         "BEGIN FOR i := " + first + " " + direction + " " + last +
+         " DO a[i] := b[i] + 1 END.";
+}
+
+}  // namespace
+
+int main() {
+  bool ok = expect("self and mutual tail calls", TAIL_CALLS, {"r", "s"},
+                   "r=7 s=2");
+  ok &= expect("tail call to a wider result", NARROWING, {"r"},
+               "value 500 is out of range for F");
+  ok &= expect("FOR bounds changed in the body", BOUNDS, {"t", "n", "d"},
+               "t=6 n=3 d=3");
+  ok &= expect("CASE", CASES, {"t", "s", "l", "e", "g", "n"},
+               "t=11321 s=11211 l=21 e=12 g=121 n=5");
+  if (const auto kinds = dispatches(CASES); kinds != "TSLL") {
+    std::cerr << "CASE dispatch: " << kinds << " instead of TSLL\n";
+    ok = false;
+  }
+
+  // the first index out of range fails, whether the start or the end is
+  ok &= expect("kernel from below", kernel("0", "TO", "5"), {},
+               "index 0 is out of range for b");
+  ok &= expect("kernel from above", kernel("11", "DOWNTO", "5"), {},
+               "index 11 is out of range for b");
+  ok &= expect("kernel up past the end", kernel("5", "TO", "20"), {},
+               "index 11 is out of range for b");
+  ok &= expect("kernel down past the end", kernel("5", "DOWNTO", "-3"), {},
+               "index 0 is out of range for b");
+  if (!ok) {
+    return 1;
+  }
+  std::cout << "programs run alike, optimized or not\n";
+  return 0;
+}
@@ -0,0 +1,582 @@
+// Copyright 2023 Zhu Junhui
+
+#include "kernel.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <type_traits>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace Pascal {
+
+namespace {
+
+// elements per vector operation; the blocks of a few operands stay in L1
+constexpr size_t BLOCK = 256;
+
+template <class T>
+using Apply = void (*)(Kernel::Op, T*, const T*, const T*, size_t);
+
+// INTEGER and INT64 arithmetic wraps around like the vector instructions do
+template <class T>
+void apply_scalar(Kernel::Op op, T* out, const T* left, const T* right,
+                  size_t n) {
+  using Bits = typename std::conditional_t<std::is_integral_v<T>,
+                                           std::make_unsigned<T>,
+                                           std::type_identity<T>>::type;
+  switch (op) {
+    case Kernel::Op::ADD:
+      for (size_t i = 0; i < n; ++i) {
+        out[i] = static_cast<T>(static_cast<Bits>(left[i]) + right[i]);
+      }
+      break;
+    case Kernel::Op::SUBTRACT:
+      for (size_t i = 0; i < n; ++i) {
+        out[i] = static_cast<T>(static_cast<Bits>(left[i]) - right[i]);
+      }
+      break;
+    case Kernel::Op::MULTIPLY:
+      for (size_t i = 0; i < n; ++i) {
+        out[i] = static_cast<T>(static_cast<Bits>(left[i]) * right[i]);
+      }
+      break;
+    default:
+      if constexpr (std::is_floating_point_v<T>) {
+        for (size_t i = 0; i < n; ++i) {
+          out[i] = left[i] / right[i];
+        }
+      }
+      break;
+  }
+}
+
+#if defined(__x86_64__)
+
+void apply_sse2(Kernel::Op op, double* out, const double* left,
+                const double* right, size_t n) {
+  size_t i = 0;
+  for (; i + 2 <= n; i += 2) {
+    const auto a = _mm_loadu_pd(left + i);
+    const auto b = _mm_loadu_pd(right + i);
+    switch (op) {
+      case Kernel::Op::ADD:
+        _mm_storeu_pd(out + i, _mm_add_pd(a, b));
+        break;
+      case Kernel::Op::SUBTRACT:
+        _mm_storeu_pd(out + i, _mm_sub_pd(a, b));
+        break;
+      case Kernel::Op::MULTIPLY:
+        _mm_storeu_pd(out + i, _mm_mul_pd(a, b));
+        break;
+      default:
+        _mm_storeu_pd(out + i, _mm_div_pd(a, b));
+        break;
+    }
+  }
+  apply_scalar(op, out + i, left + i, right + i, n - i);
+}
+
+// SSE2 has no 32-bit multiplication, products are left to the scalar loop
+void apply_sse2(Kernel::Op op, int* out, const int* left, const int* right,
+                size_t n) {
+  size_t i = 0;
+  if (op != Kernel::Op::MULTIPLY) {
+    for (; i + 4 <= n; i += 4) {
+      const auto a =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(left + i));
+      const auto b =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(right + i));
+      const auto result = op == Kernel::Op::ADD ? _mm_add_epi32(a, b)
+                                                : _mm_sub_epi32(a, b);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), result);
+    }
+  }
+  apply_scalar(op, out + i, left + i, right + i, n - i);
+}
+
+// nor 64-bit multiplication
+void apply_sse2(Kernel::Op op, int64_t* out, const int64_t* left,
+                const int64_t* right, size_t n) {
+  size_t i = 0;
+  if (op != Kernel::Op::MULTIPLY) {
+    for (; i + 2 <= n; i += 2) {
+      const auto a =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(left + i));
+      const auto b =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(right + i));
+      const auto result = op == Kernel::Op::ADD ? _mm_add_epi64(a, b)
+                                                : _mm_sub_epi64(a, b);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), result);
+    }
+  }
+  apply_scalar(op, out + i, left + i, right + i, n - i);
+}
+
+__attribute__((target("avx2"))) void apply_avx2(Kernel::Op op, double* out,
+                                                const double* left,
+                                                const double* right,
+                                                size_t n) {
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const auto a = _mm256_loadu_pd(left + i);
+    const auto b = _mm256_loadu_pd(right + i);
+    switch (op) {
+      case Kernel::Op::ADD:
+        _mm256_storeu_pd(out + i, _mm256_add_pd(a, b));
+        break;
+      case Kernel::Op::SUBTRACT:
+        _mm256_storeu_pd(out + i, _mm256_sub_pd(a, b));
+        break;
+      case Kernel::Op::MULTIPLY:
+        _mm256_storeu_pd(out + i, _mm256_mul_pd(a, b));
+        break;
+      default:
+        _mm256_storeu_pd(out + i, _mm256_div_pd(a, b));
+        break;
+    }
+  }
+  apply_scalar(op, out + i, left + i, right + i, n - i);
+}
+
+__attribute__((target("avx2"))) void apply_avx2(Kernel::Op op, int* out,
+                                                const int* left,
+                                                const int* right, size_t n) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const auto a =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(left + i));
+    const auto b =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(right + i));
+    __m256i result;
+    switch (op) {
+      case Kernel::Op::ADD:
+        result = _mm256_add_epi32(a, b);
+        break;
+      case Kernel::Op::SUBTRACT:
+        result = _mm256_sub_epi32(a, b);
+        break;
+      default:
+        result = _mm256_mullo_epi32(a, b);
+        break;
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), result);
+  }
+  apply_scalar(op, out + i, left + i, right + i, n - i);
+}
+
+// AVX2 has no 64-bit multiplication either
+__attribute__((target("avx2"))) void apply_avx2(Kernel::Op op, int64_t* out,
+                                                const int64_t* left,
+                                                const int64_t* right,
+                                                size_t n) {
+  size_t i = 0;
+  if (op != Kernel::Op::MULTIPLY) {
+    for (; i + 4 <= n; i += 4) {
+      const auto a =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(left + i));
+      const auto b =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(right + i));
+      const auto result = op == Kernel::Op::ADD ? _mm256_add_epi64(a, b)
+                                                : _mm256_sub_epi64(a, b);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), result);
+    }
+  }
+  apply_scalar(op, out + i, left + i, right + i, n - i);
+}
+
+#endif
+
+template <class T>
+Apply<T> select() {
+#if defined(__x86_64__)
+  if (__builtin_cpu_supports("avx2")) {
+    return apply_avx2;
+  }
+  return apply_sse2;
+#else
+  return apply_scalar<T>;
+#endif
+}
+
+// chosen once, on first use
+template <class T>
+Apply<T> apply() {
+  static const Apply<T> selected = select<T>();
+  return selected;
+}
+
+void* elements(V::SymbolTable* table, int level, int slot,
+               bool by_reference) {
+  auto& variable = table->slot(level, slot);
+  return (by_reference ? *variable.reference : variable).array;
+}
+
+// vector INTEGER and INT64 arithmetic wraps around, so it may only replace
+// operations proven not to overflow
+template <class Operation>
+bool traps(const Operation* op) {
+  return (op->type() == ValueAST::ValueType::INTEGER ||
+          op->type() == ValueAST::ValueType::INT64) &&
+         op->checked();
+}
+
+// n elements stored as S at from, as T at to
+template <class T, class S>
+void convert(const std::byte* from, T* to, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    S value;
+    std::memcpy(&value, from + i * sizeof(S), sizeof(S));
+    to[i] = static_cast<T>(value);
+  }
+}
+
+template <class T, class S>
+void convert(const T* from, std::byte* to, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    const auto value = static_cast<S>(from[i]);
+    std::memcpy(to + i * sizeof(S), &value, sizeof(S));
+  }
+}
+
+// n integers stored in size bytes each as T
+template <class T>
+void widen_block(const std::byte* from, int64_t size, bool is_signed, T* to,
+                 size_t n) {
+  switch (size) {
+    case 1:
+      is_signed ? convert<T, int8_t>(from, to, n)
+                : convert<T, uint8_t>(from, to, n);
+      break;
+    case 2:
+      is_signed ? convert<T, int16_t>(from, to, n)
+                : convert<T, uint16_t>(from, to, n);
+      break;
+    default:
+      is_signed ? convert<T, int32_t>(from, to, n)
+                : convert<T, uint32_t>(from, to, n);
+      break;
+  }
+}
+
+// n integers that fit in size bytes each stored in them
+template <class T>
+void narrow_block(const T* from, std::byte* to, int64_t size, size_t n) {
+  switch (size) {
+    case 1:
+      convert<T, uint8_t>(from, to, n);
+      break;
+    case 2:
+      convert<T, uint16_t>(from, to, n);
+      break;
+    default:
+      convert<T, uint32_t>(from, to, n);
+      break;
+  }
+}
+
+}  // namespace
+
+bool Kernel::element(const Variable* variable, const Variable* control,
+                     ValueAST::ValueType type, Operand* operand) {
+  const int64_t size = variable->packed_size() != 0
+                           ? variable->packed_size()
+                           : scalar_size(type, std::nullopt, false);
+  // an element of the heap is not one of an array
+  if (variable->indices().size() != 1 || !variable->dereferences().empty() ||
+      variable->array()->dimensions.size() != 1 ||
+      variable->stride() != size) {
+    return false;
+  }
+  const auto index =
+      dynamic_cast<const Variable*>(variable->indices().front().get());
+  if (index == nullptr || !index->whole() ||
+      index->level() != control->level() ||
+      index->slot() != control->slot() ||
+      index->by_reference() != control->by_reference()) {
+    return false;
+  }
+
+  const auto& dimension = variable->array()->dimensions.front();
+  const auto& range = variable->range();
+  *operand = Operand{variable->value(),
+                     variable->level(),
+                     variable->slot(),
+                     variable->by_reference(),
+                     dimension.low,
+                     dimension.high,
+                     variable->offset(),
+                     size,
+                     !range.has_value() || range->low < 0};
+  return true;
+}
+
+std::unique_ptr<Kernel> Kernel::compile(const For* loop) {
+  // the control variable indexes the lanes as an INTEGER
+  if (!loop->counted() ||
+      loop->start()->type() != ValueAST::ValueType::INTEGER) {
+    return nullptr;
+  }
+
+  // BEGIN a[i] := e END is a[i] := e
+  const NonValueAST* body = loop->body();
+  while (const auto compound = dynamic_cast<const Compound*>(body)) {
+    if (compound->children().size() != 1) {
+      return nullptr;
+    }
+    body = compound->children().front().get();
+  }
+  const auto assign = dynamic_cast<const Assign*>(body);
+  if (assign == nullptr) {
+    return nullptr;
+  }
+
+  // the left side is not a typed node, the right one has its type; a
+  // target of a subrange type checks what is stored in it
+  std::unique_ptr<Kernel> kernel(new Kernel());
+  const auto control = loop->variable();
+  const auto target = assign->left();
+  kernel->type_ = assign->right()->type();
+  if ((kernel->type_ != ValueAST::ValueType::INTEGER &&
+       kernel->type_ != ValueAST::ValueType::INT64 &&
+       kernel->type_ != ValueAST::ValueType::REAL) ||
+      (assign->checked() && target->range().has_value()) ||
+      !element(target, control, kernel->type_, &kernel->target_)) {
+    return nullptr;
+  }
+  if (!kernel->compile(assign->right(), control, 0)) {
+    return nullptr;
+  }
+  return kernel;
+}
+
+bool Kernel::compile(const ValueAST* expr, const Variable* control,
+                     size_t height) {
+  depth_ = std::max(depth_, height + 1);
+  if (expr->type() != type_) {
+    return false;
+  }
+
+  if (const auto number = dynamic_cast<const Number*>(expr)) {
+    constants_.push_back(number->value());
+    program_.push_back({Op::CONSTANT, static_cast<int>(constants_.size()) - 1});
+    return true;
+  }
+
+  if (const auto variable = dynamic_cast<const Variable*>(expr)) {
+    return operand(variable, control);
+  }
+
+  if (const auto op = dynamic_cast<const UnaryOperation*>(expr)) {
+    if (op->op() == UnaryOperation::Operator::PLUS) {
+      return compile(op->expr(), control, height);
+    }
+    // an INTEGER operand of an INT64 expression is widened as it is loaded
+    if (op->op() == UnaryOperation::Operator::CONVERT) {
+      const auto variable = dynamic_cast<const Variable*>(op->expr());
+      return type_ == ValueAST::ValueType::INT64 && variable != nullptr &&
+             operand(variable, control);
+    }
+    // -x is x * -1, which keeps the sign of -0.0
+    if (op->op() != UnaryOperation::Operator::MINUS || traps(op) ||
+        !compile(op->expr(), control, height)) {
+      return false;
+    }
+    depth_ = std::max(depth_, height + 2);
+    if (type_ == ValueAST::ValueType::REAL) {
+      constants_.push_back(-1.0);
+    } else if (type_ == ValueAST::ValueType::INT64) {
+      constants_.push_back(int64_t{-1});
+    } else {
+      constants_.push_back(-1);
+    }
+    program_.push_back({Op::CONSTANT, static_cast<int>(constants_.size()) - 1});
+    program_.push_back({Op::MULTIPLY, 0});
+    return true;
+  }
+
+  const auto op = dynamic_cast<const BinaryOperation*>(expr);
+  if (op == nullptr || traps(op)) {
+    return false;
+  }
+  Op arithmetic;
+  switch (op->op()) {
+    case BinaryOperation::Operator::PLUS:
+      arithmetic = Op::ADD;
+      break;
+    case BinaryOperation::Operator::MINUS:
+      arithmetic = Op::SUBTRACT;
+      break;
+    case BinaryOperation::Operator::MULTIPLY:
+      arithmetic = Op::MULTIPLY;
+      break;
+    case BinaryOperation::Operator::REAL_DIV:
+      arithmetic = Op::DIVIDE;
+      break;
+    default:
+      return false;
+  }
+  if (!compile(op->left(), control, height) ||
+      !compile(op->right(), control, height + 1)) {
+    return false;
+  }
+  program_.push_back({arithmetic, 0});
+  return true;
+}
+
+bool Kernel::operand(const Variable* variable, const Variable* control) {
+  if (!variable->indices().empty()) {
+    Operand operand;
+    if (!element(variable, control, variable->type(), &operand)) {
+      return false;
+    }
+    arrays_.push_back(operand);
+    program_.push_back({Op::ARRAY, static_cast<int>(arrays_.size()) - 1});
+    return true;
+  }
+
+  // a reference might point into the target, the control variable
+  // changes every iteration; a field is not a slot
+  if (variable->by_reference() || !variable->whole() ||
+      (variable->level() == control->level() &&
+       variable->slot() == control->slot())) {
+    return false;
+  }
+  scalars_.push_back({variable->value(), variable->level(), variable->slot(),
+                      false, 0, 0, 0,
+                      scalar_size(variable->type(), std::nullopt, false),
+                      true});
+  program_.push_back({Op::SCALAR, static_cast<int>(scalars_.size()) - 1});
+  return true;
+}
+
+void Kernel::run(V::SymbolTable* table, int start, int end, bool down) const {
+  // the first iteration, in loop order, that selects an element out of
+  // range, and the array the interpreted loop would report it for: the
+  // right side is evaluated before the target
+  const int step = down ? -1 : 1;
+  std::optional<int> failure;
+  const Operand* failed = nullptr;
+  const auto check = [&](const Operand& array) {
+    std::optional<int> index;
+    if (start < array.low || start > array.high) {
+      index = start;
+    } else if (down ? end < array.low : end > array.high) {
+      index = down ? array.low - 1 : array.high + 1;
+    }
+    if (index.has_value() &&
+        (!failure.has_value() || (*index - *failure) * step < 0)) {
+      failure = index;
+      failed = &array;
+    }
+  };
+  for (const auto& array : arrays_) {
+    check(array);
+  }
+  check(target_);
+
+  int last = end;
+  if (failure.has_value()) {
+    last = *failure - step;
+  }
+  if ((last - start) * static_cast<int64_t>(step) >= 0) {
+    const int first = std::min(start, last);
+    const int final = std::max(start, last);
+    if (type_ == ValueAST::ValueType::REAL) {
+      execute<double>(table, first, final);
+    } else if (type_ == ValueAST::ValueType::INT64) {
+      execute<int64_t>(table, first, final);
+    } else {
+      execute<int>(table, first, final);
+    }
+  }
+
+  if (failure.has_value()) {
+    throw std::runtime_error("index " + std::to_string(*failure) +
+                             " is out of range for " + failed->name);
+  }
+}
+
+template <class T>
+void Kernel::execute(V::SymbolTable* table, int first, int last) const {
+  const auto base = [&](const Operand& array) {
+    const auto bytes = static_cast<std::byte*>(
+        elements(table, array.level, array.slot, array.by_reference));
+    return bytes + array.offset + (first - array.low) * array.size;
+  };
+
+  std::vector<const std::byte*> inputs;
+  for (const auto& array : arrays_) {
+    inputs.push_back(base(array));
+  }
+  std::byte* const out = base(target_);
+
+  // scalars and constants as blocks of equal elements
+  std::vector<T> broadcast((scalars_.size() + constants_.size()) * BLOCK);
+  for (size_t i = 0; i < scalars_.size(); ++i) {
+    const auto& slot = table->slot(scalars_[i].level, scalars_[i].slot);
+    T value;
+    if constexpr (std::is_floating_point_v<T>) {
+      value = slot.real;
+    } else {
+      value = scalars_[i].size == sizeof(int) ? slot.integer : slot.int64;
+    }
+    std::fill_n(broadcast.begin() + i * BLOCK, BLOCK, value);
+  }
+  for (size_t i = 0; i < constants_.size(); ++i) {
+    const T value = std::get<T>(constants_[i]);
+    std::fill_n(broadcast.begin() + (scalars_.size() + i) * BLOCK, BLOCK,
+                value);
+  }
+  const T* const constants = broadcast.data() + scalars_.size() * BLOCK;
+
+  const auto operate = apply<T>();
+  std::vector<T> scratch(depth_ * BLOCK);
+  std::vector<T> widened(arrays_.size() * BLOCK);
+  std::vector<const T*> stack(depth_);
+  const size_t count = static_cast<size_t>(last - first) + 1;
+  for (size_t done = 0; done < count; done += BLOCK) {
+    const size_t n = std::min(BLOCK, count - done);
+    size_t top = 0;
+    for (const auto& instruction : program_) {
+      switch (instruction.op) {
+        case Op::ARRAY: {
+          const auto& array = arrays_[instruction.operand];
+          const auto from = inputs[instruction.operand] + done * array.size;
+          if (array.size == sizeof(T)) {
+            stack[top++] = reinterpret_cast<const T*>(from);
+          } else {
+            T* to = widened.data() + instruction.operand * BLOCK;
+            if constexpr (std::is_integral_v<T>) {
+              widen_block(from, array.size, array.is_signed, to, n);
+            }
+            stack[top++] = to;
+          }
+        } break;
+        case Op::SCALAR:
+          stack[top++] = broadcast.data() + instruction.operand * BLOCK;
+          break;
+        case Op::CONSTANT:
+          stack[top++] = constants + instruction.operand * BLOCK;
+          break;
+        default: {
+          const T* right = stack[--top];
+          T* result = scratch.data() + (top - 1) * BLOCK;
+          operate(instruction.op, result, stack[top - 1], right, n);
+          stack[top - 1] = result;
+        } break;
+      }
+    }
+    // inputs may overlap the target, but only element by element
+    if (target_.size == sizeof(T)) {
+      std::memmove(out + done * sizeof(T), stack[0], n * sizeof(T));
+    } else if constexpr (std::is_integral_v<T>) {
+      narrow_block(stack[0], out + done * target_.size, target_.size, n);
+    }
+  }
+}
+
+}  // namespace Pascal
@@ -0,0 +1,86 @@
+// Copyright 2023 Zhu Junhui
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "ast.h"
+#include "symbol_table.h"
+
+namespace Pascal {
+
+// An element-wise FOR loop, a[i] := e, where e combines the elements b[i]
+// of one-dimensional arrays, or the fields b[i].f of packed arrays of
+// records, whose columns are contiguous, loop-invariant scalars and
+// constants with
+// + - * and, for REAL, /. No iteration depends on another, so the loop runs
+// as a few vector operations per block of elements instead of interpreting
+// the body once per element. The operations use AVX2 or SSE2, whichever
+// the machine running the program supports, on 32-bit INTEGER, 64-bit
+// INT64 or REAL lanes; elements packed into fewer bytes, and INTEGER ones
+// in an INT64 expression, are widened a block at a time and the target is
+// narrowed back.
+class Kernel {
+ public:
+  enum class Op { ARRAY, SCALAR, CONSTANT, ADD, SUBTRACT, MULTIPLY, DIVIDE };
+
+  // the kernel of a counted loop of that form, nullptr for any other loop
+  static std::unique_ptr<Kernel> compile(const For* loop);
+
+  // run the iterations from start to end, of which there is at least one;
+  // an element out of range fails at the same iteration and with the same
+  // error as the interpreted loop, after the iterations before it
+  void run(V::SymbolTable* table, int start, int end, bool down) const;
+
+ private:
+  struct Operand {
+    std::string name;
+    int level;
+    int slot;
+    bool by_reference;
+    // bounds of an array
+    int low;
+    int high;
+    // bytes from the start of the array to its first selected element
+    int64_t offset;
+    // bytes each element or scalar is stored in, and whether the narrow
+    // ones are sign-extended
+    int64_t size;
+    bool is_signed;
+  };
+
+  // operand indexes arrays_, scalars_ or constants_ by op
+  struct Instruction {
+    Op op;
+    int operand;
+  };
+
+  ValueAST::ValueType type_;
+  Operand target_;
+  std::vector<Operand> arrays_;
+  std::vector<Operand> scalars_;
+  std::vector<ValueAST::Value> constants_;
+
+  // postfix, evaluated on a stack of at most depth_ blocks
+  std::vector<Instruction> program_;
+  size_t depth_ = 0;
+
+  Kernel() = default;
+
+  // variable is array[control] of a one-dimensional array, or a field of
+  // it, whose selections of the given type are as many bytes apart as each
+  // one takes
+  static bool element(const Variable* variable, const Variable* control,
+                      ValueAST::ValueType type, Operand* operand);
+
+  // push an element or a loop-invariant scalar
+  bool operand(const Variable* variable, const Variable* control);
+
+  bool compile(const ValueAST* expr, const Variable* control, size_t height);
+
+  template <class T>
+  void execute(V::SymbolTable* table, int first, int last) const;
+};
+
+}  // namespace Pascal
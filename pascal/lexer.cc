@@ -1,6 +1,7 @@
 // Copyright 2023 Zhu Junhui
 
 #include "lexer.h"
+#include <limits>
 
 namespace Pascal {
 
@@ -13,6 +14,47 @@ static const std::unordered_map<std::string, Token> RESERVED_KEYWORDS = {
     {"INTEGER", Token(Token::Type::INTEGER_TYPE)},
     {"REAL", Token(Token::Type::REAL_TYPE)},
     {"PROCEDURE", Token(Token::Type::PROCEDURE)},
+    {"FUNCTION", Token(Token::Type::FUNCTION)},
+    {"BOOLEAN", Token(Token::Type::BOOLEAN_TYPE)},
+    {"BYTE", Token(Token::Type::BYTE_TYPE)},
+    {"WORD", Token(Token::Type::WORD_TYPE)},
+    {"CARDINAL", Token(Token::Type::CARDINAL_TYPE)},
+    {"INT64", Token(Token::Type::INT64_TYPE)},
+    {"STRING", Token(Token::Type::STRING_TYPE)},
+    {"AND", Token(Token::Type::AND)},
+    {"OR", Token(Token::Type::OR)},
+    {"NOT", Token(Token::Type::NOT)},
+    {"IF", Token(Token::Type::IF)},
+    {"THEN", Token(Token::Type::THEN)},
+    {"ELSE", Token(Token::Type::ELSE)},
+    {"WHILE", Token(Token::Type::WHILE)},
+    {"DO", Token(Token::Type::DO)},
+    {"REPEAT", Token(Token::Type::REPEAT)},
+    {"UNTIL", Token(Token::Type::UNTIL)},
+    {"FOR", Token(Token::Type::FOR)},
+    {"TO", Token(Token::Type::TO)},
+    {"DOWNTO", Token(Token::Type::DOWNTO)},
+    {"CASE", Token(Token::Type::CASE)},
+    {"OF", Token(Token::Type::OF)},
+    {"ARRAY", Token(Token::Type::ARRAY)},
+    {"SET", Token(Token::Type::SET)},
+    {"IN", Token(Token::Type::IN)},
+    {"CARD", Token(Token::Type::CARD)},
+    {"RECORD", Token(Token::Type::RECORD)},
+    {"PACKED", Token(Token::Type::PACKED)},
+    {"TYPE", Token(Token::Type::TYPE)},
+    {"NIL", Token(Token::Type::NIL)},
+    {"NEW", Token(Token::Type::NEW)},
+    {"DISPOSE", Token(Token::Type::DISPOSE)},
+    {"WRITE", Token(Token::Type::WRITE)},
+    {"WRITELN", Token(Token::Type::WRITELN)},
+    {"READ", Token(Token::Type::READ)},
+    {"READLN", Token(Token::Type::READLN)},
+    {"FILE", Token(Token::Type::FILE)},
+    {"RESET", Token(Token::Type::RESET)},
+    {"EOF", Token(Token::Type::EOF_FUNCTION)},
+    {"TRUE", Token(Token::Type::BOOLEAN_CONST, 1)},
+    {"FALSE", Token(Token::Type::BOOLEAN_CONST, 0)},
 
     // lower cases
     {"begin", Token(Token::Type::BEGIN)},
@@ -23,6 +65,47 @@ static const std::unordered_map<std::string, Token> RESERVED_KEYWORDS = {
     {"integer", Token(Token::Type::INTEGER_TYPE)},
     {"real", Token(Token::Type::REAL_TYPE)},
     {"procedure", Token(Token::Type::PROCEDURE)},
+    {"function", Token(Token::Type::FUNCTION)},
+    {"boolean", Token(Token::Type::BOOLEAN_TYPE)},
+    {"byte", Token(Token::Type::BYTE_TYPE)},
+    {"word", Token(Token::Type::WORD_TYPE)},
+    {"cardinal", Token(Token::Type::CARDINAL_TYPE)},
+    {"int64", Token(Token::Type::INT64_TYPE)},
+    {"string", Token(Token::Type::STRING_TYPE)},
+    {"and", Token(Token::Type::AND)},
+    {"or", Token(Token::Type::OR)},
+    {"not", Token(Token::Type::NOT)},
+    {"if", Token(Token::Type::IF)},
+    {"then", Token(Token::Type::THEN)},
+    {"else", Token(Token::Type::ELSE)},
+    {"while", Token(Token::Type::WHILE)},
+    {"do", Token(Token::Type::DO)},
+    {"repeat", Token(Token::Type::REPEAT)},
+    {"until", Token(Token::Type::UNTIL)},
+    {"for", Token(Token::Type::FOR)},
+    {"to", Token(Token::Type::TO)},
+    {"downto", Token(Token::Type::DOWNTO)},
+    {"case", Token(Token::Type::CASE)},
+    {"of", Token(Token::Type::OF)},
+    {"array", Token(Token::Type::ARRAY)},
+    {"set", Token(Token::Type::SET)},
+    {"in", Token(Token::Type::IN)},
+    {"card", Token(Token::Type::CARD)},
+    {"record", Token(Token::Type::RECORD)},
+    {"packed", Token(Token::Type::PACKED)},
+    {"type", Token(Token::Type::TYPE)},
+    {"nil", Token(Token::Type::NIL)},
+    {"new", Token(Token::Type::NEW)},
+    {"dispose", Token(Token::Type::DISPOSE)},
+    {"write", Token(Token::Type::WRITE)},
+    {"writeln", Token(Token::Type::WRITELN)},
+    {"read", Token(Token::Type::READ)},
+    {"readln", Token(Token::Type::READLN)},
+    {"file", Token(Token::Type::FILE)},
+    {"reset", Token(Token::Type::RESET)},
+    {"eof", Token(Token::Type::EOF_FUNCTION)},
+    {"true", Token(Token::Type::BOOLEAN_CONST, 1)},
+    {"false", Token(Token::Type::BOOLEAN_CONST, 0)},
 };
 
 std::optional<char> Lexer::peek() {
@@ -81,7 +164,8 @@ Token Lexer::number() {
     advance();
   }
 
-  if (current_char_.has_value() && *current_char_ == '.') {
+  // in 1..5 the dot starts a DOTDOT, not a fraction
+  if (current_char_.has_value() && *current_char_ == '.' && peek() != '.') {
     result.push_back(*current_char_);
     advance();
     while (current_char_.has_value() && std::isdigit(*current_char_)) {
@@ -89,12 +173,48 @@ Token Lexer::number() {
       advance();
     }
     return Token(Token::Type::REAL_CONST, std::stod(result));
-  } else {
-    return Token(Token::Type::INTEGER_CONST, std::stoi(result));
   }
+  // a constant too large for an INTEGER is an INT64
+  int64_t value = 0;
+  for (const char digit : result) {
+    if (__builtin_mul_overflow(value, 10, &value) ||
+        __builtin_add_overflow(value, digit - '0', &value)) {
+      error();
+    }
+  }
+  if (value > std::numeric_limits<int>::max()) {
+    return Token(Token::Type::INTEGER_CONST, value);
+  }
+  return Token(Token::Type::INTEGER_CONST, static_cast<int>(value));
+}
+
+// the characters between quotes, a quote being written twice
+Token Lexer::string() {
+  std::string result;
+  advance();
+  while (true) {
+    if (!current_char_.has_value() || *current_char_ == '\n') {
+      error();
+    }
+    if (*current_char_ == '\'') {
+      advance();
+      if (!current_char_.has_value() || *current_char_ != '\'') {
+        break;
+      }
+    }
+    result.push_back(*current_char_);
+    advance();
+  }
+  return Token(Token::Type::STRING_CONST, result);
 }
 
 Token Lexer::get_next_token() {
+  auto token = next_token();
+  token_end_ = pos_ - text_.begin();
+  return token;
+}
+
+Token Lexer::next_token() {
   while (current_char_.has_value()) {
     if (std::isspace(*current_char_)) {
       skip_whitespace();
@@ -107,10 +227,16 @@ Token Lexer::get_next_token() {
       continue;
     }
 
+    token_start_ = pos_ - text_.begin();
+
     if (std::isdigit(*current_char_)) {
       return number();
     }
 
+    if (*current_char_ == '\'') {
+      return string();
+    }
+
     if (*current_char_ == ':' && peek().has_value() && *peek() == '=') {
       advance();
       advance();
@@ -122,6 +248,33 @@ Token Lexer::get_next_token() {
       return Token(Token::Type::COLON);
     }
 
+    if (*current_char_ == '=') {
+      advance();
+      return Token(Token::Type::EQUAL);
+    }
+
+    if (*current_char_ == '<') {
+      advance();
+      if (current_char_.has_value() && *current_char_ == '=') {
+        advance();
+        return Token(Token::Type::LESS_EQUAL);
+      }
+      if (current_char_.has_value() && *current_char_ == '>') {
+        advance();
+        return Token(Token::Type::NOT_EQUAL);
+      }
+      return Token(Token::Type::LESS);
+    }
+
+    if (*current_char_ == '>') {
+      advance();
+      if (current_char_.has_value() && *current_char_ == '=') {
+        advance();
+        return Token(Token::Type::GREATER_EQUAL);
+      }
+      return Token(Token::Type::GREATER);
+    }
+
     if (*current_char_ == ',') {
       advance();
       return Token(Token::Type::COMMA);
@@ -157,11 +310,32 @@ Token Lexer::get_next_token() {
       return Token(Token::Type::RIGHT_PAREN);
     }
 
+    if (*current_char_ == '^') {
+      advance();
+      return Token(Token::Type::CARET);
+    }
+
+    if (*current_char_ == '[') {
+      advance();
+      return Token(Token::Type::LEFT_BRACKET);
+    }
+
+    if (*current_char_ == ']') {
+      advance();
+      return Token(Token::Type::RIGHT_BRACKET);
+    }
+
     if (*current_char_ == ';') {
       advance();
       return Token(Token::Type::SEMI);
     }
 
+    if (*current_char_ == '.' && peek() == '.') {
+      advance();
+      advance();
+      return Token(Token::Type::DOTDOT);
+    }
+
     if (*current_char_ == '.') {
       advance();
       return Token(Token::Type::DOT);
@@ -174,6 +348,7 @@ Token Lexer::get_next_token() {
     error();
   }
 
+  token_start_ = text_.size();
   return Token(Token::Type::END_OF_FILE);
 }
 
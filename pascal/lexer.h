@@ -14,6 +14,10 @@ class Lexer {
   decltype(text_.begin()) pos_;
   std::optional<char> current_char_;
 
+  // source range of the token returned last
+  size_t token_start_ = 0;
+  size_t token_end_ = 0;
+
  public:
   explicit Lexer(const std::string& text)
       : text_(text), pos_(text_.begin()), current_char_(*pos_) {
@@ -36,11 +40,23 @@ class Lexer {
 
   Token number();
 
+  Token string();
+
   std::optional<char> peek();
 
   void skip_comment();
 
+  Token next_token();
+
  public:
   Token get_next_token();
+
+  size_t token_start() const { return token_start_; }
+
+  size_t token_end() const { return token_end_; }
+
+  std::string source(size_t begin, size_t end) const {
+    return text_.substr(begin, end - begin);
+  }
 };
 }  // namespace Pascal
@@ -3,7 +3,9 @@
 #pragma once
 
 #include <cassert>
+#include <cstdint>
 #include <fstream>
+#include <functional>
 #include <memory>
 #include <optional>
 #include <stdexcept>
@@ -14,12 +16,22 @@ namespace Pascal {
 
 constexpr bool DEBUG = true;
 
+inline uint64_t hash_combine(uint64_t seed, uint64_t value) {
+  return seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+}
+
 class Token {
  public:
   enum class Type {
     // variable type
     INTEGER_TYPE,
     REAL_TYPE,
+    BOOLEAN_TYPE,
+    BYTE_TYPE,
+    WORD_TYPE,
+    CARDINAL_TYPE,
+    INT64_TYPE,
+    STRING_TYPE,
 
     // operator
     PLUS,
@@ -27,6 +39,15 @@ class Token {
     MULTIPLY,
     INTEGER_DIV,
     REAL_DIV,
+    EQUAL,
+    NOT_EQUAL,
+    LESS,
+    LESS_EQUAL,
+    GREATER,
+    GREATER_EQUAL,
+    AND,
+    OR,
+    NOT,
 
     // reserved keywords
     PROGRAM,
@@ -48,6 +69,60 @@ class Token {
     REAL_CONST,
 
     PROCEDURE,
+    FUNCTION,
+
+    // control flow
+    IF,
+    THEN,
+    ELSE,
+    WHILE,
+    DO,
+    REPEAT,
+    UNTIL,
+    FOR,
+    TO,
+    DOWNTO,
+    CASE,
+    OF,
+    DOTDOT,
+
+    BOOLEAN_CONST,
+
+    // arrays
+    ARRAY,
+    LEFT_BRACKET,
+    RIGHT_BRACKET,
+
+    // sets
+    SET,
+    IN,
+    CARD,
+
+    // records
+    RECORD,
+    PACKED,
+
+    // 'text', with '' for a quote
+    STRING_CONST,
+
+    // pointers
+    TYPE,
+    CARET,
+    NIL,
+    NEW,
+    DISPOSE,
+
+    // output
+    WRITE,
+    WRITELN,
+
+    // input
+    READ,
+    READLN,
+    FILE,
+    RESET,
+    // EOF is a macro of <cstdio>
+    EOF_FUNCTION,
   };
   // Type to string
   static std::string type_to_string(Type type) {
@@ -98,25 +173,136 @@ class Token {
         return "REAL_CONST";
       case Type::PROCEDURE:
         return "PROCEDURE";
+      case Type::FUNCTION:
+        return "FUNCTION";
+      case Type::BOOLEAN_TYPE:
+        return "BOOLEAN_TYPE";
+      case Type::BYTE_TYPE:
+        return "BYTE_TYPE";
+      case Type::WORD_TYPE:
+        return "WORD_TYPE";
+      case Type::CARDINAL_TYPE:
+        return "CARDINAL_TYPE";
+      case Type::INT64_TYPE:
+        return "INT64_TYPE";
+      case Type::STRING_TYPE:
+        return "STRING_TYPE";
+      case Type::EQUAL:
+        return "EQUAL";
+      case Type::NOT_EQUAL:
+        return "NOT_EQUAL";
+      case Type::LESS:
+        return "LESS";
+      case Type::LESS_EQUAL:
+        return "LESS_EQUAL";
+      case Type::GREATER:
+        return "GREATER";
+      case Type::GREATER_EQUAL:
+        return "GREATER_EQUAL";
+      case Type::AND:
+        return "AND";
+      case Type::OR:
+        return "OR";
+      case Type::NOT:
+        return "NOT";
+      case Type::IF:
+        return "IF";
+      case Type::THEN:
+        return "THEN";
+      case Type::ELSE:
+        return "ELSE";
+      case Type::WHILE:
+        return "WHILE";
+      case Type::DO:
+        return "DO";
+      case Type::REPEAT:
+        return "REPEAT";
+      case Type::UNTIL:
+        return "UNTIL";
+      case Type::FOR:
+        return "FOR";
+      case Type::TO:
+        return "TO";
+      case Type::DOWNTO:
+        return "DOWNTO";
+      case Type::CASE:
+        return "CASE";
+      case Type::OF:
+        return "OF";
+      case Type::DOTDOT:
+        return "DOTDOT";
+      case Type::BOOLEAN_CONST:
+        return "BOOLEAN_CONST";
+      case Type::ARRAY:
+        return "ARRAY";
+      case Type::LEFT_BRACKET:
+        return "LEFT_BRACKET";
+      case Type::RIGHT_BRACKET:
+        return "RIGHT_BRACKET";
+      case Type::SET:
+        return "SET";
+      case Type::IN:
+        return "IN";
+      case Type::CARD:
+        return "CARD";
+      case Type::RECORD:
+        return "RECORD";
+      case Type::PACKED:
+        return "PACKED";
+      case Type::STRING_CONST:
+        return "STRING_CONST";
+      case Type::TYPE:
+        return "TYPE";
+      case Type::CARET:
+        return "CARET";
+      case Type::NIL:
+        return "NIL";
+      case Type::NEW:
+        return "NEW";
+      case Type::DISPOSE:
+        return "DISPOSE";
+      case Type::WRITE:
+        return "WRITE";
+      case Type::WRITELN:
+        return "WRITELN";
+      case Type::READ:
+        return "READ";
+      case Type::READLN:
+        return "READLN";
+      case Type::FILE:
+        return "FILE";
+      case Type::RESET:
+        return "RESET";
+      case Type::EOF_FUNCTION:
+        return "EOF";
     }
     throw std::runtime_error("Unknown token type");
   }
 
-  using ValueType = std::variant<int, std::string, double>;
+  // an INTEGER_CONST too large for an int holds an int64_t
+  using ValueType = std::variant<int, std::string, double, int64_t>;
 
  private:
   std::optional<ValueType> value_;
   Type type_;
 
  public:
-  explicit Token(Type type) : type_(type), value_(std::nullopt) {}
+  explicit Token(Type type) : value_(std::nullopt), type_(type) {}
 
-  explicit Token(Type type, ValueType value) : type_(type), value_(value) {}
+  explicit Token(Type type, ValueType value) : value_(value), type_(type) {}
 
   Type type() const { return type_; }
 
   ValueType value() const { return *value_; }
 
+  uint64_t hash() const {
+    uint64_t seed = static_cast<uint64_t>(type_);
+    if (value_.has_value()) {
+      seed = hash_combine(seed, std::hash<ValueType>{}(*value_));
+    }
+    return seed;
+  }
+
   // operator to std::string
   std::string to_string() const {
     switch (type_) {
@@ -154,7 +340,10 @@ class Token {
         return "Token(COMMA, ,)";
       case Type::INTEGER_CONST:
         return "Token(INTEGER_CONST, " +
-               std::to_string(std::get<int>(*value_)) + ")";
+               (std::holds_alternative<int>(*value_)
+                    ? std::to_string(std::get<int>(*value_))
+                    : std::to_string(std::get<int64_t>(*value_))) +
+               ")";
       case Type::REAL_CONST:
         return "Token(REAL_CONST, " +
                std::to_string(std::get<double>(*value_)) + ")";
@@ -168,6 +357,109 @@ class Token {
         return "Token(REAL_TYPE)";
       case Type::PROCEDURE:
         return "Token(PROCEDURE)";
+      case Type::FUNCTION:
+        return "Token(FUNCTION)";
+      case Type::BOOLEAN_TYPE:
+        return "Token(BOOLEAN_TYPE)";
+      case Type::BYTE_TYPE:
+        return "Token(BYTE_TYPE)";
+      case Type::WORD_TYPE:
+        return "Token(WORD_TYPE)";
+      case Type::CARDINAL_TYPE:
+        return "Token(CARDINAL_TYPE)";
+      case Type::INT64_TYPE:
+        return "Token(INT64_TYPE)";
+      case Type::STRING_TYPE:
+        return "Token(STRING_TYPE)";
+      case Type::EQUAL:
+        return "Token(EQUAL, =)";
+      case Type::NOT_EQUAL:
+        return "Token(NOT_EQUAL, <>)";
+      case Type::LESS:
+        return "Token(LESS, <)";
+      case Type::LESS_EQUAL:
+        return "Token(LESS_EQUAL, <=)";
+      case Type::GREATER:
+        return "Token(GREATER, >)";
+      case Type::GREATER_EQUAL:
+        return "Token(GREATER_EQUAL, >=)";
+      case Type::AND:
+        return "Token(AND)";
+      case Type::OR:
+        return "Token(OR)";
+      case Type::NOT:
+        return "Token(NOT)";
+      case Type::IF:
+        return "Token(IF)";
+      case Type::THEN:
+        return "Token(THEN)";
+      case Type::ELSE:
+        return "Token(ELSE)";
+      case Type::WHILE:
+        return "Token(WHILE)";
+      case Type::DO:
+        return "Token(DO)";
+      case Type::REPEAT:
+        return "Token(REPEAT)";
+      case Type::UNTIL:
+        return "Token(UNTIL)";
+      case Type::FOR:
+        return "Token(FOR)";
+      case Type::TO:
+        return "Token(TO)";
+      case Type::DOWNTO:
+        return "Token(DOWNTO)";
+      case Type::CASE:
+        return "Token(CASE)";
+      case Type::OF:
+        return "Token(OF)";
+      case Type::DOTDOT:
+        return "Token(DOTDOT, ..)";
+      case Type::BOOLEAN_CONST:
+        return std::string("Token(BOOLEAN_CONST, ") +
+               (std::get<int>(*value_) ? "TRUE" : "FALSE") + ")";
+      case Type::ARRAY:
+        return "Token(ARRAY)";
+      case Type::LEFT_BRACKET:
+        return "Token(LEFT_BRACKET, [)";
+      case Type::RIGHT_BRACKET:
+        return "Token(RIGHT_BRACKET, ])";
+      case Type::SET:
+        return "Token(SET)";
+      case Type::IN:
+        return "Token(IN)";
+      case Type::CARD:
+        return "Token(CARD)";
+      case Type::RECORD:
+        return "Token(RECORD)";
+      case Type::PACKED:
+        return "Token(PACKED)";
+      case Type::STRING_CONST:
+        return "Token(STRING_CONST, " + std::get<std::string>(*value_) + ")";
+      case Type::TYPE:
+        return "Token(TYPE)";
+      case Type::CARET:
+        return "Token(CARET, ^)";
+      case Type::NIL:
+        return "Token(NIL)";
+      case Type::NEW:
+        return "Token(NEW)";
+      case Type::DISPOSE:
+        return "Token(DISPOSE)";
+      case Type::WRITE:
+        return "Token(WRITE)";
+      case Type::WRITELN:
+        return "Token(WRITELN)";
+      case Type::READ:
+        return "Token(READ)";
+      case Type::READLN:
+        return "Token(READLN)";
+      case Type::FILE:
+        return "Token(FILE)";
+      case Type::RESET:
+        return "Token(RESET)";
+      case Type::EOF_FUNCTION:
+        return "Token(EOF)";
     }
     throw std::runtime_error("Unknown token type");
   }
@@ -2,7 +2,10 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
 #include <memory>
+#include <optional>
 #include <string>
 #include <utility>
 #include <variant>
@@ -28,6 +31,20 @@ class Program;
 class Block;
 class VariableDeclaration;
 class ProcedureDeclaration;
+class Parameter;
+class ProcedureCall;
+class If;
+class While;
+class Repeat;
+class For;
+class Case;
+class HeapOperation;
+class Write;
+class Read;
+class Reset;
+
+// compiled form of an element-wise FOR loop, see kernel.h
+class Kernel;
 
 class NonValueASTVisitor {
  public:
@@ -37,6 +54,17 @@ class NonValueASTVisitor {
   virtual void visit(const Block*) = 0;
   virtual void visit(const VariableDeclaration*) = 0;
   virtual void visit(const ProcedureDeclaration*) = 0;
+  virtual void visit(const Parameter*) = 0;
+  virtual void visit(const ProcedureCall*) = 0;
+  virtual void visit(const If*) = 0;
+  virtual void visit(const While*) = 0;
+  virtual void visit(const Repeat*) = 0;
+  virtual void visit(const For*) = 0;
+  virtual void visit(const Case*) = 0;
+  virtual void visit(const HeapOperation*) = 0;
+  virtual void visit(const Write*) = 0;
+  virtual void visit(const Read*) = 0;
+  virtual void visit(const Reset*) = 0;
 };
 
 class NonValueASTChecker {
@@ -47,6 +75,17 @@ class NonValueASTChecker {
   virtual void check(Block*) = 0;
   virtual void check(VariableDeclaration*) = 0;
   virtual void check(ProcedureDeclaration*) = 0;
+  virtual void check(Parameter*) = 0;
+  virtual void check(ProcedureCall*) = 0;
+  virtual void check(If*) = 0;
+  virtual void check(While*) = 0;
+  virtual void check(Repeat*) = 0;
+  virtual void check(For*) = 0;
+  virtual void check(Case*) = 0;
+  virtual void check(HeapOperation*) = 0;
+  virtual void check(Write*) = 0;
+  virtual void check(Read*) = 0;
+  virtual void check(Reset*) = 0;
 };
 
 class Block : public NonValueAST {
@@ -55,14 +94,24 @@ class Block : public NonValueAST {
   std::vector<std::unique_ptr<ProcedureDeclaration>> procedures_declarations_;
   std::unique_ptr<Compound> compound_statement_;
 
+  // the types the block declares, nullptr if it declares none; the
+  // pointer types of the program only refer to them weakly
+  std::shared_ptr<const TypeScope> types_;
+
+  // number of variable slots in the frame of this block,
+  // filled in by the semantic analyzer
+  int frame_size_ = 0;
+
  public:
   explicit Block(
       std::vector<std::unique_ptr<VariableDeclaration>> var_declarations,
       std::vector<std::unique_ptr<ProcedureDeclaration>> procedure_declarations,
-      std::unique_ptr<Compound> compound_statement)
+      std::unique_ptr<Compound> compound_statement,
+      std::shared_ptr<const TypeScope> types = nullptr)
       : var_declarations_(std::move(var_declarations)),
         procedures_declarations_(std::move(procedure_declarations)),
-        compound_statement_(std::move(compound_statement)) {}
+        compound_statement_(std::move(compound_statement)),
+        types_(std::move(types)) {}
 
   void accept(NonValueASTVisitor* visitor) const override {
     visitor->visit(this);
@@ -81,16 +130,81 @@ class Block : public NonValueAST {
   }
 
   Compound* compound_statement() const { return compound_statement_.get(); }
+
+  const std::shared_ptr<const TypeScope>& types() const { return types_; }
+
+  int frame_size() const { return frame_size_; }
+
+  void set_frame_size(int frame_size) { frame_size_ = frame_size; }
+};
+
+class Parameter : public NonValueAST {
+ private:
+  std::unique_ptr<Variable> variable_;
+  std::unique_ptr<Type> type_;
+
+  // VAR parameters are passed by reference
+  bool by_reference_;
+
+ public:
+  explicit Parameter(std::unique_ptr<Variable> variable,
+                     std::unique_ptr<Type> type, bool by_reference)
+      : variable_(std::move(variable)),
+        type_(std::move(type)),
+        by_reference_(by_reference) {}
+
+  void accept(NonValueASTVisitor* visitor) const override {
+    visitor->visit(this);
+  }
+
+  void accept(NonValueASTChecker* checker) override { checker->check(this); }
+
+  Variable* variable() const { return variable_.get(); }
+
+  Type* type() const { return type_.get(); }
+
+  bool by_reference() const { return by_reference_; }
 };
 
 class ProcedureDeclaration : public NonValueAST {
  private:
   std::string name_;
-  std::unique_ptr<Block> block_;
+  std::vector<std::unique_ptr<Parameter>> parameters_;
+  std::unique_ptr<Type> return_type_;
+
+  // shared because a checked body can be reused by later versions of the
+  // program, see CompilationCache
+  std::shared_ptr<Block> block_;
+
+  // source of the block when it was only pre-parsed, see Parser::skip_block,
+  // and a hash of its tokens
+  std::string body_source_;
+  uint64_t body_hash_ = 0;
+
+  // the types visible where a pre-parsed body is declared, which it is
+  // parsed with
+  std::shared_ptr<const TypeScope> types_;
 
  public:
-  explicit ProcedureDeclaration(std::string name, std::unique_ptr<Block> block)
-      : name_(std::move(name)), block_(std::move(block)) {}
+  // return_type is nullptr for a procedure
+  explicit ProcedureDeclaration(
+      std::string name, std::vector<std::unique_ptr<Parameter>> parameters,
+      std::unique_ptr<Type> return_type, std::unique_ptr<Block> block)
+      : name_(std::move(name)),
+        parameters_(std::move(parameters)),
+        return_type_(std::move(return_type)),
+        block_(std::move(block)) {}
+
+  explicit ProcedureDeclaration(
+      std::string name, std::vector<std::unique_ptr<Parameter>> parameters,
+      std::unique_ptr<Type> return_type, std::string body_source,
+      uint64_t body_hash, std::shared_ptr<const TypeScope> types)
+      : name_(std::move(name)),
+        parameters_(std::move(parameters)),
+        return_type_(std::move(return_type)),
+        body_source_(std::move(body_source)),
+        body_hash_(body_hash),
+        types_(std::move(types)) {}
 
   void accept(NonValueASTVisitor* visitor) const override {
     visitor->visit(this);
@@ -100,7 +214,35 @@ class ProcedureDeclaration : public NonValueAST {
 
   const std::string& name() const { return name_; }
 
+  // parameters take the first slots of the procedure's frame, in order
+  const std::vector<std::unique_ptr<Parameter>>& parameters() const {
+    return parameters_;
+  }
+
+  bool is_function() const { return return_type_ != nullptr; }
+
+  Type* return_type() const { return return_type_.get(); }
+
+  // a function returns through the slot following its parameters
+  int result_slot() const { return static_cast<int>(parameters_.size()); }
+
+  // nullptr until a pre-parsed body has been parsed
   Block* block() const { return block_.get(); }
+
+  bool parsed() const { return block_ != nullptr; }
+
+  const std::shared_ptr<Block>& shared_block() const { return block_; }
+
+  const std::string& body_source() const { return body_source_; }
+
+  uint64_t body_hash() const { return body_hash_; }
+
+  const std::shared_ptr<const TypeScope>& types() const { return types_; }
+
+  void set_block(std::shared_ptr<Block> block) {
+    block_ = std::move(block);
+    body_source_.clear();
+  }
 };
 
 class VariableDeclaration : public NonValueAST {
@@ -151,6 +293,10 @@ class Assign : public NonValueAST {
   std::unique_ptr<Variable> left_;
   std::unique_ptr<ValueAST> right_;
 
+  // a value assigned to a variable of a subrange type is compared with its
+  // bounds, unless the range analyzer proved it within
+  bool checked_ = true;
+
  public:
   Assign(std::unique_ptr<Variable> left, std::unique_ptr<ValueAST> right)
       : left_(std::move(left)), right_(std::move(right)) {}
@@ -161,6 +307,10 @@ class Assign : public NonValueAST {
 
   ValueAST* right_release() { return right_.release(); }
 
+  bool checked() const { return checked_; }
+
+  void set_checked(bool checked) { checked_ = checked; }
+
   void accept(NonValueASTVisitor* visitor) const override {
     visitor->visit(this);
   }
@@ -170,6 +320,207 @@ class Assign : public NonValueAST {
   void set_right(ValueAST* right) { right_.reset(right); }
 };
 
+// NEW(p) points p to a new block for what it points to, initialized like a
+// variable of that type; DISPOSE(p) releases the block and sets p to NIL.
+class HeapOperation : public NonValueAST {
+ public:
+  enum class Operator { NEW, DISPOSE };
+
+ private:
+  Operator operator_;
+  std::unique_ptr<Variable> variable_;
+
+  // bytes, layout and subrange of the target, set by the semantic analyzer
+  int64_t size_ = 0;
+  std::shared_ptr<const RecordType> record_;
+  std::optional<Interval> range_;
+
+ public:
+  HeapOperation(Operator op, std::unique_ptr<Variable> variable)
+      : operator_(op), variable_(std::move(variable)) {}
+
+  Operator op() const { return operator_; }
+
+  Variable* variable() const { return variable_.get(); }
+
+  int64_t size() const { return size_; }
+
+  const std::shared_ptr<const RecordType>& record() const { return record_; }
+
+  const std::optional<Interval>& range() const { return range_; }
+
+  void set_target(int64_t size, std::shared_ptr<const RecordType> record,
+                  const std::optional<Interval>& range) {
+    size_ = size;
+    record_ = std::move(record);
+    range_ = range;
+  }
+
+  void accept(NonValueASTVisitor* visitor) const override {
+    visitor->visit(this);
+  }
+
+  void accept(NonValueASTChecker* checker) override { checker->check(this); }
+};
+
+// WRITE(x, y : 8, z : 8 : 2) writes its arguments, each right-aligned in
+// the width after it if it has one, a REAL with the given number of
+// decimals; WRITELN ends the line after them.
+class Write : public NonValueAST {
+ public:
+  struct Argument {
+    std::unique_ptr<ValueAST> value;
+    // nullptr if not given
+    std::unique_ptr<ValueAST> width;
+    std::unique_ptr<ValueAST> precision;
+    // of value, set by the semantic analyzer
+    ValueAST::ValueType type = ValueAST::ValueType::INTEGER;
+  };
+
+ private:
+  std::vector<Argument> arguments_;
+  bool line_;
+
+ public:
+  Write(std::vector<Argument> arguments, bool line)
+      : arguments_(std::move(arguments)), line_(line) {}
+
+  const std::vector<Argument>& arguments() const { return arguments_; }
+
+  // for the checkers, which replace the expressions
+  Argument& argument(size_t i) { return arguments_[i]; }
+
+  bool line() const { return line_; }
+
+  void accept(NonValueASTVisitor* visitor) const override {
+    visitor->visit(this);
+  }
+
+  void accept(NonValueASTChecker* checker) override { checker->check(this); }
+};
+
+// READ(x, y) reads numbers from the text input into its variables, and
+// READLN then skips the rest of the line; READ(f, x, a) copies the next
+// elements of the FILE f into x, and into every element of the array a.
+class Read : public NonValueAST {
+ private:
+  std::vector<std::unique_ptr<Variable>> variables_;
+  bool line_;
+
+  // set by the semantic analyzer: whether the first variable is a FILE,
+  // and the types of the variables
+  bool from_file_ = false;
+  std::vector<ValueAST::ValueType> types_;
+
+ public:
+  Read(std::vector<std::unique_ptr<Variable>> variables, bool line)
+      : variables_(std::move(variables)), line_(line) {}
+
+  const std::vector<std::unique_ptr<Variable>>& variables() const {
+    return variables_;
+  }
+
+  bool line() const { return line_; }
+
+  bool from_file() const { return from_file_; }
+
+  const std::vector<ValueAST::ValueType>& types() const { return types_; }
+
+  void set_types(bool from_file, std::vector<ValueAST::ValueType> types) {
+    from_file_ = from_file;
+    types_ = std::move(types);
+  }
+
+  void accept(NonValueASTVisitor* visitor) const override {
+    visitor->visit(this);
+  }
+
+  void accept(NonValueASTChecker* checker) override { checker->check(this); }
+};
+
+// RESET(f, path) maps the file at path for reading the FILE f from its
+// start
+class Reset : public NonValueAST {
+ private:
+  std::unique_ptr<Variable> variable_;
+  std::unique_ptr<ValueAST> path_;
+
+  // bytes per element, set by the semantic analyzer
+  int64_t element_size_ = 0;
+
+ public:
+  Reset(std::unique_ptr<Variable> variable, std::unique_ptr<ValueAST> path)
+      : variable_(std::move(variable)), path_(std::move(path)) {}
+
+  Variable* variable() const { return variable_.get(); }
+
+  ValueAST* path() const { return path_.get(); }
+
+  ValueAST* path_release() { return path_.release(); }
+
+  void set_path(ValueAST* path) { path_.reset(path); }
+
+  int64_t element_size() const { return element_size_; }
+
+  void set_element_size(int64_t size) { element_size_ = size; }
+
+  void accept(NonValueASTVisitor* visitor) const override {
+    visitor->visit(this);
+  }
+
+  void accept(NonValueASTChecker* checker) override { checker->check(this); }
+};
+
+class ProcedureCall : public NonValueAST {
+ private:
+  std::string name_;
+  std::vector<std::unique_ptr<ValueAST>> arguments_;
+
+  // resolved by the semantic analyzer: the callee is the index-th
+  // procedure declared by the block running at lexical level level
+  int level_ = -1;
+  int index_ = -1;
+
+  // see FunctionCall::tail
+  bool tail_ = false;
+
+ public:
+  explicit ProcedureCall(std::string name,
+                         std::vector<std::unique_ptr<ValueAST>> arguments)
+      : name_(std::move(name)), arguments_(std::move(arguments)) {}
+
+  void accept(NonValueASTVisitor* visitor) const override {
+    visitor->visit(this);
+  }
+
+  void accept(NonValueASTChecker* checker) override { checker->check(this); }
+
+  const std::string& name() const { return name_; }
+
+  const std::vector<std::unique_ptr<ValueAST>>& arguments() const {
+    return arguments_;
+  }
+
+  ValueAST* argument_release(size_t i) { return arguments_[i].release(); }
+
+  void set_argument(size_t i, ValueAST* argument) {
+    arguments_[i].reset(argument);
+  }
+
+  int level() const { return level_; }
+
+  int index() const { return index_; }
+
+  void set_target(int level, int index) {
+    level_ = level;
+    index_ = index;
+  }
+
+  bool tail() const { return tail_; }
+
+  void set_tail(bool tail) { tail_ = tail; }
+};
+
 class Compound : public NonValueAST {
  private:
   std::vector<std::unique_ptr<NonValueAST>> children_;
@@ -183,11 +534,294 @@ class Compound : public NonValueAST {
     return children_;
   }
 
+  NonValueAST* child_release(size_t i) { return children_[i].release(); }
+
+  void set_child(size_t i, NonValueAST* child) { children_[i].reset(child); }
+
+  void accept(NonValueASTVisitor* visitor) const override {
+    visitor->visit(this);
+  }
+
+  void accept(NonValueASTChecker* checker) override { checker->check(this); }
+};
+
+class If : public NonValueAST {
+ private:
+  std::unique_ptr<ValueAST> condition_;
+  std::unique_ptr<NonValueAST> then_;
+  std::unique_ptr<NonValueAST> else_;
+
+ public:
+  // else_statement is nullptr without an ELSE branch
+  explicit If(std::unique_ptr<ValueAST> condition,
+              std::unique_ptr<NonValueAST> then_statement,
+              std::unique_ptr<NonValueAST> else_statement)
+      : condition_(std::move(condition)),
+        then_(std::move(then_statement)),
+        else_(std::move(else_statement)) {}
+
+  void accept(NonValueASTVisitor* visitor) const override {
+    visitor->visit(this);
+  }
+
+  void accept(NonValueASTChecker* checker) override { checker->check(this); }
+
+  ValueAST* condition() const { return condition_.get(); }
+
+  ValueAST* condition_release() { return condition_.release(); }
+
+  void set_condition(ValueAST* condition) { condition_.reset(condition); }
+
+  NonValueAST* then_statement() const { return then_.get(); }
+
+  NonValueAST* else_statement() const { return else_.get(); }
+
+  NonValueAST* then_release() { return then_.release(); }
+
+  NonValueAST* else_release() { return else_.release(); }
+
+  void set_then(NonValueAST* statement) { then_.reset(statement); }
+
+  void set_else(NonValueAST* statement) { else_.reset(statement); }
+};
+
+class While : public NonValueAST {
+ private:
+  std::unique_ptr<ValueAST> condition_;
+  std::unique_ptr<NonValueAST> body_;
+
+ public:
+  explicit While(std::unique_ptr<ValueAST> condition,
+                 std::unique_ptr<NonValueAST> body)
+      : condition_(std::move(condition)), body_(std::move(body)) {}
+
+  void accept(NonValueASTVisitor* visitor) const override {
+    visitor->visit(this);
+  }
+
+  void accept(NonValueASTChecker* checker) override { checker->check(this); }
+
+  ValueAST* condition() const { return condition_.get(); }
+
+  ValueAST* condition_release() { return condition_.release(); }
+
+  void set_condition(ValueAST* condition) { condition_.reset(condition); }
+
+  NonValueAST* body() const { return body_.get(); }
+
+  NonValueAST* body_release() { return body_.release(); }
+
+  void set_body(NonValueAST* body) { body_.reset(body); }
+};
+
+class Repeat : public NonValueAST {
+ private:
+  std::unique_ptr<Compound> body_;
+  std::unique_ptr<ValueAST> condition_;
+
+ public:
+  explicit Repeat(std::unique_ptr<Compound> body,
+                  std::unique_ptr<ValueAST> condition)
+      : body_(std::move(body)), condition_(std::move(condition)) {}
+
   void accept(NonValueASTVisitor* visitor) const override {
     visitor->visit(this);
   }
 
   void accept(NonValueASTChecker* checker) override { checker->check(this); }
+
+  Compound* body() const { return body_.get(); }
+
+  ValueAST* condition() const { return condition_.get(); }
+
+  ValueAST* condition_release() { return condition_.release(); }
+
+  void set_condition(ValueAST* condition) { condition_.reset(condition); }
+};
+
+class For : public NonValueAST {
+ private:
+  std::unique_ptr<Variable> variable_;
+  std::unique_ptr<ValueAST> start_;
+  std::unique_ptr<ValueAST> end_;
+  std::unique_ptr<NonValueAST> body_;
+
+  // DOWNTO instead of TO
+  bool down_;
+
+  // set by the semantic analyzer when the body provably does not modify
+  // the control variable; the loop then runs a precomputed number of times
+  bool counted_ = false;
+
+  // set by the optimizer when the counted loop is element-wise over arrays
+  std::shared_ptr<const Kernel> kernel_;
+
+ public:
+  explicit For(std::unique_ptr<Variable> variable,
+               std::unique_ptr<ValueAST> start, std::unique_ptr<ValueAST> end,
+               bool down, std::unique_ptr<NonValueAST> body)
+      : variable_(std::move(variable)),
+        start_(std::move(start)),
+        end_(std::move(end)),
+        body_(std::move(body)),
+        down_(down) {}
+
+  void accept(NonValueASTVisitor* visitor) const override {
+    visitor->visit(this);
+  }
+
+  void accept(NonValueASTChecker* checker) override { checker->check(this); }
+
+  Variable* variable() const { return variable_.get(); }
+
+  ValueAST* start() const { return start_.get(); }
+
+  ValueAST* end() const { return end_.get(); }
+
+  ValueAST* start_release() { return start_.release(); }
+
+  ValueAST* end_release() { return end_.release(); }
+
+  void set_start(ValueAST* start) { start_.reset(start); }
+
+  void set_end(ValueAST* end) { end_.reset(end); }
+
+  NonValueAST* body() const { return body_.get(); }
+
+  NonValueAST* body_release() { return body_.release(); }
+
+  void set_body(NonValueAST* body) { body_.reset(body); }
+
+  bool down() const { return down_; }
+
+  bool counted() const { return counted_; }
+
+  void set_counted(bool counted) { counted_ = counted; }
+
+  const Kernel* kernel() const { return kernel_.get(); }
+
+  void set_kernel(std::shared_ptr<const Kernel> kernel) {
+    kernel_ = std::move(kernel);
+  }
+};
+
+class Case : public NonValueAST {
+ public:
+  // label values low..high; a single label has low == high
+  struct Label {
+    int64_t low;
+    int64_t high;
+    ValueAST::ValueType type;
+  };
+
+  struct Branch {
+    std::vector<Label> labels;
+    std::unique_ptr<NonValueAST> statement;
+  };
+
+  // how the semantic analyzer chose to find the branch of a value:
+  // LINEAR compares against every range, TABLE indexes table_ by the
+  // value's offset from the smallest label, SEARCH bisects the ranges
+  enum class Dispatch { LINEAR, TABLE, SEARCH };
+
+  struct Range {
+    int64_t low;
+    int64_t high;
+    int branch;
+  };
+
+ private:
+  std::unique_ptr<ValueAST> selector_;
+  std::vector<Branch> branches_;
+  std::unique_ptr<NonValueAST> else_;
+
+  Dispatch dispatch_ = Dispatch::LINEAR;
+
+  // the labels of all branches, sorted and disjoint
+  std::vector<Range> ranges_;
+
+  // branch per value from ranges_.front().low, -1 where there is none
+  std::vector<int> table_;
+
+ public:
+  // else_statement is nullptr without an ELSE branch
+  explicit Case(std::unique_ptr<ValueAST> selector,
+                std::vector<Branch> branches,
+                std::unique_ptr<NonValueAST> else_statement)
+      : selector_(std::move(selector)),
+        branches_(std::move(branches)),
+        else_(std::move(else_statement)) {}
+
+  void accept(NonValueASTVisitor* visitor) const override {
+    visitor->visit(this);
+  }
+
+  void accept(NonValueASTChecker* checker) override { checker->check(this); }
+
+  ValueAST* selector() const { return selector_.get(); }
+
+  ValueAST* selector_release() { return selector_.release(); }
+
+  void set_selector(ValueAST* selector) { selector_.reset(selector); }
+
+  const std::vector<Branch>& branches() const { return branches_; }
+
+  NonValueAST* branch_release(size_t i) {
+    return branches_[i].statement.release();
+  }
+
+  void set_branch(size_t i, NonValueAST* statement) {
+    branches_[i].statement.reset(statement);
+  }
+
+  NonValueAST* else_statement() const { return else_.get(); }
+
+  NonValueAST* else_release() { return else_.release(); }
+
+  void set_else(NonValueAST* statement) { else_.reset(statement); }
+
+  Dispatch dispatch() const { return dispatch_; }
+
+  const std::vector<Range>& ranges() const { return ranges_; }
+
+  void set_dispatch(Dispatch dispatch, std::vector<Range> ranges,
+                    std::vector<int> table) {
+    dispatch_ = dispatch;
+    ranges_ = std::move(ranges);
+    table_ = std::move(table);
+  }
+
+  // index of the branch labelled with value, -1 if there is none
+  int branch(int64_t value) const {
+    switch (dispatch_) {
+      case Dispatch::TABLE: {
+        // unsigned, so that no offset from an INT64 selector overflows
+        const auto offset = static_cast<uint64_t>(value) -
+                            static_cast<uint64_t>(ranges_.front().low);
+        if (value < ranges_.front().low || offset >= table_.size()) {
+          return -1;
+        }
+        return table_[offset];
+      }
+      case Dispatch::SEARCH: {
+        auto it = std::upper_bound(ranges_.begin(), ranges_.end(), value,
+                                   [](int64_t value, const Range& range) {
+                                     return value < range.low;
+                                   });
+        if (it == ranges_.begin() || (--it)->high < value) {
+          return -1;
+        }
+        return it->branch;
+      }
+      default:
+        for (const auto& range : ranges_) {
+          if (range.low <= value && value <= range.high) {
+            return range.branch;
+          }
+        }
+        return -1;
+    }
+  }
 };
 
 }  // namespace Pascal
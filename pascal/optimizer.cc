@@ -0,0 +1,601 @@
+// Copyright 2023 Zhu Junhui
+
+#include "optimizer.h"
+#include "kernel.h"
+#include <algorithm>
+#include <bit>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace Pascal {
+
+namespace {
+
+bool is_leaf(const ValueAST* expr) {
+  const auto variable = dynamic_cast<const Variable*>(expr);
+  return (variable != nullptr && variable->whole()) ||
+         dynamic_cast<const Number*>(expr) != nullptr;
+}
+
+ValueAST* typed(ValueAST* node, ValueAST::ValueType type) {
+  const auto result = node->wrap_with_type(type).first;
+  delete node;
+  return result;
+}
+
+ValueAST* integer(int value) {
+  return typed(new Number(Token(Token::Type::INTEGER_CONST, value)),
+               ValueAST::ValueType::INTEGER);
+}
+
+// k if divisor is the constant 2^k for k > 0, otherwise 0
+int shift_of(const ValueAST* divisor) {
+  const auto number = dynamic_cast<const Number*>(divisor);
+  if (number == nullptr) {
+    return 0;
+  }
+  const auto value = static_cast<unsigned>(std::get<int>(number->value()));
+  if (value < 2 || !std::has_single_bit(value)) {
+    return 0;
+  }
+  return std::countr_zero(value);
+}
+
+// a set of constants, listed as ranges of members
+ValueAST* constant_set(const Set& members) {
+  std::vector<SetConstructor::Element> elements;
+  for (int member = 0; member <= Set::MAX_MEMBER; ++member) {
+    if (!members.contains(member)) {
+      continue;
+    }
+    int last = member;
+    while (last < Set::MAX_MEMBER && members.contains(last + 1)) {
+      ++last;
+    }
+    elements.push_back(
+        {std::unique_ptr<ValueAST>(integer(member)),
+         last > member ? std::unique_ptr<ValueAST>(integer(last)) : nullptr});
+    member = last;
+  }
+  const auto constructor = new SetConstructor(std::move(elements));
+  constructor->set_constant(members);
+  return typed(constructor, ValueAST::ValueType::SET);
+}
+
+// the operands of a chain of ORs, in the order they are evaluated
+void disjuncts(const ValueAST* expr, std::vector<const ValueAST*>* operands) {
+  const auto op = dynamic_cast<const BinaryOperation*>(expr);
+  if (op == nullptr || op->op() != BinaryOperation::Operator::OR) {
+    operands->push_back(expr);
+    return;
+  }
+  disjuncts(op->left(), operands);
+  disjuncts(op->right(), operands);
+}
+
+// the same, taken out of the chain, whose ORs are deleted
+void release_disjuncts(ValueAST* expr, std::vector<ValueAST*>* operands) {
+  const auto op = dynamic_cast<BinaryOperation*>(expr);
+  if (op == nullptr || op->op() != BinaryOperation::Operator::OR) {
+    operands->push_back(expr);
+    return;
+  }
+  release_disjuncts(op->left_release(), operands);
+  release_disjuncts(op->right_release(), operands);
+  delete op;
+}
+
+// the variable and the constant of x = c or c = x, for a scalar INTEGER
+// variable x and a constant c that can be a member of a set; such a test
+// neither fails nor changes anything
+std::optional<std::pair<const Variable*, int>> equality(const ValueAST* expr) {
+  const auto op = dynamic_cast<const BinaryOperation*>(expr);
+  if (op == nullptr || op->op() != BinaryOperation::Operator::EQUAL) {
+    return std::nullopt;
+  }
+  auto variable = dynamic_cast<const Variable*>(op->left());
+  auto number = dynamic_cast<const Number*>(op->right());
+  if (variable == nullptr) {
+    variable = dynamic_cast<const Variable*>(op->right());
+    number = dynamic_cast<const Number*>(op->left());
+  }
+  if (variable == nullptr || number == nullptr || !variable->whole() ||
+      variable->type() != ValueAST::ValueType::INTEGER) {
+    return std::nullopt;
+  }
+  const int value = std::get<int>(number->value());
+  if (value < 0 || value > Set::MAX_MEMBER) {
+    return std::nullopt;
+  }
+  return std::pair{variable, value};
+}
+
+bool same(const Variable* left, const Variable* right) {
+  return left->level() == right->level() && left->slot() == right->slot() &&
+         left->by_reference() == right->by_reference();
+}
+
+// the lengths of the runs of equalities on one variable, at least 1 each
+std::vector<size_t> runs(const std::vector<const ValueAST*>& operands) {
+  std::vector<size_t> lengths;
+  for (size_t i = 0; i < operands.size();) {
+    size_t length = 1;
+    if (const auto first = equality(operands[i])) {
+      while (i + length < operands.size()) {
+        const auto next = equality(operands[i + length]);
+        if (!next || !same(next->first, first->first)) {
+          break;
+        }
+        ++length;
+      }
+    }
+    lengths.push_back(length);
+    i += length;
+  }
+  return lengths;
+}
+
+// evaluating op can fail, so it must not run where it did not before; the
+// range analyzer has cleared the checks of INTEGER operations that cannot
+template <class Operation>
+bool traps(const Operation* op) {
+  return (op->type() == ValueAST::ValueType::INTEGER ||
+          op->type() == ValueAST::ValueType::INT64) &&
+         op->checked();
+}
+
+}  // namespace
+
+ValueAST* Optimizer::temporary(int slot, ValueAST::ValueType type) const {
+  const auto variable =
+      new Variable(Token(Token::Type::ID, "temp#" + std::to_string(slot)));
+  variable->set_address(scope_->level(), slot);
+  return typed(variable, type);
+}
+
+ValueAST* Optimizer::copy(const ValueAST* leaf) {
+  if (const auto number = dynamic_cast<const Number*>(leaf)) {
+    const auto value = number->value();
+    switch (number->type()) {
+      case ValueAST::ValueType::INTEGER:
+        return integer(std::get<int>(value));
+      case ValueAST::ValueType::INT64:
+        return typed(new Number(Token(Token::Type::INTEGER_CONST,
+                                      std::get<int64_t>(value))),
+                     ValueAST::ValueType::INT64);
+      case ValueAST::ValueType::STRING:
+        return typed(new Number(Token(Token::Type::STRING_CONST,
+                                      std::string(
+                                          std::get<String>(value).view()))),
+                     ValueAST::ValueType::STRING);
+      case ValueAST::ValueType::REAL:
+        return typed(
+            new Number(Token(Token::Type::REAL_CONST, std::get<double>(value))),
+            ValueAST::ValueType::REAL);
+      case ValueAST::ValueType::POINTER:
+        return typed(new Number(Token(Token::Type::NIL)),
+                     ValueAST::ValueType::POINTER);
+      default:
+        return typed(
+            new Number(Token(Token::Type::BOOLEAN_CONST, std::get<int>(value))),
+            ValueAST::ValueType::BOOLEAN);
+    }
+  }
+
+  const auto variable = static_cast<const Variable*>(leaf);
+  const auto result = new Variable(Token(Token::Type::ID, variable->value()));
+  result->set_address(variable->level(), variable->slot(),
+                      variable->by_reference());
+  return typed(result, variable->type());
+}
+
+// a temporary is a scalar slot, so sets and strings stay where they are
+ValueAST* Optimizer::hoist(ValueAST* expr, size_t depth) {
+  if (depth >= loops_.size() || is_leaf(expr) ||
+      expr->type() == ValueAST::ValueType::SET ||
+      expr->type() == ValueAST::ValueType::STRING) {
+    return expr;
+  }
+  const auto type = expr->type();
+  const int slot = scope_->reserve_slot();
+  loops_[depth].preheader.push_back(std::make_unique<Assign>(
+      std::unique_ptr<Variable>(
+          static_cast<Variable*>(temporary(slot, type))),
+      std::unique_ptr<ValueAST>(expr)));
+  return temporary(slot, type);
+}
+
+ValueAST* Optimizer::expression(ValueAST* expr) {
+  const auto result = expr->accept(this).first;
+  return hoist(result, depth_);
+}
+
+NonValueAST* Optimizer::statement(NonValueAST* statement) {
+  statement->accept(this);
+  if (preheader_.empty()) {
+    return statement;
+  }
+
+  const auto compound = new Compound();
+  for (auto& hoisted : preheader_) {
+    compound->add_child(std::move(hoisted));
+  }
+  preheader_.clear();
+  compound->add_child(std::unique_ptr<NonValueAST>(statement));
+  return compound;
+}
+
+void Optimizer::enter_loop(NonValueAST* loop, For* counted) {
+  Effects effects(scope_);
+  loop->accept(&effects);
+  loops_.push_back(Loop{std::move(effects), counted, {}, {}, {}});
+}
+
+void Optimizer::exit_loop() {
+  preheader_ = std::move(loops_.back().preheader);
+  loops_.pop_back();
+}
+
+void Optimizer::optimize(Block* block) {
+  block->compound_statement()->accept(this);
+}
+
+ValueAST* Optimizer::reduce(BinaryOperation* op, size_t left_depth,
+                            size_t right_depth) {
+  // the temporary runs ahead of the product, so the product has to be
+  // proven not to overflow
+  if (op->op() != BinaryOperation::Operator::MULTIPLY ||
+      op->type() != ValueAST::ValueType::INTEGER || op->checked()) {
+    return nullptr;
+  }
+
+  // the innermost counted loop controlled by one operand, in which the
+  // other one is invariant
+  for (size_t k = loops_.size(); k-- > 0;) {
+    const auto loop = loops_[k].counted;
+    if (loop == nullptr) {
+      continue;
+    }
+    const auto is_control = [&](const ValueAST* expr) {
+      const auto variable = dynamic_cast<const Variable*>(expr);
+      return variable != nullptr && variable->whole() &&
+             variable->level() == loop->variable()->level() &&
+             variable->slot() == loop->variable()->slot();
+    };
+
+    ValueAST* factor;
+    if (is_control(op->left()) && right_depth <= k) {
+      factor = hoist(op->right_release(), right_depth);
+    } else if (is_control(op->right()) && left_depth <= k) {
+      factor = hoist(op->left_release(), left_depth);
+    } else {
+      continue;
+    }
+
+    std::pair<int, int> key;
+    if (const auto number = dynamic_cast<const Number*>(factor)) {
+      key = {-1, std::get<int>(number->value())};
+    } else {
+      const auto variable = static_cast<const Variable*>(factor);
+      key = {variable->level(), variable->slot()};
+    }
+
+    auto& induction = loops_[k];
+    auto it = induction.inductions.find(key);
+    if (it == induction.inductions.end()) {
+      const auto type = ValueAST::ValueType::INTEGER;
+      const int slot = scope_->reserve_slot();
+      it = induction.inductions.emplace(key, slot).first;
+
+      // the start value is needed twice, so it has to be a leaf
+      if (!is_leaf(loop->start())) {
+        const int start = scope_->reserve_slot();
+        induction.preheader.push_back(std::make_unique<Assign>(
+            std::unique_ptr<Variable>(
+                static_cast<Variable*>(temporary(start, type))),
+            std::unique_ptr<ValueAST>(loop->start_release())));
+        loop->set_start(temporary(start, type));
+      }
+
+      // slot := start * factor in front of the loop and
+      // slot := slot +- factor at the end of every iteration; both wrap
+      // around, the values used inside the loop are those of the product
+      const auto initial = new BinaryOperation(
+          std::unique_ptr<ValueAST>(copy(loop->start())),
+          std::unique_ptr<ValueAST>(copy(factor)),
+          BinaryOperation::Operator::MULTIPLY);
+      initial->set_checked(false);
+      induction.preheader.push_back(std::make_unique<Assign>(
+          std::unique_ptr<Variable>(
+              static_cast<Variable*>(temporary(slot, type))),
+          std::unique_ptr<ValueAST>(typed(initial, type))));
+
+      const auto step = new BinaryOperation(
+          std::unique_ptr<ValueAST>(temporary(slot, type)),
+          std::unique_ptr<ValueAST>(copy(factor)),
+          loop->down() ? BinaryOperation::Operator::MINUS
+                       : BinaryOperation::Operator::PLUS);
+      step->set_checked(false);
+      induction.increments.push_back(std::make_unique<Assign>(
+          std::unique_ptr<Variable>(
+              static_cast<Variable*>(temporary(slot, type))),
+          std::unique_ptr<ValueAST>(typed(step, type))));
+    }
+
+    delete factor;
+    delete op;
+    depth_ = loops_.size();
+    return temporary(it->second, ValueAST::ValueType::INTEGER);
+  }
+  return nullptr;
+}
+
+// the equalities of a run are consecutive operands of the chain and have
+// no effects, so testing them at once keeps what the chain evaluates
+ValueAST* Optimizer::membership(BinaryOperation* op) {
+  std::vector<const ValueAST*> chain;
+  disjuncts(op, &chain);
+  const auto lengths = runs(chain);
+  if (lengths.size() == chain.size()) {
+    return nullptr;
+  }
+
+  std::vector<ValueAST*> operands;
+  release_disjuncts(op, &operands);
+  ValueAST* result = nullptr;
+  size_t i = 0;
+  for (const auto length : lengths) {
+    auto operand = operands[i];
+    if (length > 1) {
+      Set members;
+      for (size_t k = i; k < i + length; ++k) {
+        const int member = equality(operands[k])->second;
+        members.insert(member, member);
+      }
+      const auto variable = copy(equality(operands[i])->first);
+      for (size_t k = i; k < i + length; ++k) {
+        delete operands[k];
+      }
+      operand = typed(new BinaryOperation(
+                          std::unique_ptr<ValueAST>(variable),
+                          std::unique_ptr<ValueAST>(constant_set(members)),
+                          BinaryOperation::Operator::IN),
+                      ValueAST::ValueType::BOOLEAN);
+    }
+    result = result == nullptr
+                 ? operand
+                 : typed(new BinaryOperation(std::unique_ptr<ValueAST>(result),
+                                             std::unique_ptr<ValueAST>(operand),
+                                             BinaryOperation::Operator::OR),
+                         ValueAST::ValueType::BOOLEAN);
+    i += length;
+  }
+  return result;
+}
+
+std::pair<ValueAST*, ValueAST::ValueType> Optimizer::check(
+    BinaryOperation* op) {
+  if (op->op() == BinaryOperation::Operator::OR) {
+    if (const auto rewritten = membership(op)) {
+      return rewritten->accept(this);
+    }
+  }
+
+  op->set_left(op->left_release()->accept(this).first);
+  const auto left_depth = depth_;
+  op->set_right(op->right_release()->accept(this).first);
+  const auto right_depth = depth_;
+
+  if (const auto reduced = reduce(op, left_depth, right_depth)) {
+    return {reduced, ValueAST::ValueType::INTEGER};
+  }
+
+  if (op->op() == BinaryOperation::Operator::INTEGER_DIV &&
+      op->type() == ValueAST::ValueType::INTEGER) {
+    if (const auto shift = shift_of(op->right())) {
+      op->set_op(BinaryOperation::Operator::SHIFT_DIV);
+      op->set_right(integer(shift));
+    }
+  }
+
+  // only the largest invariant expressions are hoisted
+  auto depth = std::max(left_depth, right_depth);
+  if (traps(op)) {
+    depth = loops_.size();
+  }
+  if (left_depth < depth) {
+    op->set_left(hoist(op->left_release(), left_depth));
+  }
+  if (right_depth < depth) {
+    op->set_right(hoist(op->right_release(), right_depth));
+  }
+
+  depth_ = depth;
+  return {op, op->type()};
+}
+
+std::pair<ValueAST*, ValueAST::ValueType> Optimizer::check(
+    UnaryOperation* op) {
+  op->set_expr(op->expr_release()->accept(this).first);
+  if (traps(op) && depth_ < loops_.size()) {
+    op->set_expr(hoist(op->expr_release(), depth_));
+    depth_ = loops_.size();
+  }
+  return {op, op->type()};
+}
+
+std::pair<ValueAST*, ValueAST::ValueType> Optimizer::check(Number* number) {
+  depth_ = 0;
+  return {number, number->type()};
+}
+
+void Optimizer::indices(Variable* variable) {
+  for (size_t i = 0; i < variable->indices().size(); ++i) {
+    variable->set_index(i, expression(variable->index_release(i)));
+  }
+}
+
+std::pair<ValueAST*, ValueAST::ValueType> Optimizer::check(
+    Variable* variable) {
+  // an element is not hoisted, it may be out of range where the loop
+  // would not have read it, nor what a pointer that may be NIL points to;
+  // invariant parts of its indices are
+  if (!variable->indices().empty() || !variable->dereferences().empty()) {
+    indices(variable);
+    depth_ = loops_.size();
+    return {variable, variable->type()};
+  }
+
+  // a loop writes everything its inner loops write
+  depth_ = loops_.size();
+  for (size_t k = 0; k < loops_.size(); ++k) {
+    if (!loops_[k].effects.may_write(variable)) {
+      depth_ = k;
+      break;
+    }
+  }
+  return {variable, variable->type()};
+}
+
+std::pair<ValueAST*, ValueAST::ValueType> Optimizer::check(
+    FunctionCall* call) {
+  // a host function takes every argument by value
+  const auto callee =
+      call->host() == nullptr ? scope_->lookup(call->name())->procedure
+                              : nullptr;
+  for (size_t i = 0; i < call->arguments().size(); ++i) {
+    if (callee == nullptr || !callee->parameters()[i]->by_reference()) {
+      call->set_argument(i, expression(call->argument_release(i)));
+    } else {
+      indices(static_cast<Variable*>(call->arguments()[i].get()));
+    }
+  }
+  depth_ = loops_.size();
+  return {call, call->type()};
+}
+
+// a set of constants cannot fail, any other may on a member out of range
+std::pair<ValueAST*, ValueAST::ValueType> Optimizer::check(
+    SetConstructor* constructor) {
+  if (constructor->constant().has_value()) {
+    depth_ = 0;
+    return {constructor, constructor->type()};
+  }
+  for (size_t i = 0; i < constructor->elements().size(); ++i) {
+    constructor->set_low(i, expression(constructor->low_release(i)));
+    if (constructor->elements()[i].high != nullptr) {
+      constructor->set_high(i, expression(constructor->high_release(i)));
+    }
+  }
+  depth_ = loops_.size();
+  return {constructor, constructor->type()};
+}
+
+void Optimizer::check(Compound* compound) {
+  for (size_t i = 0; i < compound->children().size(); ++i) {
+    compound->set_child(i, statement(compound->child_release(i)));
+  }
+}
+
+void Optimizer::check(Assign* assign) {
+  assign->set_right(expression(assign->right_release()));
+  indices(assign->left());
+}
+
+void Optimizer::check(HeapOperation* operation) {
+  indices(operation->variable());
+}
+
+void Optimizer::check(Write* write) {
+  for (size_t i = 0; i < write->arguments().size(); ++i) {
+    auto& argument = write->argument(i);
+    argument.value.reset(expression(argument.value.release()));
+    if (argument.width != nullptr) {
+      argument.width.reset(expression(argument.width.release()));
+    }
+    if (argument.precision != nullptr) {
+      argument.precision.reset(expression(argument.precision.release()));
+    }
+  }
+}
+
+void Optimizer::check(Read* read) {
+  for (const auto& variable : read->variables()) {
+    indices(variable.get());
+  }
+}
+
+void Optimizer::check(Reset* reset) {
+  reset->set_path(expression(reset->path_release()));
+}
+
+void Optimizer::check(ProcedureCall* call) {
+  const auto callee = scope_->lookup(call->name())->procedure;
+  for (size_t i = 0; i < call->arguments().size(); ++i) {
+    if (!callee->parameters()[i]->by_reference()) {
+      call->set_argument(i, expression(call->argument_release(i)));
+    } else {
+      indices(static_cast<Variable*>(call->arguments()[i].get()));
+    }
+  }
+}
+
+void Optimizer::check(If* statement) {
+  statement->set_condition(expression(statement->condition_release()));
+  statement->set_then(this->statement(statement->then_release()));
+  if (statement->else_statement() != nullptr) {
+    statement->set_else(this->statement(statement->else_release()));
+  }
+}
+
+void Optimizer::check(Case* statement) {
+  statement->set_selector(expression(statement->selector_release()));
+  for (size_t i = 0; i < statement->branches().size(); ++i) {
+    statement->set_branch(i, this->statement(statement->branch_release(i)));
+  }
+  if (statement->else_statement() != nullptr) {
+    statement->set_else(this->statement(statement->else_release()));
+  }
+}
+
+void Optimizer::check(While* loop) {
+  enter_loop(loop, nullptr);
+  loop->set_condition(expression(loop->condition_release()));
+  loop->set_body(statement(loop->body_release()));
+  exit_loop();
+}
+
+void Optimizer::check(Repeat* loop) {
+  enter_loop(loop, nullptr);
+  loop->body()->accept(this);
+  loop->set_condition(expression(loop->condition_release()));
+  exit_loop();
+}
+
+void Optimizer::check(For* loop) {
+  // the start and final values are evaluated once in front of the loop
+  loop->set_start(expression(loop->start_release()));
+  loop->set_end(expression(loop->end_release()));
+
+  enter_loop(loop, loop->counted() ? loop : nullptr);
+  loop->set_body(statement(loop->body_release()));
+
+  auto& increments = loops_.back().increments;
+  if (!increments.empty()) {
+    const auto body = new Compound();
+    body->add_child(std::unique_ptr<NonValueAST>(loop->body_release()));
+    for (auto& increment : increments) {
+      body->add_child(std::move(increment));
+    }
+    loop->set_body(body);
+  }
+  exit_loop();
+
+  // after hoisting, invariant parts of the element expression are scalars
+  if (loop->counted()) {
+    loop->set_kernel(Kernel::compile(loop));
+  }
+}
+
+}  // namespace Pascal
@@ -0,0 +1,112 @@
+// Copyright 2023 Zhu Junhui
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "ast.h"
+#include "effects.h"
+#include "symbol_table.h"
+
+namespace Pascal {
+
+// Rewrites the checked statements of one block, while the semantic analyzer
+// still has the block's scope open:
+// - expressions that no enclosing loop can change and that cannot trap are
+//   computed once into a temporary slot in front of the outermost loop they
+//   are invariant in,
+// - i * c, where i controls a counted FOR loop, c is invariant in it and
+//   the product cannot overflow, becomes a temporary that the loop advances
+//   by c per iteration,
+// - x DIV 2^k becomes a shift, corrected to round toward zero,
+// - consecutive (x = c1) OR (x = c2) OR ... on one INTEGER variable become
+//   x IN [c1, c2, ...], one bit test in a constant set,
+// - a counted loop that is element-wise over arrays gets a Kernel.
+class Optimizer : public Checker {
+ private:
+  T::SymbolTable* scope_;
+
+  struct Loop {
+    Effects effects;
+
+    // the loop itself if it is a counted FOR loop, nullptr otherwise
+    For* counted;
+
+    // statements to run in front of the loop and at the end of its body
+    std::vector<std::unique_ptr<NonValueAST>> preheader;
+    std::vector<std::unique_ptr<NonValueAST>> increments;
+
+    // slot of the temporary holding control variable * factor, by factor:
+    // (level, slot) of a variable or (-1, value) of a constant
+    std::map<std::pair<int, int>, int> inductions;
+  };
+  std::vector<Loop> loops_;
+
+  // preheader of the loop finished last, to be put in front of it
+  std::vector<std::unique_ptr<NonValueAST>> preheader_;
+
+  // invariance of the expression checked last: the index of the outermost
+  // enclosing loop it does not change in, loops_.size() if it changes in
+  // the innermost one
+  size_t depth_ = 0;
+
+  // a typed reference to a temporary, or a copy of a number or variable
+  ValueAST* temporary(int slot, ValueAST::ValueType type) const;
+  static ValueAST* copy(const ValueAST* leaf);
+
+  ValueAST* hoist(ValueAST* expr, size_t depth);
+
+  // check an expression evaluated by a statement
+  ValueAST* expression(ValueAST* expr);
+
+  // check the indices of a variable, each as an expression
+  void indices(Variable* variable);
+
+  // check a statement, wrapping a loop together with its preheader
+  NonValueAST* statement(NonValueAST* statement);
+
+  void enter_loop(NonValueAST* loop, For* counted);
+
+  void exit_loop();
+
+  // replace i * c by an induction temporary, or return nullptr
+  ValueAST* reduce(BinaryOperation* op, size_t left_depth, size_t right_depth);
+
+  // rebuild a chain of ORs with its runs of equalities as IN, or return
+  // nullptr if it has none
+  static ValueAST* membership(BinaryOperation* op);
+
+ public:
+  explicit Optimizer(T::SymbolTable* scope) : scope_(scope) {}
+
+  void optimize(Block* block);
+
+  std::pair<ValueAST*, ValueAST::ValueType> check(BinaryOperation*) override;
+  std::pair<ValueAST*, ValueAST::ValueType> check(UnaryOperation*) override;
+  std::pair<ValueAST*, ValueAST::ValueType> check(Number*) override;
+  std::pair<ValueAST*, ValueAST::ValueType> check(Variable*) override;
+  std::pair<ValueAST*, ValueAST::ValueType> check(FunctionCall*) override;
+  std::pair<ValueAST*, ValueAST::ValueType> check(SetConstructor*) override;
+  ValueAST::ValueType check(Type* type) override { return type->value(); }
+  void check(Compound*) override;
+  void check(Assign*) override;
+  void check(Program*) override {}
+  void check(Block*) override {}
+  void check(VariableDeclaration*) override {}
+  void check(ProcedureDeclaration*) override {}
+  void check(Parameter*) override {}
+  void check(ProcedureCall*) override;
+  void check(If*) override;
+  void check(While*) override;
+  void check(Repeat*) override;
+  void check(For*) override;
+  void check(Case*) override;
+  void check(HeapOperation*) override;
+  void check(Write*) override;
+  void check(Read*) override;
+  void check(Reset*) override;
+};
+
+}  // namespace Pascal
@@ -0,0 +1,196 @@
+// Copyright 2023 Zhu Junhui
+
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <variant>
+#include <vector>
+#include "compiled_program.h"
+
+// Generates random loop nests full of invariant expressions, products of
+// control variables, DIV by powers of two and chains of equalities joined
+// by OR, and checks that optimized and unoptimized runs write the same
+// text and end with the same global variables, or fail with the same
+// error, also when the optimized program runs on two threads at once.
+class Generator {
+ private:
+  std::mt19937 random_;
+  std::vector<std::string> free_ = {"i", "j", "k"};
+
+  int number(int low, int high) {
+    return std::uniform_int_distribution<int>(low, high)(random_);
+  }
+
+  template <class T>
+  const T& pick(const std::vector<T>& values) {
+    return values[number(0, static_cast<int>(values.size()) - 1)];
+  }
+
+  std::string operand(const std::vector<std::string>& controls) {
+    switch (number(0, 3)) {
+      case 0:
+        return std::to_string(number(-9, 9));
+      case 1:
+        if (!controls.empty()) {
+          return pick(controls);
+        }
+        [[fallthrough]];
+      case 2:
+        return pick(std::vector<std::string>{"a", "b", "c"});
+      default:
+        return "Twice(" + pick(std::vector<std::string>{"a", "b", "c"}) + ")";
+    }
+  }
+
+  std::string expression(const std::vector<std::string>& controls,
+                         int depth) {
+    if (depth == 0) {
+      return operand(controls);
+    }
+    const auto left = expression(controls, depth - 1);
+    const auto right = expression(controls, depth - 1);
+    switch (number(0, 4)) {
+      case 0:
+        return "(" + left + " + " + right + ")";
+      case 1:
+        return "(" + left + " - " + right + ")";
+      case 2:
+        return "(" + left + " * " + operand(controls) + ")";
+      case 3:
+        return "(" + left + " DIV " + std::to_string(1 << number(0, 4)) + ")";
+      default:
+        return "(" + pick(controls.empty() ? std::vector<std::string>{"a"}
+                                           : controls) +
+               " * " + operand({}) + ")";
+    }
+  }
+
+  // (x = c1) OR (x = c2) OR ..., mostly on one variable
+  std::string membership(const std::vector<std::string>& controls) {
+    auto variables = controls;
+    variables.insert(variables.end(), {"a", "b"});
+    const auto variable = pick(variables);
+    std::string text;
+    const int count = number(1, 5);
+    for (int n = 0; n < count; ++n) {
+      text += (n > 0 ? " OR (" : "(") +
+              (number(0, 4) > 0 ? variable : pick(variables)) + " = " +
+              std::to_string(number(-2, 9)) + ")";
+    }
+    return text;
+  }
+
+  std::string statements(std::vector<std::string> controls, int depth) {
+    std::string text;
+    const int count = number(1, 3);
+    for (int n = 0; n < count; ++n) {
+      if (n > 0) {
+        text += "; ";
+      }
+      const int kind = depth > 0 && !free_.empty() ? number(0, 6) : 0;
+      if (kind == 0 && number(0, 1) == 0) {
+        text += "IF " + membership(controls) + " THEN u := u + 1";
+      } else if (kind <= 2) {
+        const auto target = pick(std::vector<std::string>{"s", "t", "u"});
+        text += target + " := (" + target + " + " +
+                expression(controls, number(0, 3)) + ") DIV 2";
+      } else if (kind == 3) {
+        text += pick(std::vector<std::string>{"a := a - 1", "Bump(b)",
+                                              "c := c + s DIV 4"});
+      } else {
+        const auto control = free_.back();
+        free_.pop_back();
+        auto inner = controls;
+        inner.push_back(control);
+        const auto body = statements(inner, depth - 1);
+        if (kind == 4) {
+          text += control + " := " + std::to_string(number(-3, 3)) +
+                  "; WHILE " + control + " < " + std::to_string(number(0, 6)) +
+                  " DO BEGIN " + body + "; WRITE(" + control + " : 3); " +
+                  control + " := " + control + " + 1 END";
+        } else {
+          const bool down = kind == 6;
+          const auto start = expression(controls, number(0, 1)) + " DIV 4";
+          text += "FOR " + control + " := " +
+                  (down ? "6 - " + start + " DOWNTO -2"
+                        : start + " TO " + std::to_string(number(0, 6))) +
+                  " DO BEGIN " + body + " END";
+        }
+        free_.push_back(control);
+      }
+    }
+    return text;
+  }
+
+ public:
+  explicit Generator(unsigned seed) : random_(seed) {}
+
+  std::string program() {
+    return "PROGRAM Test; "
+           "VAR i, j, k, a, b, c, s, t, u : INTEGER; w : CARDINAL; "
+           "PROCEDURE Bump(VAR x : INTEGER); BEGIN x := x + 1 END; "
+           "FUNCTION Twice(x : INTEGER) : INTEGER; BEGIN Twice := x * 2 END; "
+           "BEGIN a := " +
+           std::to_string(number(-20, 20)) +
+           "; b := " + std::to_string(number(-20, 20)) +
+           "; c := " + std::to_string(number(-20, 20)) + "; " +
+           statements({}, 3) +
+           // a body changing the final value must not change the trips
+           "; FOR k := -3 TO b DIV 4 DO BEGIN b := b + 1; t := t + k END"
+           // an INT64 control variable, out of its range for a > 0
+           "; FOR w := 4294967295 + a DOWNTO 4294967290 DO u := u + w DIV 4096"
+           "; WRITELN(s, ' ', t : 5, ' ', u) END.";
+  }
+};
+
+// what the run wrote and the global variables after it, or the error it
+// stopped with
+struct Run {
+  std::string output;
+  std::vector<std::string> globals;
+
+  bool operator==(const Run&) const = default;
+};
+using Outcome = std::variant<Run, std::string>;
+
+Outcome run(std::shared_ptr<const Pascal::CompiledProgram> program) {
+  Run result;
+  Pascal::StringSink sink(&result.output);
+  Pascal::ExecutionContext context(std::move(program));
+  context.set_output(&sink);
+  try {
+    context.run();
+  } catch (const std::runtime_error& error) {
+    return error.what();
+  }
+  for (const auto name : {"i", "j", "k", "a", "b", "c", "s", "t", "u"}) {
+    result.globals.push_back(context.global(name).to_string());
+  }
+  return result;
+}
+
+int main(int argc, char* argv[]) {
+  const int programs = argc > 1 ? std::stoi(argv[1]) : 500;
+  for (int seed = 0; seed < programs; ++seed) {
+    const auto text = Generator(seed).program();
+    const auto plain =
+        Pascal::CompiledProgram::compile(text, {.optimize = false});
+    const auto optimized = Pascal::CompiledProgram::compile(text);
+    // the optimized program also runs on a second thread at the same
+    // time, which has to see the same as the first
+    Outcome concurrent;
+    std::thread thread([&] { concurrent = run(optimized); });
+    const auto expected = run(plain);
+    const auto outcome = run(optimized);
+    thread.join();
+    if (outcome != expected || concurrent != expected) {
+      std::cerr << "seed " << seed << " differs:\n" << text << "\n";
+      return 1;
+    }
+  }
+  std::cout << programs << " programs agree\n";
+  return 0;
+}
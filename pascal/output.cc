@@ -0,0 +1,68 @@
+// Copyright 2023 Zhu Junhui
+
+#include "output.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace Pascal {
+
+void FileSink::write(std::string_view text) {
+  if (std::fwrite(text.data(), 1, text.size(), file_) != text.size() ||
+      std::fflush(file_) != 0) {
+    throw std::runtime_error("cannot write output");
+  }
+}
+
+void OutputBuffer::set_sink(OutputSink* sink) {
+  flush();
+  sink_ = sink;
+}
+
+void OutputBuffer::append(std::string_view text) {
+  if (text.size() > CAPACITY - size_) {
+    flush();
+    if (text.size() > CAPACITY) {
+      sink_->write(text);
+      return;
+    }
+  }
+  if (data_ == nullptr) {
+    data_ = std::make_unique_for_overwrite<char[]>(CAPACITY);
+  }
+  std::memcpy(data_.get() + size_, text.data(), text.size());
+  size_ += text.size();
+}
+
+void OutputBuffer::append(std::string_view text, size_t width) {
+  if (width > text.size()) {
+    fill(' ', width - text.size());
+  }
+  append(text);
+}
+
+void OutputBuffer::fill(char c, size_t count) {
+  while (count > 0) {
+    if (size_ == CAPACITY) {
+      flush();
+    }
+    if (data_ == nullptr) {
+      data_ = std::make_unique_for_overwrite<char[]>(CAPACITY);
+    }
+    const size_t n = std::min(count, CAPACITY - size_);
+    std::memset(data_.get() + size_, c, n);
+    size_ += n;
+    count -= n;
+  }
+}
+
+void OutputBuffer::flush() {
+  if (size_ > 0) {
+    // the buffer is empty again even if the sink fails
+    const size_t size = size_;
+    size_ = 0;
+    sink_->write(std::string_view(data_.get(), size));
+  }
+}
+
+}  // namespace Pascal
@@ -0,0 +1,78 @@
+// Copyright 2023 Zhu Junhui
+
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace Pascal {
+
+// Where the text WRITE and WRITELN produce ends up. It is handed over in
+// large chunks, never a line at a time.
+class OutputSink {
+ public:
+  virtual ~OutputSink() = default;
+
+  virtual void write(std::string_view text) = 0;
+};
+
+// a stdio stream the caller opened, or stdout
+class FileSink : public OutputSink {
+ private:
+  std::FILE* file_;
+
+ public:
+  explicit FileSink(std::FILE* file) : file_(file) {}
+
+  void write(std::string_view text) override;
+};
+
+// appends to a string the caller owns
+class StringSink : public OutputSink {
+ private:
+  std::string* text_;
+
+ public:
+  explicit StringSink(std::string* text) : text_(text) {}
+
+  void write(std::string_view text) override { text_->append(text); }
+};
+
+// The text of a run, collected in one buffer that is reused for the whole
+// run and handed to the sink when it fills up and when the run ends. A
+// text longer than the buffer goes to the sink as it is, without a copy.
+class OutputBuffer {
+ public:
+  static constexpr size_t CAPACITY = 1 << 20;
+
+ private:
+  // allocated by the first write, so a run that writes nothing costs
+  // nothing
+  std::unique_ptr<char[]> data_;
+  size_t size_ = 0;
+
+  OutputSink* sink_;
+
+  void fill(char c, size_t count);
+
+ public:
+  explicit OutputBuffer(OutputSink* sink) : sink_(sink) {}
+
+  // whatever was written before goes to the old sink
+  void set_sink(OutputSink* sink);
+
+  void append(std::string_view text);
+
+  // text right-aligned in width characters; a longer text is not cut
+  void append(std::string_view text, size_t width);
+
+  void flush();
+
+  // drop what was written but not flushed
+  void discard() { size_ = 0; }
+};
+
+}  // namespace Pascal
@@ -1,6 +1,7 @@
 // Copyright 2023 Zhu Junhui
 
 #include "parser.h"
+#include <limits>
 #include <utility>
 
 namespace Pascal {
@@ -23,6 +24,32 @@ std::unique_ptr<Variable> Parser::variable() {
   return node;
 }
 
+std::unique_ptr<Variable> Parser::selected_variable() {
+  auto node = variable();
+  while (current_token_.type() == Token::Type::LEFT_BRACKET) {
+    eat(Token::Type::LEFT_BRACKET);
+    node->add_index(expr());
+    while (current_token_.type() == Token::Type::COMMA) {
+      eat(Token::Type::COMMA);
+      node->add_index(expr());
+    }
+    eat(Token::Type::RIGHT_BRACKET);
+  }
+  while (true) {
+    if (current_token_.type() == Token::Type::DOT) {
+      eat(Token::Type::DOT);
+      node->add_field(std::get<std::string>(current_token_.value()));
+      eat(Token::Type::ID);
+    } else if (current_token_.type() == Token::Type::CARET) {
+      eat(Token::Type::CARET);
+      node->add_dereference();
+    } else {
+      break;
+    }
+  }
+  return node;
+}
+
 std::unique_ptr<Program> Parser::parse() {
   auto result = program();
   eat(Token::Type::END_OF_FILE);
@@ -39,11 +66,100 @@ std::unique_ptr<Program> Parser::program() {
   return std::make_unique<Program>(std::move(prog_name), std::move(block_node));
 }
 
+std::unique_ptr<Block> Parser::parse_block() {
+  auto result = block();
+  eat(Token::Type::END_OF_FILE);
+  return result;
+}
+
+// Scan a block without building it: it ends with the END that closes its
+// compound statement, i.e. the END balancing the outermost BEGIN after all
+// nested procedure declarations have been closed.
+std::pair<std::string, uint64_t> Parser::skip_block() {
+  const auto start = lexer_.token_start();
+  std::vector<Token::Type> openers;
+  int open_blocks = 1;
+  uint64_t hash = 0;
+
+  while (true) {
+    hash = hash_combine(hash, current_token_.hash());
+    switch (current_token_.type()) {
+      case Token::Type::PROCEDURE:
+      case Token::Type::FUNCTION:
+        if (openers.empty()) {
+          open_blocks++;
+        }
+        break;
+      case Token::Type::BEGIN:
+      case Token::Type::CASE:
+      case Token::Type::RECORD:
+        openers.push_back(current_token_.type());
+        break;
+      case Token::Type::END: {
+        if (openers.empty()) {
+          error();
+        }
+        const auto opener = openers.back();
+        openers.pop_back();
+        if (opener == Token::Type::BEGIN && openers.empty() &&
+            --open_blocks == 0) {
+          const auto end = lexer_.token_end();
+          eat(Token::Type::END);
+          return {lexer_.source(start, end), hash};
+        }
+      } break;
+      case Token::Type::END_OF_FILE:
+        error();
+        break;
+      default:
+        break;
+    }
+    eat(current_token_.type());
+  }
+}
+
 std::unique_ptr<Block> Parser::block() {
+  // the types a block declares are seen until its end
+  const auto enclosing = types_;
   auto [declarations, procedures] = this->declarations();
   auto compound_statement = this->compound_statement();
+  auto types = types_ != enclosing ? std::move(types_) : nullptr;
+  types_ = enclosing;
   return std::make_unique<Block>(std::move(declarations), std::move(procedures),
-                                 std::move(compound_statement));
+                                 std::move(compound_statement),
+                                 std::move(types));
+}
+
+void Parser::type_section() {
+  eat(Token::Type::TYPE);
+  auto scope = std::make_shared<TypeScope>();
+  scope->enclosing = types_;
+  types_ = scope;
+  // a pointer type may name a type declared further down the section, so
+  // all of them are looked up at its end
+  in_type_section_ = true;
+  do {
+    const auto name = std::get<std::string>(current_token_.value());
+    eat(Token::Type::ID);
+    eat(Token::Type::EQUAL);
+    std::shared_ptr<const Type> declared = type();
+    if (!scope->types.emplace(name, std::move(declared)).second) {
+      throw std::runtime_error("type " + name + " has been declared!");
+    }
+    eat(Token::Type::SEMI);
+  } while (current_token_.type() == Token::Type::ID);
+  in_type_section_ = false;
+
+  for (const auto& pointer : forward_) {
+    const auto target = scope->lookup(pointer->name());
+    if (target == nullptr) {
+      throw std::runtime_error("type " + pointer->name() +
+                               " has not been declared!");
+    }
+    check_target(*target);
+    pointer->resolve(target);
+  }
+  forward_.clear();
 }
 
 std::pair<std::vector<std::unique_ptr<VariableDeclaration>>,
@@ -52,6 +168,9 @@ std::pair<std::vector<std::unique_ptr<VariableDeclaration>>,
 Parser::declarations() {
   std::vector<std::unique_ptr<VariableDeclaration>> declarations;
   std::vector<std::unique_ptr<ProcedureDeclaration>> procedures;
+  if (current_token_.type() == Token::Type::TYPE) {
+    type_section();
+  }
   if (current_token_.type() == Token::Type::VAR) {
     eat(Token::Type::VAR);
 
@@ -64,19 +183,76 @@ Parser::declarations() {
     }
   }
 
-  while (current_token_.type() == Token::Type::PROCEDURE) {
-    eat(Token::Type::PROCEDURE);
+  while (current_token_.type() == Token::Type::PROCEDURE ||
+         current_token_.type() == Token::Type::FUNCTION) {
+    const bool is_function = current_token_.type() == Token::Type::FUNCTION;
+    eat(current_token_.type());
     auto proc_name = variable();
+    std::vector<std::unique_ptr<Parameter>> parameters;
+    if (current_token_.type() == Token::Type::LEFT_PAREN) {
+      eat(Token::Type::LEFT_PAREN);
+      parameters = formal_parameter_list();
+      eat(Token::Type::RIGHT_PAREN);
+    }
+    std::unique_ptr<Type> return_type;
+    if (is_function) {
+      eat(Token::Type::COLON);
+      return_type = type();
+    }
     eat(Token::Type::SEMI);
-    auto block_node = block();
-    auto proc_decl = std::make_unique<ProcedureDeclaration>(
-        std::move(proc_name->value()), std::move(block_node));
-    procedures.push_back(std::move(proc_decl));
+    if (lazy_procedures_) {
+      auto [body_source, body_hash] = skip_block();
+      procedures.push_back(std::make_unique<ProcedureDeclaration>(
+          proc_name->value(), std::move(parameters), std::move(return_type),
+          std::move(body_source), body_hash, types_));
+    } else {
+      auto block_node = block();
+      procedures.push_back(std::make_unique<ProcedureDeclaration>(
+          proc_name->value(), std::move(parameters), std::move(return_type),
+          std::move(block_node)));
+    }
     eat(Token::Type::SEMI);
   }
   return {std::move(declarations), std::move(procedures)};
 }
 
+std::vector<std::unique_ptr<Parameter>> Parser::formal_parameter_list() {
+  auto parameters = formal_parameters();
+  while (current_token_.type() == Token::Type::SEMI) {
+    eat(Token::Type::SEMI);
+    for (auto& parameter : formal_parameters()) {
+      parameters.push_back(std::move(parameter));
+    }
+  }
+  return parameters;
+}
+
+std::vector<std::unique_ptr<Parameter>> Parser::formal_parameters() {
+  bool by_reference = false;
+  if (current_token_.type() == Token::Type::VAR) {
+    eat(Token::Type::VAR);
+    by_reference = true;
+  }
+
+  std::vector<std::unique_ptr<Variable>> names;
+  names.push_back(variable());
+  while (current_token_.type() == Token::Type::COMMA) {
+    eat(Token::Type::COMMA);
+    names.push_back(variable());
+  }
+  eat(Token::Type::COLON);
+  const auto parameter_type = type();
+
+  // the parameters of one group share an array shape
+  std::vector<std::unique_ptr<Parameter>> parameters;
+  for (auto& name : names) {
+    parameters.push_back(std::make_unique<Parameter>(
+        std::move(name), std::make_unique<Type>(*parameter_type),
+        by_reference));
+  }
+  return parameters;
+}
+
 std::unique_ptr<VariableDeclaration> Parser::variable_declaration() {
   auto var_nodes = std::vector<std::unique_ptr<Variable>>();
 
@@ -99,16 +275,218 @@ std::unique_ptr<VariableDeclaration> Parser::variable_declaration() {
                                                std::move(type_node));
 }
 
+void Parser::check_target(const Type& target) {
+  if (target.value() == ValueAST::ValueType::ARRAY ||
+      target.value() == ValueAST::ValueType::SET ||
+      target.value() == ValueAST::ValueType::STRING ||
+      target.value() == ValueAST::ValueType::FILE) {
+    throw std::runtime_error(
+        "a pointer cannot point to an array, a set, a string or a file!");
+  }
+}
+
 std::unique_ptr<Type> Parser::type() {
+  if (current_token_.type() == Token::Type::CARET) {
+    eat(Token::Type::CARET);
+    if (current_token_.type() != Token::Type::ID) {
+      const std::shared_ptr<const Type> target = type();
+      check_target(*target);
+      return std::make_unique<Type>(
+          std::make_shared<const PointerType>(target));
+    }
+    const auto name = std::get<std::string>(current_token_.value());
+    eat(Token::Type::ID);
+    auto pointer = std::make_shared<PointerType>(name);
+    if (in_type_section_) {
+      forward_.push_back(pointer);
+    } else {
+      const auto target = types_ != nullptr ? types_->lookup(name) : nullptr;
+      if (target == nullptr) {
+        throw std::runtime_error("type " + name + " has not been declared!");
+      }
+      check_target(*target);
+      pointer->resolve(target);
+    }
+    return std::make_unique<Type>(std::move(pointer));
+  }
+
+  if (current_token_.type() == Token::Type::ID) {
+    const auto name = std::get<std::string>(current_token_.value());
+    eat(Token::Type::ID);
+    const auto declared = types_ != nullptr ? types_->lookup(name) : nullptr;
+    if (declared == nullptr) {
+      throw std::runtime_error("type " + name + " has not been declared!");
+    }
+    return std::make_unique<Type>(*declared);
+  }
+
+  bool packed = false;
+  if (current_token_.type() == Token::Type::PACKED) {
+    eat(Token::Type::PACKED);
+    packed = true;
+    if (current_token_.type() == Token::Type::RECORD) {
+      return record_type(packed);
+    }
+    if (current_token_.type() != Token::Type::ARRAY) {
+      error();
+    }
+  }
+
+  if (current_token_.type() == Token::Type::RECORD) {
+    return record_type(packed);
+  }
+
+  if (current_token_.type() == Token::Type::ARRAY) {
+    // an array of arrays is one array with more dimensions, packed if any
+    // of them is
+    std::vector<std::pair<int, int>> bounds;
+    while (current_token_.type() == Token::Type::ARRAY) {
+      eat(Token::Type::ARRAY);
+      eat(Token::Type::LEFT_BRACKET);
+      while (true) {
+        bounds.push_back(this->bounds());
+        if (current_token_.type() != Token::Type::COMMA) {
+          break;
+        }
+        eat(Token::Type::COMMA);
+      }
+      eat(Token::Type::RIGHT_BRACKET);
+      eat(Token::Type::OF);
+    }
+    const auto element = type();
+    if (element->value() == ValueAST::ValueType::ARRAY) {
+      const auto& inner = *element->array();
+      for (const auto& dimension : inner.dimensions) {
+        bounds.emplace_back(dimension.low, dimension.high);
+      }
+      return std::make_unique<Type>(std::make_shared<const ArrayType>(
+          bounds, inner.element, inner.range, inner.record,
+          packed || inner.packed, inner.pointer));
+    }
+    if (element->value() == ValueAST::ValueType::SET ||
+        element->value() == ValueAST::ValueType::STRING ||
+        element->value() == ValueAST::ValueType::FILE) {
+      error();
+    }
+    return std::make_unique<Type>(std::make_shared<const ArrayType>(
+        bounds, element->value(), element->range(), element->record(),
+        packed || element->packed(), element->pointer()));
+  }
+
+  // only values whose bytes are all they are can be read from a file as
+  // they are
+  if (current_token_.type() == Token::Type::FILE) {
+    eat(Token::Type::FILE);
+    eat(Token::Type::OF);
+    const auto element = type();
+    const auto& record = element->record();
+    const bool valid =
+        record != nullptr
+            ? record->plain()
+            : plain(element->value(), element->range(), element->packed());
+    if (!valid) {
+      throw std::runtime_error(
+          "a file can only hold INTEGER, INT64 and REAL values and records "
+          "of them!");
+    }
+    return std::make_unique<Type>(std::make_shared<const FileType>(
+        FileType{element->value(), element->record()}));
+  }
+
+  if (current_token_.type() == Token::Type::SET) {
+    eat(Token::Type::SET);
+    eat(Token::Type::OF);
+    const auto [low, high] = bounds();
+    if (low < 0 || high > Set::MAX_MEMBER || low > high) {
+      throw std::runtime_error("set of " + std::to_string(low) + ".." +
+                               std::to_string(high) + " is not within 0.." +
+                               std::to_string(Set::MAX_MEMBER));
+    }
+    return std::make_unique<Type>(Interval{low, high},
+                                  ValueAST::ValueType::SET);
+  }
+
+  if (current_token_.type() == Token::Type::INTEGER_CONST ||
+      current_token_.type() == Token::Type::PLUS ||
+      current_token_.type() == Token::Type::MINUS) {
+    const auto [low, high] = bounds();
+    if (low > high) {
+      throw std::runtime_error("subrange " + std::to_string(low) + ".." +
+                               std::to_string(high) + " is empty");
+    }
+    return std::make_unique<Type>(Interval{low, high});
+  }
+
+  // the sized integers are subranges stored in as few bytes as they need
+  switch (current_token_.type()) {
+    case Token::Type::BYTE_TYPE:
+      eat(Token::Type::BYTE_TYPE);
+      return std::make_unique<Type>(Interval{0, UINT8_MAX},
+                                    ValueAST::ValueType::INTEGER, true);
+    case Token::Type::WORD_TYPE:
+      eat(Token::Type::WORD_TYPE);
+      return std::make_unique<Type>(Interval{0, UINT16_MAX},
+                                    ValueAST::ValueType::INTEGER, true);
+    case Token::Type::CARDINAL_TYPE:
+      eat(Token::Type::CARDINAL_TYPE);
+      return std::make_unique<Type>(Interval{0, UINT32_MAX},
+                                    ValueAST::ValueType::INT64, true);
+    default:
+      break;
+  }
+
   auto token = current_token_;
   if (token.type() == Token::Type::INTEGER_TYPE) {
     eat(Token::Type::INTEGER_TYPE);
+  } else if (token.type() == Token::Type::BOOLEAN_TYPE) {
+    eat(Token::Type::BOOLEAN_TYPE);
+  } else if (token.type() == Token::Type::INT64_TYPE) {
+    eat(Token::Type::INT64_TYPE);
+  } else if (token.type() == Token::Type::STRING_TYPE) {
+    eat(Token::Type::STRING_TYPE);
   } else {
     eat(Token::Type::REAL_TYPE);
   }
   return std::make_unique<Type>(token);
 }
 
+std::unique_ptr<Type> Parser::record_type(bool packed) {
+  eat(Token::Type::RECORD);
+  std::vector<RecordType::Field> fields;
+  do {
+    std::vector<std::string> names;
+    names.push_back(std::get<std::string>(current_token_.value()));
+    eat(Token::Type::ID);
+    while (current_token_.type() == Token::Type::COMMA) {
+      eat(Token::Type::COMMA);
+      names.push_back(std::get<std::string>(current_token_.value()));
+      eat(Token::Type::ID);
+    }
+    eat(Token::Type::COLON);
+    const auto field_type = type();
+    if (field_type->value() == ValueAST::ValueType::ARRAY ||
+        field_type->value() == ValueAST::ValueType::SET ||
+        field_type->value() == ValueAST::ValueType::STRING ||
+        field_type->value() == ValueAST::ValueType::FILE) {
+      throw std::runtime_error(
+          "field " + names.front() +
+          " cannot be an array, a set, a string or a file!");
+    }
+    for (auto& name : names) {
+      fields.push_back(RecordType::Field{
+          std::move(name), field_type->value(), field_type->range(),
+          field_type->record(), field_type->pointer(), field_type->packed()});
+    }
+    if (current_token_.type() != Token::Type::SEMI) {
+      break;
+    }
+    eat(Token::Type::SEMI);
+  } while (current_token_.type() == Token::Type::ID);
+  eat(Token::Type::END);
+  return std::make_unique<Type>(
+      std::make_shared<const RecordType>(std::move(fields), packed));
+}
+
 std::unique_ptr<Compound> Parser::compound_statement() {
   eat(Token::Type::BEGIN);
   auto nodes = statement_list();
@@ -141,8 +519,45 @@ std::unique_ptr<NonValueAST> Parser::statement() {
     case Token::Type::BEGIN:
       return compound_statement();
       break;
-    case Token::Type::ID:
-      return assignment_statement();
+    case Token::Type::ID: {
+      auto variable = selected_variable();
+      if (current_token_.type() == Token::Type::ASSIGN) {
+        return assignment_statement(std::move(variable));
+      }
+      if (!variable->whole()) {
+        error();
+      }
+      return proccall_statement(std::move(variable));
+    } break;
+    case Token::Type::IF:
+      return if_statement();
+      break;
+    case Token::Type::WHILE:
+      return while_statement();
+      break;
+    case Token::Type::REPEAT:
+      return repeat_statement();
+      break;
+    case Token::Type::FOR:
+      return for_statement();
+      break;
+    case Token::Type::CASE:
+      return case_statement();
+      break;
+    case Token::Type::NEW:
+    case Token::Type::DISPOSE:
+      return heap_statement();
+      break;
+    case Token::Type::WRITE:
+    case Token::Type::WRITELN:
+      return write_statement();
+      break;
+    case Token::Type::READ:
+    case Token::Type::READLN:
+      return read_statement();
+      break;
+    case Token::Type::RESET:
+      return reset_statement();
       break;
     default:
       return empty();
@@ -150,13 +565,248 @@ std::unique_ptr<NonValueAST> Parser::statement() {
   }
 }
 
-std::unique_ptr<Assign> Parser::assignment_statement() {
+std::unique_ptr<NonValueAST> Parser::nested_statement() {
+  auto node = statement();
+  if (!node) {
+    return std::make_unique<Compound>();
+  }
+  return node;
+}
+
+std::unique_ptr<If> Parser::if_statement() {
+  eat(Token::Type::IF);
+  auto condition = expr();
+  eat(Token::Type::THEN);
+  auto then_statement = nested_statement();
+  std::unique_ptr<NonValueAST> else_statement;
+  if (current_token_.type() == Token::Type::ELSE) {
+    eat(Token::Type::ELSE);
+    else_statement = nested_statement();
+  }
+  return std::make_unique<If>(std::move(condition), std::move(then_statement),
+                              std::move(else_statement));
+}
+
+std::unique_ptr<While> Parser::while_statement() {
+  eat(Token::Type::WHILE);
+  auto condition = expr();
+  eat(Token::Type::DO);
+  return std::make_unique<While>(std::move(condition), nested_statement());
+}
+
+std::unique_ptr<Repeat> Parser::repeat_statement() {
+  eat(Token::Type::REPEAT);
+  auto body = std::make_unique<Compound>();
+  for (auto& node : statement_list()) {
+    body->add_child(std::move(node));
+  }
+  eat(Token::Type::UNTIL);
+  return std::make_unique<Repeat>(std::move(body), expr());
+}
+
+std::unique_ptr<For> Parser::for_statement() {
+  eat(Token::Type::FOR);
   auto variable = this->variable();
   eat(Token::Type::ASSIGN);
+  auto start = expr();
+  const bool down = current_token_.type() == Token::Type::DOWNTO;
+  eat(down ? Token::Type::DOWNTO : Token::Type::TO);
+  auto end = expr();
+  eat(Token::Type::DO);
+  return std::make_unique<For>(std::move(variable), std::move(start),
+                               std::move(end), down, nested_statement());
+}
+
+std::unique_ptr<Case> Parser::case_statement() {
+  eat(Token::Type::CASE);
+  auto selector = expr();
+  eat(Token::Type::OF);
+
+  std::vector<Case::Branch> branches;
+  while (current_token_.type() != Token::Type::ELSE &&
+         current_token_.type() != Token::Type::END) {
+    Case::Branch branch;
+    branch.labels.push_back(case_label());
+    while (current_token_.type() == Token::Type::COMMA) {
+      eat(Token::Type::COMMA);
+      branch.labels.push_back(case_label());
+    }
+    eat(Token::Type::COLON);
+    branch.statement = nested_statement();
+    branches.push_back(std::move(branch));
+
+    if (current_token_.type() != Token::Type::SEMI) {
+      break;
+    }
+    eat(Token::Type::SEMI);
+  }
+  if (branches.empty()) {
+    error();
+  }
+
+  std::unique_ptr<Compound> else_statement;
+  if (current_token_.type() == Token::Type::ELSE) {
+    eat(Token::Type::ELSE);
+    else_statement = std::make_unique<Compound>();
+    for (auto& node : statement_list()) {
+      else_statement->add_child(std::move(node));
+    }
+  }
+  eat(Token::Type::END);
+  return std::make_unique<Case>(std::move(selector), std::move(branches),
+                                std::move(else_statement));
+}
+
+Case::Label Parser::case_label() {
+  const auto [low, type] = constant();
+  if (current_token_.type() != Token::Type::DOTDOT) {
+    return Case::Label{low, low, type};
+  }
+  eat(Token::Type::DOTDOT);
+  const auto [high, high_type] = constant();
+  const auto boolean = ValueAST::ValueType::BOOLEAN;
+  if ((high_type == boolean) != (type == boolean)) {
+    error();
+  }
+  // a range with an INT64 end is an INT64 range
+  const auto int64 = ValueAST::ValueType::INT64;
+  return Case::Label{low, high, high_type == int64 ? int64 : type};
+}
+
+std::pair<int, int> Parser::bounds() {
+  const auto [low, low_type] = constant();
+  eat(Token::Type::DOTDOT);
+  const auto [high, high_type] = constant();
+  if (low_type != ValueAST::ValueType::INTEGER ||
+      high_type != ValueAST::ValueType::INTEGER) {
+    error();
+  }
+  return {static_cast<int>(low), static_cast<int>(high)};
+}
+
+std::pair<int64_t, ValueAST::ValueType> Parser::constant() {
+  if (current_token_.type() == Token::Type::BOOLEAN_CONST) {
+    const int value = std::get<int>(current_token_.value());
+    eat(Token::Type::BOOLEAN_CONST);
+    return {value, ValueAST::ValueType::BOOLEAN};
+  }
+
+  const bool negative = current_token_.type() == Token::Type::MINUS;
+  if (negative || current_token_.type() == Token::Type::PLUS) {
+    eat(current_token_.type());
+  }
+  if (current_token_.type() != Token::Type::INTEGER_CONST) {
+    error();
+  }
+  int64_t value = std::holds_alternative<int>(current_token_.value())
+                      ? std::get<int>(current_token_.value())
+                      : std::get<int64_t>(current_token_.value());
+  eat(Token::Type::INTEGER_CONST);
+  value = negative ? -value : value;
+  // a constant is an INTEGER wherever it fits one
+  const bool fits = value >= std::numeric_limits<int>::min() &&
+                    value <= std::numeric_limits<int>::max();
+  return {value, fits ? ValueAST::ValueType::INTEGER
+                      : ValueAST::ValueType::INT64};
+}
+
+std::unique_ptr<Assign> Parser::assignment_statement(
+    std::unique_ptr<Variable> variable) {
+  eat(Token::Type::ASSIGN);
   auto expr = this->expr();
   return std::make_unique<Assign>(std::move(variable), std::move(expr));
 }
 
+std::unique_ptr<ProcedureCall> Parser::proccall_statement(
+    std::unique_ptr<Variable> name) {
+  std::vector<std::unique_ptr<ValueAST>> arguments;
+  if (current_token_.type() == Token::Type::LEFT_PAREN) {
+    arguments = actual_parameters();
+  }
+  return std::make_unique<ProcedureCall>(name->value(), std::move(arguments));
+}
+
+std::unique_ptr<HeapOperation> Parser::heap_statement() {
+  const auto op = current_token_.type() == Token::Type::NEW
+                      ? HeapOperation::Operator::NEW
+                      : HeapOperation::Operator::DISPOSE;
+  eat(current_token_.type());
+  eat(Token::Type::LEFT_PAREN);
+  auto variable = selected_variable();
+  eat(Token::Type::RIGHT_PAREN);
+  return std::make_unique<HeapOperation>(op, std::move(variable));
+}
+
+std::unique_ptr<Write> Parser::write_statement() {
+  const bool line = current_token_.type() == Token::Type::WRITELN;
+  eat(current_token_.type());
+  std::vector<Write::Argument> arguments;
+  if (current_token_.type() == Token::Type::LEFT_PAREN) {
+    eat(Token::Type::LEFT_PAREN);
+    arguments.push_back(write_argument());
+    while (current_token_.type() == Token::Type::COMMA) {
+      eat(Token::Type::COMMA);
+      arguments.push_back(write_argument());
+    }
+    eat(Token::Type::RIGHT_PAREN);
+  }
+  return std::make_unique<Write>(std::move(arguments), line);
+}
+
+Write::Argument Parser::write_argument() {
+  Write::Argument argument;
+  argument.value = expr();
+  if (current_token_.type() == Token::Type::COLON) {
+    eat(Token::Type::COLON);
+    argument.width = expr();
+    if (current_token_.type() == Token::Type::COLON) {
+      eat(Token::Type::COLON);
+      argument.precision = expr();
+    }
+  }
+  return argument;
+}
+
+std::unique_ptr<Read> Parser::read_statement() {
+  const bool line = current_token_.type() == Token::Type::READLN;
+  eat(current_token_.type());
+  std::vector<std::unique_ptr<Variable>> variables;
+  if (current_token_.type() == Token::Type::LEFT_PAREN) {
+    eat(Token::Type::LEFT_PAREN);
+    variables.push_back(selected_variable());
+    while (current_token_.type() == Token::Type::COMMA) {
+      eat(Token::Type::COMMA);
+      variables.push_back(selected_variable());
+    }
+    eat(Token::Type::RIGHT_PAREN);
+  }
+  return std::make_unique<Read>(std::move(variables), line);
+}
+
+std::unique_ptr<Reset> Parser::reset_statement() {
+  eat(Token::Type::RESET);
+  eat(Token::Type::LEFT_PAREN);
+  auto variable = selected_variable();
+  eat(Token::Type::COMMA);
+  auto path = expr();
+  eat(Token::Type::RIGHT_PAREN);
+  return std::make_unique<Reset>(std::move(variable), std::move(path));
+}
+
+std::vector<std::unique_ptr<ValueAST>> Parser::actual_parameters() {
+  std::vector<std::unique_ptr<ValueAST>> arguments;
+  eat(Token::Type::LEFT_PAREN);
+  if (current_token_.type() != Token::Type::RIGHT_PAREN) {
+    arguments.push_back(expr());
+    while (current_token_.type() == Token::Type::COMMA) {
+      eat(Token::Type::COMMA);
+      arguments.push_back(expr());
+    }
+  }
+  eat(Token::Type::RIGHT_PAREN);
+  return arguments;
+}
+
 std::nullptr_t Parser::empty() {
   return nullptr;
 }
@@ -167,12 +817,16 @@ std::unique_ptr<ValueAST> Parser::factor() {
   switch (type) {
     case Token::Type::PLUS:
     case Token::Type::MINUS:
+    case Token::Type::NOT:
       eat(type);
       return std::make_unique<UnaryOperation>(factor(), token);
       break;
 
     case Token::Type::INTEGER_CONST:
     case Token::Type::REAL_CONST:
+    case Token::Type::BOOLEAN_CONST:
+    case Token::Type::STRING_CONST:
+    case Token::Type::NIL:
       eat(type);
       return std::make_unique<Number>(token);
       break;
@@ -184,9 +838,37 @@ std::unique_ptr<ValueAST> Parser::factor() {
       return result;
     } break;
 
-    case Token::Type::ID:
-      return variable();
+    case Token::Type::LEFT_BRACKET:
+      return set_constructor();
       break;
+
+    case Token::Type::CARD: {
+      eat(Token::Type::CARD);
+      eat(Token::Type::LEFT_PAREN);
+      auto result = std::make_unique<UnaryOperation>(expr(), token);
+      eat(Token::Type::RIGHT_PAREN);
+      return result;
+    } break;
+
+    case Token::Type::EOF_FUNCTION: {
+      eat(Token::Type::EOF_FUNCTION);
+      eat(Token::Type::LEFT_PAREN);
+      auto result =
+          std::make_unique<UnaryOperation>(selected_variable(), token);
+      eat(Token::Type::RIGHT_PAREN);
+      return result;
+    } break;
+
+    case Token::Type::ID: {
+      // a function without parameters looks like a variable here, the
+      // semantic analyzer tells them apart
+      auto variable = selected_variable();
+      if (current_token_.type() == Token::Type::LEFT_PAREN) {
+        return std::make_unique<FunctionCall>(variable->value(),
+                                              actual_parameters());
+      }
+      return variable;
+    } break;
     default:
       break;
   }
@@ -195,17 +877,54 @@ std::unique_ptr<ValueAST> Parser::factor() {
   return nullptr;
 }
 
+std::unique_ptr<SetConstructor> Parser::set_constructor() {
+  eat(Token::Type::LEFT_BRACKET);
+  std::vector<SetConstructor::Element> elements;
+  while (current_token_.type() != Token::Type::RIGHT_BRACKET) {
+    if (!elements.empty()) {
+      eat(Token::Type::COMMA);
+    }
+    SetConstructor::Element element{expr(), nullptr};
+    if (current_token_.type() == Token::Type::DOTDOT) {
+      eat(Token::Type::DOTDOT);
+      element.high = expr();
+    }
+    elements.push_back(std::move(element));
+  }
+  eat(Token::Type::RIGHT_BRACKET);
+  return std::make_unique<SetConstructor>(std::move(elements));
+}
+
 std::unique_ptr<ValueAST> Parser::expr() {
+  auto node = simple_expr();
+
+  switch (current_token_.type()) {
+    case Token::Type::EQUAL:
+    case Token::Type::NOT_EQUAL:
+    case Token::Type::LESS:
+    case Token::Type::LESS_EQUAL:
+    case Token::Type::GREATER:
+    case Token::Type::GREATER_EQUAL:
+    case Token::Type::IN: {
+      auto token = current_token_;
+      eat(token.type());
+      return std::make_unique<BinaryOperation>(std::move(node), simple_expr(),
+                                               token);
+    } break;
+    default:
+      return node;
+      break;
+  }
+}
+
+std::unique_ptr<ValueAST> Parser::simple_expr() {
   auto node = term();
 
   while (current_token_.type() == Token::Type::PLUS ||
-         current_token_.type() == Token::Type::MINUS) {
+         current_token_.type() == Token::Type::MINUS ||
+         current_token_.type() == Token::Type::OR) {
     auto token = current_token_;
-    if (token.type() == Token::Type::PLUS) {
-      eat(Token::Type::PLUS);
-    } else if (token.type() == Token::Type::MINUS) {
-      eat(Token::Type::MINUS);
-    }
+    eat(token.type());
     node = std::make_unique<BinaryOperation>(std::move(node), term(), token);
   }
 
@@ -217,15 +936,10 @@ std::unique_ptr<ValueAST> Parser::term() {
 
   while (current_token_.type() == Token::Type::MULTIPLY ||
          current_token_.type() == Token::Type::INTEGER_DIV ||
-         current_token_.type() == Token::Type::REAL_DIV) {
+         current_token_.type() == Token::Type::REAL_DIV ||
+         current_token_.type() == Token::Type::AND) {
     auto token = current_token_;
-    if (token.type() == Token::Type::MULTIPLY) {
-      eat(Token::Type::MULTIPLY);
-    } else if (token.type() == Token::Type::INTEGER_DIV) {
-      eat(Token::Type::INTEGER_DIV);
-    } else if (token.type() == Token::Type::REAL_DIV) {
-      eat(Token::Type::REAL_DIV);
-    }
+    eat(token.type());
     node = std::make_unique<BinaryOperation>(std::move(node), factor(), token);
   }
 
@@ -16,26 +16,72 @@ class Parser {
  private:
   Lexer lexer_;
   Token current_token_;
+  bool lazy_procedures_ = false;
+
+  // the types visible where the parser is
+  std::shared_ptr<const TypeScope> types_;
+
+  // the pointer types of the TYPE section being parsed, whose targets are
+  // looked up at its end
+  std::vector<std::shared_ptr<PointerType>> forward_;
+  bool in_type_section_ = false;
 
  public:
+  // a pre-parsed body is parsed with the types visible where it is declared
   template <typename T>
-  requires std::convertible_to<T, std::string> explicit Parser(T&& text)
+  requires std::convertible_to<T, std::string> explicit Parser(
+      T&& text, std::shared_ptr<const TypeScope> types = nullptr)
       : lexer_(std::forward<T>(text)),
-        current_token_(lexer_.get_next_token()) {}
+        current_token_(lexer_.get_next_token()),
+        types_(std::move(types)) {}
 
   std::unique_ptr<Program> parse();
 
+  // parse source holding exactly one block, e.g. a pre-parsed body
+  std::unique_ptr<Block> parse_block();
+
+  // pre-parse mode: procedure bodies are only scanned for their extent
+  // and kept as source, to be parsed when first needed
+  void set_lazy_procedures(bool lazy) { lazy_procedures_ = lazy; }
+
   /*
 program: compound_statement DOT
 compound_statement: BEGIN statement_list END
 statement_list: statement | statement SEMI statement_list
-statement: compound_statement | assignment_statement | empty
+statement: compound_statement | proccall_statement | assignment_statement
+         | if_statement | while_statement | repeat_statement | for_statement
+         | case_statement | heap_statement | write_statement
+         | read_statement | reset_statement | empty
+heap_statement: (NEW | DISPOSE) LPAREN variable RPAREN
+write_statement: (WRITE | WRITELN)
+                 (LPAREN write_argument (COMMA write_argument)* RPAREN)?
+write_argument: expr (COLON expr (COLON expr)?)?
+read_statement: (READ | READLN) (LPAREN variable (COMMA variable)* RPAREN)?
+reset_statement: RESET LPAREN variable COMMA expr RPAREN
 assignment_statement: variable ASSIGN expr
-variable: ID
+if_statement: IF expr THEN statement (ELSE statement)?
+while_statement: WHILE expr DO statement
+repeat_statement: REPEAT statement_list UNTIL expr
+for_statement: FOR variable ASSIGN expr (TO | DOWNTO) expr DO statement
+case_statement: CASE expr OF case_branch (SEMI case_branch)* SEMI?
+                (ELSE statement_list)? END
+case_branch: case_label (COMMA case_label)* COLON statement
+case_label: constant (DOTDOT constant)?
+constant: (PLUS | MINUS)? INTEGER | BOOLEAN
+proccall_statement: ID actual_parameters?
+actual_parameters: LPAREN (expr (COMMA expr)*)? RPAREN
+variable: ID (LBRACKET expr (COMMA expr)* RBRACKET)* (DOT ID)*
+          (CARET (DOT ID)*)*
 empty:
-expr: term ((PLUS | MINUS) term)*
-term: factor ((MUL | DIV) factor)*
-factor: PLUS factor | MINUS factor | INTEGER | LPAREN expr RPAREN | variable
+expr: simple_expr ((EQ | NE | LT | LE | GT | GE | IN) simple_expr)?
+simple_expr: term ((PLUS | MINUS | OR) term)*
+term: factor ((MUL | DIV | AND) factor)*
+factor: PLUS factor | MINUS factor | NOT factor | INTEGER | BOOLEAN
+      | NIL | LPAREN expr RPAREN | variable
+      | ID actual_parameters | set_constructor
+      | CARD LPAREN expr RPAREN | EOF LPAREN variable RPAREN
+set_constructor: LBRACKET (set_element (COMMA set_element)*)? RBRACKET
+set_element: expr (DOTDOT expr)?
 */
  private:
   void error();
@@ -46,31 +92,96 @@ factor: PLUS factor | MINUS factor | INTEGER | LPAREN expr RPAREN | variable
 
   std::unique_ptr<Block> block();
 
+  // returns the source of the block and a hash of its tokens
+  std::pair<std::string, uint64_t> skip_block();
+
+  // declarations: type_section? (VAR (variable_declaration SEMI)+)?
+  //               procedure_declaration*
   std::pair<std::vector<std::unique_ptr<VariableDeclaration>>,
             std::vector<std::unique_ptr<ProcedureDeclaration>>>
   declarations();
 
+  // type_section: TYPE (ID EQUAL type SEMI)+
+  void type_section();
+
+  std::vector<std::unique_ptr<Parameter>> formal_parameter_list();
+
+  std::vector<std::unique_ptr<Parameter>> formal_parameters();
+
   std::unique_ptr<VariableDeclaration> variable_declaration();
 
+  // type: INTEGER | REAL | BOOLEAN | BYTE | WORD | CARDINAL | INT64 | STRING
+  //     | bounds | SET OF bounds
+  //     | PACKED? ARRAY LBRACKET bounds (COMMA bounds)* RBRACKET OF type
+  //     | PACKED? record_type | CARET type | FILE OF type | ID
   std::unique_ptr<Type> type();
 
+  // a pointer may not point to an array, a set or a string
+  static void check_target(const Type& target);
+
+  // record_type: RECORD field_list (SEMI field_list)* SEMI? END
+  // field_list: ID (COMMA ID)* COLON type
+  std::unique_ptr<Type> record_type(bool packed);
+
+  // bounds: constant DOTDOT constant, both integers
+  std::pair<int, int> bounds();
+
   std::unique_ptr<Compound> compound_statement();
 
   std::vector<std::unique_ptr<NonValueAST>> statement_list();
 
   std::unique_ptr<NonValueAST> statement();
 
-  std::unique_ptr<Assign> assignment_statement();
+  std::unique_ptr<Assign> assignment_statement(std::unique_ptr<Variable>);
+
+  std::unique_ptr<ProcedureCall> proccall_statement(std::unique_ptr<Variable>);
+
+  std::unique_ptr<HeapOperation> heap_statement();
+
+  std::unique_ptr<Write> write_statement();
+
+  Write::Argument write_argument();
+
+  std::unique_ptr<Read> read_statement();
+
+  std::unique_ptr<Reset> reset_statement();
+
+  std::vector<std::unique_ptr<ValueAST>> actual_parameters();
+
+  // the statement governed by IF, WHILE or FOR; never nullptr
+  std::unique_ptr<NonValueAST> nested_statement();
+
+  std::unique_ptr<If> if_statement();
+
+  std::unique_ptr<While> while_statement();
+
+  std::unique_ptr<Repeat> repeat_statement();
+
+  std::unique_ptr<For> for_statement();
+
+  std::unique_ptr<Case> case_statement();
+
+  Case::Label case_label();
+
+  // value and type of a label constant
+  std::pair<int64_t, ValueAST::ValueType> constant();
 
   std::nullptr_t empty();
 
   std::unique_ptr<ValueAST> expr();
 
+  std::unique_ptr<ValueAST> simple_expr();
+
   std::unique_ptr<ValueAST> term();
 
   std::unique_ptr<ValueAST> factor();
 
+  std::unique_ptr<SetConstructor> set_constructor();
+
   std::unique_ptr<Variable> variable();
+
+  // a variable that may select an array element or a record field
+  std::unique_ptr<Variable> selected_variable();
 };
 
 }  // namespace Pascal
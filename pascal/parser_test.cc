@@ -56,6 +56,18 @@ class ReadVisitor : public Pascal::Visitor {
       pre_print_depth() << "value: " << std::get<double>(number->value())
                         << '\n';
       return 0;
+    } else if (std::holds_alternative<int64_t>(number->value())) {
+      pre_print_depth() << "value: " << std::get<int64_t>(number->value())
+                        << '\n';
+      return 0;
+    } else if (std::holds_alternative<Pascal::String>(number->value())) {
+      pre_print_depth() << "value: "
+                        << std::get<Pascal::String>(number->value()).to_string()
+                        << '\n';
+      return 0;
+    } else if (std::holds_alternative<void*>(number->value())) {
+      pre_print_depth() << "value: NIL\n";
+      return 0;
     } else {
       pre_print_depth() << "value: " << std::get<int>(number->value()) << '\n';
       return 0;
@@ -88,6 +100,23 @@ class ReadVisitor : public Pascal::Visitor {
   Value visit(const Pascal::Variable* variable) override {
     pre_print_depth() << "Variable\n";
     pre_print_depth() << "value: " << variable->value() << '\n';
+    if (!variable->indices().empty()) {
+      pre_print_depth() << "indices: \n";
+      ++depth_;
+      for (const auto& index : variable->indices()) {
+        index->accept(this);
+      }
+      --depth_;
+    }
+    for (const auto& field : variable->fields()) {
+      pre_print_depth() << "field: " << field << '\n';
+    }
+    for (const auto& dereference : variable->dereferences()) {
+      pre_print_depth() << "dereference\n";
+      for (const auto& field : dereference.fields) {
+        pre_print_depth() << "field: " << field << '\n';
+      }
+    }
     return 0;
   }
 
@@ -152,11 +181,212 @@ class ReadVisitor : public Pascal::Visitor {
   void visit(const Pascal::ProcedureDeclaration* procedure_decl) override {
     pre_print_depth() << "ProcedureDeclaration\n";
     pre_print_depth() << "name: " << procedure_decl->name() << '\n';
+    if (procedure_decl->is_function()) {
+      pre_print_depth() << "return type: \n";
+      ++depth_;
+      procedure_decl->return_type()->accept(this);
+      --depth_;
+    }
+    pre_print_depth() << "parameters: \n";
+    ++depth_;
+    for (const auto& parameter : procedure_decl->parameters()) {
+      parameter->accept(this);
+    }
+    --depth_;
     pre_print_depth() << "block: \n";
     ++depth_;
     procedure_decl->block()->accept(this);
     --depth_;
   }
+
+  void visit(const Pascal::Parameter* parameter) override {
+    pre_print_depth() << "Parameter\n";
+    pre_print_depth() << "by reference: " << parameter->by_reference() << '\n';
+    pre_print_depth() << "variable: \n";
+    ++depth_;
+    parameter->variable()->accept(this);
+    --depth_;
+    pre_print_depth() << "type: \n";
+    ++depth_;
+    parameter->type()->accept(this);
+    --depth_;
+  }
+
+  void visit(const Pascal::ProcedureCall* call) override {
+    pre_print_depth() << "ProcedureCall\n";
+    pre_print_depth() << "name: " << call->name() << '\n';
+    pre_print_depth() << "arguments: \n";
+    ++depth_;
+    for (const auto& argument : call->arguments()) {
+      argument->accept(this);
+    }
+    --depth_;
+  }
+
+  Value visit(const Pascal::FunctionCall* call) override {
+    pre_print_depth() << "FunctionCall\n";
+    pre_print_depth() << "name: " << call->name() << '\n';
+    pre_print_depth() << "arguments: \n";
+    ++depth_;
+    for (const auto& argument : call->arguments()) {
+      argument->accept(this);
+    }
+    --depth_;
+
+    return 0;
+  }
+
+  Value visit(const Pascal::SetConstructor* constructor) override {
+    pre_print_depth() << "SetConstructor\n";
+    pre_print_depth() << "elements: \n";
+    ++depth_;
+    for (const auto& element : constructor->elements()) {
+      element.low->accept(this);
+      if (element.high != nullptr) {
+        pre_print_depth() << "..\n";
+        element.high->accept(this);
+      }
+    }
+    --depth_;
+
+    return 0;
+  }
+
+  void visit(const Pascal::If* statement) override {
+    pre_print_depth() << "If\n";
+    pre_print_depth() << "condition: \n";
+    ++depth_;
+    statement->condition()->accept(this);
+    --depth_;
+    pre_print_depth() << "then: \n";
+    ++depth_;
+    statement->then_statement()->accept(this);
+    --depth_;
+    if (statement->else_statement() != nullptr) {
+      pre_print_depth() << "else: \n";
+      ++depth_;
+      statement->else_statement()->accept(this);
+      --depth_;
+    }
+  }
+
+  void visit(const Pascal::While* loop) override {
+    pre_print_depth() << "While\n";
+    pre_print_depth() << "condition: \n";
+    ++depth_;
+    loop->condition()->accept(this);
+    --depth_;
+    pre_print_depth() << "body: \n";
+    ++depth_;
+    loop->body()->accept(this);
+    --depth_;
+  }
+
+  void visit(const Pascal::Repeat* loop) override {
+    pre_print_depth() << "Repeat\n";
+    pre_print_depth() << "body: \n";
+    ++depth_;
+    loop->body()->accept(this);
+    --depth_;
+    pre_print_depth() << "until: \n";
+    ++depth_;
+    loop->condition()->accept(this);
+    --depth_;
+  }
+
+  void visit(const Pascal::For* loop) override {
+    pre_print_depth() << "For\n";
+    pre_print_depth() << "down: " << loop->down() << '\n';
+    pre_print_depth() << "variable: \n";
+    ++depth_;
+    loop->variable()->accept(this);
+    --depth_;
+    pre_print_depth() << "start: \n";
+    ++depth_;
+    loop->start()->accept(this);
+    --depth_;
+    pre_print_depth() << "end: \n";
+    ++depth_;
+    loop->end()->accept(this);
+    --depth_;
+    pre_print_depth() << "body: \n";
+    ++depth_;
+    loop->body()->accept(this);
+    --depth_;
+  }
+
+  void visit(const Pascal::Case* statement) override {
+    pre_print_depth() << "Case\n";
+    pre_print_depth() << "selector: \n";
+    ++depth_;
+    statement->selector()->accept(this);
+    --depth_;
+    for (const auto& branch : statement->branches()) {
+      pre_print_depth() << "labels:";
+      for (const auto& label : branch.labels) {
+        std::cout << ' ' << label.low << ".." << label.high;
+      }
+      std::cout << '\n';
+      ++depth_;
+      branch.statement->accept(this);
+      --depth_;
+    }
+    if (statement->else_statement() != nullptr) {
+      pre_print_depth() << "else: \n";
+      ++depth_;
+      statement->else_statement()->accept(this);
+      --depth_;
+    }
+  }
+
+  void visit(const Pascal::HeapOperation* operation) override {
+    pre_print_depth() << (operation->op() ==
+                                  Pascal::HeapOperation::Operator::NEW
+                              ? "New\n"
+                              : "Dispose\n");
+    pre_print_depth() << "variable: \n";
+    ++depth_;
+    operation->variable()->accept(this);
+    --depth_;
+  }
+
+  void visit(const Pascal::Write* write) override {
+    pre_print_depth() << (write->line() ? "WriteLn\n" : "Write\n");
+    for (const auto& argument : write->arguments()) {
+      pre_print_depth() << "argument: \n";
+      ++depth_;
+      argument.value->accept(this);
+      if (argument.width != nullptr) {
+        argument.width->accept(this);
+      }
+      if (argument.precision != nullptr) {
+        argument.precision->accept(this);
+      }
+      --depth_;
+    }
+  }
+
+  void visit(const Pascal::Read* read) override {
+    pre_print_depth() << (read->line() ? "ReadLn\n" : "Read\n");
+    for (const auto& variable : read->variables()) {
+      pre_print_depth() << "variable: \n";
+      ++depth_;
+      variable->accept(this);
+      --depth_;
+    }
+  }
+
+  void visit(const Pascal::Reset* reset) override {
+    pre_print_depth() << "Reset\n";
+    pre_print_depth() << "variable: \n";
+    ++depth_;
+    reset->variable()->accept(this);
+    --depth_;
+    pre_print_depth() << "path: \n";
+    ++depth_;
+    reset->path()->accept(this);
+    --depth_;
+  }
 };
 
 // set log level to debug
@@ -0,0 +1,422 @@
+// Copyright 2023 Zhu Junhui
+
+#include "range_analyzer.h"
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+
+namespace Pascal {
+
+namespace {
+
+const Interval BOOLEAN{0, 1};
+
+const Interval MEMBERS{0, Set::MAX_MEMBER};
+
+constexpr int64_t SMALLEST = std::numeric_limits<int>::min();
+
+Interval product(const Interval& left, const Interval& right) {
+  const int64_t corners[] = {left.low * right.low, left.low * right.high,
+                             left.high * right.low, left.high * right.high};
+  return {*std::min_element(std::begin(corners), std::end(corners)),
+          *std::max_element(std::begin(corners), std::end(corners))};
+}
+
+// DIV truncates toward zero; with a divisor of one sign the quotient is
+// monotonic in both operands, otherwise it is at most the dividend in size
+Interval quotient(const Interval& left, const Interval& right) {
+  if (right.low > 0 || right.high < 0) {
+    const int64_t corners[] = {left.low / right.low, left.low / right.high,
+                               left.high / right.low, left.high / right.high};
+    return {*std::min_element(std::begin(corners), std::end(corners)),
+            *std::max_element(std::begin(corners), std::end(corners))};
+  }
+  const auto size = std::max(std::llabs(left.low), std::llabs(left.high));
+  return {-size, size};
+}
+
+}  // namespace
+
+void RangeAnalyzer::analyze(Block* block) {
+  block->compound_statement()->accept(this);
+}
+
+Interval RangeAnalyzer::expression(ValueAST* expr) {
+  expr->accept(this);
+  return range_;
+}
+
+Interval RangeAnalyzer::declared(const Variable* variable,
+                                 ValueAST::ValueType type) {
+  if (type == ValueAST::ValueType::BOOLEAN) {
+    return BOOLEAN;
+  }
+  if (type == ValueAST::ValueType::INT64) {
+    return variable->range().value_or(Interval::int64());
+  }
+  return variable->range().value_or(Interval::integer());
+}
+
+template <class Node>
+void RangeAnalyzer::forget(const Node* node) {
+  Effects effects(scope_);
+  node->accept(&effects);
+  std::erase_if(facts_, [&](const auto& fact) {
+    return effects.may_write(fact.second.variable);
+  });
+}
+
+void RangeAnalyzer::join(const std::map<std::pair<int, int>, Fact>& other) {
+  std::erase_if(facts_, [&](const auto& fact) {
+    return other.count(fact.first) == 0;
+  });
+  for (auto& [address, fact] : facts_) {
+    fact.range = fact.range.join(other.at(address).range);
+  }
+}
+
+void RangeAnalyzer::indices(Variable* variable) {
+  bool within = true;
+  for (size_t i = 0; i < variable->indices().size(); ++i) {
+    const auto& dimension = variable->array()->dimensions[i];
+    const auto index = expression(variable->indices()[i].get());
+    within = within &&
+             Interval{dimension.low, dimension.high}.contains(index);
+  }
+  if (within) {
+    variable->set_checked(false);
+  }
+}
+
+std::pair<ValueAST*, ValueAST::ValueType> RangeAnalyzer::check(
+    Number* number) {
+  if (number->type() == ValueAST::ValueType::REAL ||
+      number->type() == ValueAST::ValueType::STRING ||
+      number->type() == ValueAST::ValueType::POINTER) {
+    range_ = Interval::integer();
+  } else if (number->type() == ValueAST::ValueType::INT64) {
+    const int64_t value = std::get<int64_t>(number->value());
+    range_ = {value, value};
+  } else {
+    const int value = std::get<int>(number->value());
+    range_ = {value, value};
+  }
+  return {number, number->type()};
+}
+
+std::pair<ValueAST*, ValueAST::ValueType> RangeAnalyzer::check(
+    Variable* variable) {
+  // only whole variables have facts
+  if (!variable->whole()) {
+    indices(variable);
+    range_ = declared(variable, variable->type());
+    return {variable, variable->type()};
+  }
+
+  range_ = declared(variable, variable->type());
+  if (!variable->by_reference()) {
+    const auto fact = facts_.find({variable->level(), variable->slot()});
+    if (fact != facts_.end()) {
+      range_ = fact->second.range;
+    }
+  }
+  return {variable, variable->type()};
+}
+
+std::pair<ValueAST*, ValueAST::ValueType> RangeAnalyzer::check(
+    BinaryOperation* op) {
+  const auto left = expression(op->left());
+  const auto right = expression(op->right());
+  const auto type = op->type();
+  if (type == ValueAST::ValueType::BOOLEAN) {
+    range_ = BOOLEAN;
+    return {op, type};
+  }
+  range_ = Interval::integer();
+  if (type == ValueAST::ValueType::SET) {
+    switch (op->op()) {
+      case BinaryOperation::Operator::UNION:
+        range_ = left.join(right);
+        break;
+      case BinaryOperation::Operator::INTERSECTION:
+        range_ = left.meet(right);
+        break;
+      default:
+        range_ = left;
+        break;
+    }
+    return {op, type};
+  }
+  // INT64 bounds are only computed for operands of at most 33 bits, and
+  // those of products for INTEGER operands, so that the bounds themselves
+  // cannot overflow
+  Interval limits = Interval::integer();
+  if (type == ValueAST::ValueType::INT64) {
+    limits = Interval::int64();
+    range_ = limits;
+    const auto operands = op->op() == BinaryOperation::Operator::MULTIPLY
+                              ? Interval::integer()
+                              : Interval{-(int64_t{1} << 32), int64_t{1} << 32};
+    if (!operands.contains(left.join(right))) {
+      return {op, type};
+    }
+  } else if (type != ValueAST::ValueType::INTEGER) {
+    return {op, type};
+  }
+
+  // an operation only runs on values its operands can have
+  if (left.empty() || right.empty()) {
+    op->set_checked(false);
+    range_ = {1, 0};
+    return {op, type};
+  }
+
+  using Operator = BinaryOperation::Operator;
+  Interval result;
+  switch (op->op()) {
+    case Operator::PLUS:
+      result = {left.low + right.low, left.high + right.high};
+      break;
+    case Operator::MINUS:
+      result = {left.low - right.high, left.high - right.low};
+      break;
+    case Operator::MULTIPLY:
+      result = product(left, right);
+      break;
+    case Operator::INTEGER_DIV:
+      // the divisor must not be 0, nor -1 for the smallest dividend
+      if (right.contains({0, 0}) ||
+          (right.contains({-1, -1}) && left.contains({SMALLEST, SMALLEST}))) {
+        return {op, type};
+      }
+      result = quotient(left, right);
+      break;
+    default:
+      return {op, type};
+  }
+  if (limits.contains(result)) {
+    op->set_checked(false);
+  }
+  range_ = result.meet(limits);
+  return {op, type};
+}
+
+std::pair<ValueAST*, ValueAST::ValueType> RangeAnalyzer::check(
+    UnaryOperation* op) {
+  const auto value = expression(op->expr());
+  switch (op->op()) {
+    case UnaryOperation::Operator::NOT:
+    case UnaryOperation::Operator::END_OF_FILE:
+      range_ = BOOLEAN;
+      break;
+    case UnaryOperation::Operator::MINUS:
+      if (op->type() == ValueAST::ValueType::INT64) {
+        range_ = Interval::int64();
+        if (value.empty() || Interval::integer().contains(value)) {
+          op->set_checked(false);
+          range_ = value.empty() ? value : Interval{-value.high, -value.low};
+        }
+        break;
+      }
+      if (op->type() != ValueAST::ValueType::INTEGER) {
+        break;
+      }
+      if (value.empty() || value.low > SMALLEST) {
+        op->set_checked(false);
+      }
+      range_ = value.empty() ? value
+                             : Interval{-value.high, -value.low}.meet(
+                                   Interval::integer());
+      break;
+    case UnaryOperation::Operator::CARD:
+      range_ = {0, value.empty() ? 0 : value.high - value.low + 1};
+      break;
+    case UnaryOperation::Operator::CONVERT:
+      // widening and promotion to REAL keep the values, narrowing keeps
+      // those that fit
+      if (op->type() == ValueAST::ValueType::INTEGER) {
+        if (Interval::integer().contains(value)) {
+          op->set_checked(false);
+        }
+        range_ = value.meet(Interval::integer());
+      } else {
+        range_ = value;
+      }
+      break;
+    default:
+      break;
+  }
+  return {op, op->type()};
+}
+
+std::pair<ValueAST*, ValueAST::ValueType> RangeAnalyzer::check(
+    FunctionCall* call) {
+  for (const auto& argument : call->arguments()) {
+    expression(argument.get());
+  }
+  forget(call);
+  switch (call->type()) {
+    case ValueAST::ValueType::BOOLEAN:
+      range_ = BOOLEAN;
+      break;
+    case ValueAST::ValueType::INT64:
+      range_ = Interval::int64();
+      break;
+    default:
+      range_ = Interval::integer();
+      break;
+  }
+  return {call, call->type()};
+}
+
+// a member out of 0..MAX_MEMBER fails, so the members that get into the
+// set are within it
+std::pair<ValueAST*, ValueAST::ValueType> RangeAnalyzer::check(
+    SetConstructor* constructor) {
+  Interval members{1, 0};
+  for (const auto& element : constructor->elements()) {
+    const auto low = expression(element.low.get());
+    const auto high =
+        element.high != nullptr ? expression(element.high.get()) : low;
+    if (!low.empty() && !high.empty()) {
+      members = members.join({low.low, high.high});
+    }
+  }
+  range_ = members.meet(MEMBERS);
+  return {constructor, constructor->type()};
+}
+
+void RangeAnalyzer::check(Compound* compound) {
+  for (const auto& child : compound->children()) {
+    child->accept(this);
+  }
+}
+
+// the right side is evaluated before the indices of the left
+void RangeAnalyzer::check(Assign* assign) {
+  const auto value = expression(assign->right());
+  const auto left = assign->left();
+  indices(left);
+  if (left->range().has_value() && left->range()->contains(value)) {
+    assign->set_checked(false);
+  }
+
+  forget(assign);
+  // the left side is not a typed node, the right one has its type
+  const auto type = assign->right()->type();
+  if (left->whole() && !left->by_reference() &&
+      type == ValueAST::ValueType::INTEGER) {
+    facts_[{left->level(), left->slot()}] =
+        Fact{left, value.meet(declared(left, type))};
+  }
+}
+
+void RangeAnalyzer::check(HeapOperation* operation) {
+  indices(operation->variable());
+  forget(operation);
+}
+
+void RangeAnalyzer::check(Write* write) {
+  for (const auto& argument : write->arguments()) {
+    expression(argument.value.get());
+    if (argument.width != nullptr) {
+      expression(argument.width.get());
+    }
+    if (argument.precision != nullptr) {
+      expression(argument.precision.get());
+    }
+  }
+  forget(write);
+}
+
+void RangeAnalyzer::check(Read* read) {
+  for (const auto& variable : read->variables()) {
+    indices(variable.get());
+  }
+  forget(read);
+}
+
+void RangeAnalyzer::check(Reset* reset) {
+  expression(reset->path());
+  forget(reset);
+}
+
+void RangeAnalyzer::check(ProcedureCall* call) {
+  for (const auto& argument : call->arguments()) {
+    expression(argument.get());
+  }
+  forget(call);
+}
+
+void RangeAnalyzer::check(If* statement) {
+  expression(statement->condition());
+  const auto before = facts_;
+  statement->then_statement()->accept(this);
+  auto then_facts = std::move(facts_);
+  facts_ = before;
+  if (statement->else_statement() != nullptr) {
+    statement->else_statement()->accept(this);
+  }
+  join(then_facts);
+}
+
+void RangeAnalyzer::check(Case* statement) {
+  expression(statement->selector());
+  const auto before = facts_;
+  std::map<std::pair<int, int>, Fact> after;
+  bool first = true;
+  const auto path = [&](NonValueAST* branch) {
+    facts_ = before;
+    if (branch != nullptr) {
+      branch->accept(this);
+    }
+    if (first) {
+      after = std::move(facts_);
+      first = false;
+    } else {
+      join(after);
+      after = std::move(facts_);
+    }
+  };
+  for (const auto& branch : statement->branches()) {
+    path(branch.statement.get());
+  }
+  path(statement->else_statement());
+  facts_ = std::move(after);
+}
+
+// at the head of a loop only what the loop does not change is known
+void RangeAnalyzer::check(While* loop) {
+  forget(loop);
+  expression(loop->condition());
+  const auto head = facts_;
+  loop->body()->accept(this);
+  facts_ = head;
+}
+
+void RangeAnalyzer::check(Repeat* loop) {
+  forget(loop);
+  loop->body()->accept(this);
+  expression(loop->condition());
+}
+
+void RangeAnalyzer::check(For* loop) {
+  const auto start = expression(loop->start());
+
+  // the final value is evaluated once in front of the loop
+  const auto end = expression(loop->end());
+  forget(loop);
+
+  const auto head = facts_;
+  const auto control = loop->variable();
+  if (loop->counted() && !control->by_reference()) {
+    const auto values = loop->down() ? Interval{end.low, start.high}
+                                     : Interval{start.low, end.high};
+    facts_[{control->level(), control->slot()}] =
+        Fact{control, values.meet(declared(control, loop->start()->type()))};
+  }
+  loop->body()->accept(this);
+  facts_ = head;
+}
+
+}  // namespace Pascal
@@ -0,0 +1,85 @@
+// Copyright 2023 Zhu Junhui
+
+#pragma once
+
+#include <map>
+#include <utility>
+#include "ast.h"
+#include "effects.h"
+#include "symbol_table.h"
+
+namespace Pascal {
+
+// Proves run-time checks of one block unnecessary, while the semantic
+// analyzer still has the block's scope open, and clears them: INTEGER
+// operations that cannot overflow or divide by zero, indices that cannot be
+// out of range, and assignments that cannot leave a subrange or give a set
+// a member its type does not have. Every INTEGER expression gets an
+// interval of the values it may have, every SET expression one holding its
+// members. A variable's interval comes from its declared type, from the
+// bounds of the counted FOR loop it controls or from the value last
+// assigned to it; the last two are forgotten as soon as a statement may
+// write the variable.
+class RangeAnalyzer : public Checker {
+ private:
+  const T::SymbolTable* scope_;
+
+  struct Fact {
+    const Variable* variable;
+    Interval range;
+  };
+
+  // what is known at the current point about scalar INTEGER variables, by
+  // (level, slot)
+  std::map<std::pair<int, int>, Fact> facts_;
+
+  // values of the expression checked last
+  Interval range_ = Interval::integer();
+
+  Interval expression(ValueAST* expr);
+
+  // check the indices of a variable
+  void indices(Variable* variable);
+
+  // the declared bounds of a variable, or those of its type
+  static Interval declared(const Variable* variable, ValueAST::ValueType type);
+
+  // drop the facts about variables code may write
+  template <class Node>
+  void forget(const Node* node);
+
+  // keep what is known on both paths that meet
+  void join(const std::map<std::pair<int, int>, Fact>& other);
+
+ public:
+  explicit RangeAnalyzer(const T::SymbolTable* scope) : scope_(scope) {}
+
+  void analyze(Block* block);
+
+  std::pair<ValueAST*, ValueAST::ValueType> check(BinaryOperation*) override;
+  std::pair<ValueAST*, ValueAST::ValueType> check(UnaryOperation*) override;
+  std::pair<ValueAST*, ValueAST::ValueType> check(Number*) override;
+  std::pair<ValueAST*, ValueAST::ValueType> check(Variable*) override;
+  std::pair<ValueAST*, ValueAST::ValueType> check(FunctionCall*) override;
+  std::pair<ValueAST*, ValueAST::ValueType> check(SetConstructor*) override;
+  ValueAST::ValueType check(Type* type) override { return type->value(); }
+  void check(Compound*) override;
+  void check(Assign*) override;
+  void check(Program*) override {}
+  void check(Block*) override {}
+  void check(VariableDeclaration*) override {}
+  void check(ProcedureDeclaration*) override {}
+  void check(Parameter*) override {}
+  void check(ProcedureCall*) override;
+  void check(If*) override;
+  void check(While*) override;
+  void check(Repeat*) override;
+  void check(For*) override;
+  void check(Case*) override;
+  void check(HeapOperation*) override;
+  void check(Write*) override;
+  void check(Read*) override;
+  void check(Reset*) override;
+};
+
+}  // namespace Pascal
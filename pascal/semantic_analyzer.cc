@@ -1,18 +1,53 @@
 // Copyright 2023 Zhu Junhui
 
 #include "semantic_analyzer.h"
+#include <algorithm>
+#include <exception>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "effects.h"
+#include "optimizer.h"
+#include "range_analyzer.h"
+#include "parser.h"
 
 namespace Pascal {
 
+namespace {
+
+bool is_integer(ValueAST::ValueType type) {
+  return type == ValueAST::ValueType::INTEGER ||
+         type == ValueAST::ValueType::INT64;
+}
+
+// INTEGER and INT64 values are assigned and passed to each other, and to
+// REAL variables and parameters
+bool promotes(ValueAST::ValueType from, ValueAST::ValueType to) {
+  return is_integer(from) &&
+         (is_integer(to) || to == ValueAST::ValueType::REAL);
+}
+
+}  // namespace
+
+SemanticAnalyzer::SemanticAnalyzer(
+    const T::SymbolTable* enclosing,
+    std::shared_ptr<DeferredProcedures> deferred, std::ostream* out,
+    int depth)
+    : symbol_table_(enclosing),
+      deferred_(std::move(deferred)),
+      depth_(depth),
+      out_(out) {}
+
 void SemanticAnalyzer::error(const std::string& msg) {
   throw std::runtime_error(msg);
 }
 
 std::ostream& SemanticAnalyzer::indent() const {
   for (int i = 0; i < depth_; ++i) {
-    std::cout << "  ";
+    *out_ << "  ";
   }
-  return std::cout;
+  return *out_;
 }
 
 void SemanticAnalyzer::analyze(Program* program) {
@@ -46,22 +81,521 @@ void SemanticAnalyzer::check(Block* block) {
   depth_--;
 
   depth_++;
-  for (const auto& declaration : block->procedures_declarations()) {
-    declaration->accept(this);
+  const auto& procedures = block->procedures_declarations();
+  for (size_t i = 0; i < procedures.size(); ++i) {
+    const auto procedure = procedures[i].get();
+    if (symbol_table_.define_procedure(procedure->name(), procedure, i) ==
+        nullptr) {
+      error("procedure " + procedure->name() + " has been declared!");
+    }
+  }
+
+  defer(block);
+  if (pool_ != nullptr &&
+      block->procedures_declarations().size() >= PARALLEL_PROCEDURES) {
+    check_procedures_parallel(block);
+  } else {
+    for (const auto& declaration : block->procedures_declarations()) {
+      declaration->accept(this);
+    }
   }
   depth_--;
 
   depth_++;
   block->compound_statement()->accept(this);
   depth_--;
+
+  // the optimizer allocates its temporaries in this block's frame; it only
+  // moves code that cannot fail, which the range analyzer decides
+  if (deferred_->optimize) {
+    RangeAnalyzer(&symbol_table_).analyze(block);
+    Optimizer(&symbol_table_).optimize(block);
+  }
+  block->set_frame_size(symbol_table_.frame_size());
+}
+
+// Sibling procedures only read the enclosing scopes, so each one is checked
+// by its own analyzer layered over the current (frozen) symbol table. Debug
+// output and the first error are replayed in declaration order, which makes
+// the result identical to checking them one after another.
+void SemanticAnalyzer::check_procedures_parallel(Block* block) {
+  const auto& procedures = block->procedures_declarations();
+  std::vector<std::ostringstream> logs(procedures.size());
+  std::vector<std::exception_ptr> errors(procedures.size());
+
+  pool_->parallel_for(procedures.size(), [&](size_t i, size_t) {
+    SemanticAnalyzer worker(&symbol_table_, deferred_, &logs[i], depth_);
+    try {
+      procedures[i]->accept(&worker);
+    } catch (...) {
+      errors[i] = std::current_exception();
+    }
+  });
+
+  for (size_t i = 0; i < procedures.size(); ++i) {
+    *out_ << logs[i].str();
+    if (errors[i]) {
+      std::rethrow_exception(errors[i]);
+    }
+  }
+}
+
+void SemanticAnalyzer::defer(Block* block) {
+  std::shared_ptr<const T::SymbolTable> scope;
+  uint64_t scope_hash = 0;
+  for (const auto& declaration : block->procedures_declarations()) {
+    if (declaration->parsed()) {
+      continue;
+    }
+    if (scope == nullptr) {
+      scope = symbol_table_.snapshot();
+      // optimized and unoptimized bodies must not be mixed up in the cache,
+      // nor bodies calling different host functions
+      scope_hash = scope->fingerprint() ^ deferred_->optimize;
+      if (deferred_->host != nullptr) {
+        scope_hash = hash_combine(scope_hash, deferred_->host->fingerprint());
+      }
+    }
+    // so must bodies parsed with different types
+    const auto& types = declaration->types();
+    std::lock_guard lock(deferred_->mutex);
+    deferred_->procedures[declaration.get()] = Deferred{
+        scope,
+        hash_combine(scope_hash, types != nullptr ? types->fingerprint() : 0),
+        depth_, false};
+  }
+}
+
+void SemanticAnalyzer::analyze_deferred(ProcedureDeclaration* procedure_decl) {
+  // only claiming the body is serialized; it is parsed and checked
+  // outside the lock, so sibling workers analyze different bodies at once.
+  // A caller needs no more than the declaration of its callee, so a later
+  // reference, e.g. from the body itself or from a mutually recursive one
+  // on another worker, does not wait for the analysis to finish
+  const Deferred* deferred;
+  {
+    std::lock_guard lock(deferred_->mutex);
+    auto it = deferred_->procedures.find(procedure_decl);
+    if (it == deferred_->procedures.end() || it->second.claimed) {
+      return;
+    }
+    it->second.claimed = true;
+    deferred = &it->second;
+  }
+
+  const auto cache = deferred_->cache;
+  const CompilationCache::Key key{procedure_decl->body_hash(),
+                                  deferred->scope_hash};
+  if (cache != nullptr) {
+    if (auto body = cache->find(key); body.has_value()) {
+      if (DEBUG) {
+        indent() << "reuse procedure " << procedure_decl->name() << std::endl;
+      }
+      procedure_decl->set_block(std::move(body->block));
+
+      // the reused body was checked together with the pre-parsed procedures
+      // it calls, which are new declarations in this program
+      for (const auto& callee : body->callees) {
+        analyze_deferred(deferred->scope->lookup(callee)->procedure);
+      }
+      return;
+    }
+  }
+
+  if (DEBUG) {
+    indent() << "parse procedure " << procedure_decl->name() << std::endl;
+  }
+  Parser parser(procedure_decl->body_source(), procedure_decl->types());
+  procedure_decl->set_block(parser.parse_block());
+
+  SemanticAnalyzer analyzer(deferred->scope.get(), deferred_, out_,
+                            deferred->depth);
+  procedure_decl->accept(&analyzer);
+
+  if (cache != nullptr) {
+    cache->insert(key, CompilationCache::Body{procedure_decl->shared_block(),
+                                              analyzer.external_calls_});
+  }
 }
 
 void SemanticAnalyzer::check(ProcedureDeclaration* procedure_decl) {
-  symbol_table_.enter_scope(procedure_decl->name());
+  if (!procedure_decl->parsed()) {
+    return;
+  }
+  symbol_table_.enter_scope(procedure_decl->name(), procedure_decl);
+  for (const auto& parameter : procedure_decl->parameters()) {
+    parameter->accept(this);
+  }
+  if (procedure_decl->is_function()) {
+    if (procedure_decl->return_type()->value() ==
+        ValueAST::ValueType::ARRAY) {
+      error("function " + procedure_decl->name() + " cannot return an array!");
+    }
+    if (procedure_decl->return_type()->value() == ValueAST::ValueType::SET) {
+      error("function " + procedure_decl->name() + " cannot return a set!");
+    }
+    if (procedure_decl->return_type()->value() ==
+        ValueAST::ValueType::STRING) {
+      error("function " + procedure_decl->name() + " cannot return a string!");
+    }
+    if (procedure_decl->return_type()->value() ==
+        ValueAST::ValueType::RECORD) {
+      error("function " + procedure_decl->name() + " cannot return a record!");
+    }
+    if (procedure_decl->return_type()->value() == ValueAST::ValueType::FILE) {
+      error("function " + procedure_decl->name() + " cannot return a file!");
+    }
+    const auto slot = symbol_table_.reserve_slot();
+    assert(slot == procedure_decl->result_slot());
+  }
   procedure_decl->block()->accept(this);
+  mark_tail_calls(procedure_decl->block()->compound_statement(),
+                  procedure_decl);
   symbol_table_.exit_scope();
 }
 
+void SemanticAnalyzer::check(Parameter* parameter) {
+  const auto variable = parameter->variable();
+  const auto type = parameter->type();
+  if (type->value() == ValueAST::ValueType::FILE) {
+    error("parameter " + variable->value() + " cannot be a file!");
+  }
+  const auto symbol = symbol_table_.define(
+      variable->value(), type->value(), parameter->by_reference(),
+      type->array(), type->range(),
+      type->array() != nullptr ? type->array()->record : type->record(),
+      type->array() != nullptr ? type->array()->pointer : type->pointer());
+  if (symbol == nullptr) {
+    error("parameter " + variable->value() + " has been declared!");
+  }
+  variable->set_address(symbol->level, symbol->slot, symbol->by_reference);
+  variable->set_array(symbol->array);
+  variable->set_record(symbol->record);
+  variable->set_pointer(symbol->pointer);
+  variable->set_range(symbol->range);
+}
+
+template <class Call>
+const ProcedureDeclaration* SemanticAnalyzer::check_call(Call* call,
+                                                         bool function) {
+  const std::string kind = function ? "function " : "procedure ";
+  const auto found = symbol_table_.lookup(call->name());
+  if (found == nullptr || found->kind != T::Symbol::Kind::PROCEDURE ||
+      found->procedure->is_function() != function) {
+    error(kind + call->name() + " has not been declared!");
+  }
+  const auto symbol = *found;
+  const auto procedure = symbol.procedure;
+
+  if (symbol.level < symbol_table_.base_level()) {
+    external_calls_.push_back(call->name());
+  }
+  analyze_deferred(procedure);
+
+  const auto& parameters = procedure->parameters();
+  if (call->arguments().size() != parameters.size()) {
+    error(kind + call->name() + " expects " +
+          std::to_string(parameters.size()) + " arguments!");
+  }
+
+  depth_++;
+  for (size_t i = 0; i < parameters.size(); ++i) {
+    const auto argument = call->argument_release(i);
+    auto [argument_typed, argument_type] = argument->accept(this);
+    delete argument;
+    call->set_argument(i, argument_typed);
+
+    if (parameters[i]->by_reference() &&
+        dynamic_cast<Variable*>(argument_typed) == nullptr) {
+      error("argument " + std::to_string(i + 1) + " of " + call->name() +
+            " must be a variable!");
+    }
+    // a slot cannot refer to a scalar packed into fewer bytes
+    if (parameters[i]->by_reference() &&
+        static_cast<Variable*>(argument_typed)->packed_size() != 0) {
+      error("argument " + std::to_string(i + 1) + " of " + call->name() +
+            " is packed!");
+    }
+    const auto parameter_type = parameters[i]->type();
+    // a value parameter takes INTEGER and INT64 arguments alike, and a
+    // REAL one takes both
+    if (!parameters[i]->by_reference() &&
+        promotes(argument_type, parameter_type->value())) {
+      argument_typed = convert(call->argument_release(i), argument_type,
+                               parameter_type->value());
+      call->set_argument(i, argument_typed);
+      argument_type = parameter_type->value();
+    }
+    const auto argument_array =
+        argument_type == ValueAST::ValueType::ARRAY
+            ? static_cast<Variable*>(argument_typed)->array()
+            : nullptr;
+    const auto argument_record =
+        argument_type == ValueAST::ValueType::RECORD
+            ? static_cast<Variable*>(argument_typed)->record().get()
+            : nullptr;
+    // a VAR parameter of a subrange type only takes variables of the same
+    // subrange, a value one takes any INTEGER and checks it
+    if (argument_type != parameter_type->value() ||
+        (argument_array != nullptr &&
+         *argument_array != *parameter_type->array()) ||
+        (argument_record != nullptr &&
+         *argument_record != *parameter_type->record()) ||
+        (parameters[i]->by_reference() &&
+         static_cast<Variable*>(argument_typed)->range() !=
+             parameter_type->range()) ||
+        (argument_type == ValueAST::ValueType::POINTER &&
+         !compatible(pointer(argument_typed),
+                     parameter_type->pointer().get()))) {
+      error("type of argument " + std::to_string(i + 1) + " of " +
+            call->name() + " does not match its parameter!");
+    }
+  }
+  depth_--;
+
+  call->set_target(symbol.level, symbol.slot);
+  return procedure;
+}
+
+void SemanticAnalyzer::check(ProcedureCall* call) {
+  if (DEBUG) {
+    indent() << "check procedure call " << call->name() << std::endl;
+  }
+  check_call(call, false);
+}
+
+std::pair<ValueAST*, ValueAST::ValueType> SemanticAnalyzer::check(
+    FunctionCall* call) {
+  if (DEBUG) {
+    indent() << "check function call " << call->name() << std::endl;
+  }
+  if (symbol_table_.lookup(call->name()) == nullptr) {
+    if (const auto host = host_function(call->name()); host != nullptr) {
+      return check_host_call(call, host);
+    }
+  }
+  const auto function = check_call(call, true);
+  return call->wrap_with_type(function->return_type()->value());
+}
+
+const HostFunction* SemanticAnalyzer::host_function(
+    const std::string& name) const {
+  return deferred_->host != nullptr ? deferred_->host->find(name) : nullptr;
+}
+
+std::pair<ValueAST*, ValueAST::ValueType> SemanticAnalyzer::check_host_call(
+    FunctionCall* call, const HostFunction* function) {
+  const auto& parameters = function->parameters;
+  if (call->arguments().size() != parameters.size()) {
+    error("function " + call->name() + " expects " +
+          std::to_string(parameters.size()) + " arguments!");
+  }
+  depth_++;
+  for (size_t i = 0; i < parameters.size(); ++i) {
+    const auto argument = call->argument_release(i);
+    auto [argument_typed, argument_type] = argument->accept(this);
+    delete argument;
+    call->set_argument(i, argument_typed);
+    if (promotes(argument_type, parameters[i])) {
+      argument_typed = convert(call->argument_release(i), argument_type,
+                               parameters[i]);
+      call->set_argument(i, argument_typed);
+      argument_type = parameters[i];
+    }
+    if (argument_type != parameters[i]) {
+      error("type of argument " + std::to_string(i + 1) + " of " +
+            call->name() + " does not match its parameter!");
+    }
+  }
+  depth_--;
+  call->set_host(function);
+  return call->wrap_with_type(function->result);
+}
+
+// A call that is the last statement of a body does not need the caller's
+// frame afterwards, unless the callee is nested in the caller, which makes
+// that frame its static link, or gets a VAR argument living in it.
+bool SemanticAnalyzer::reuses_frame(
+    int callee_level, const std::vector<std::unique_ptr<ValueAST>>& arguments,
+    const ProcedureDeclaration* callee) const {
+  const int level = symbol_table_.level();
+  if (callee_level >= level) {
+    return false;
+  }
+  for (size_t i = 0; i < arguments.size(); ++i) {
+    const auto& parameter = callee->parameters()[i];
+    // an array, set, record or string passed by value is copied above the
+    // caller's arrays
+    if ((parameter->type()->value() == ValueAST::ValueType::ARRAY ||
+         parameter->type()->value() == ValueAST::ValueType::SET ||
+         parameter->type()->value() == ValueAST::ValueType::RECORD ||
+         parameter->type()->value() == ValueAST::ValueType::STRING) &&
+        !parameter->by_reference()) {
+      return false;
+    }
+    if (!parameter->by_reference()) {
+      continue;
+    }
+    const auto variable = static_cast<const Variable*>(arguments[i].get());
+    if (variable->level() == level && !variable->by_reference()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void SemanticAnalyzer::mark_tail_calls(
+    NonValueAST* statement, const ProcedureDeclaration* procedure_decl) {
+  if (const auto compound = dynamic_cast<Compound*>(statement)) {
+    if (!compound->children().empty()) {
+      mark_tail_calls(compound->children().back().get(), procedure_decl);
+    }
+    return;
+  }
+
+  if (const auto branch = dynamic_cast<If*>(statement)) {
+    mark_tail_calls(branch->then_statement(), procedure_decl);
+    if (branch->else_statement() != nullptr) {
+      mark_tail_calls(branch->else_statement(), procedure_decl);
+    }
+    return;
+  }
+
+  if (const auto selection = dynamic_cast<Case*>(statement)) {
+    for (const auto& branch : selection->branches()) {
+      mark_tail_calls(branch.statement.get(), procedure_decl);
+    }
+    if (selection->else_statement() != nullptr) {
+      mark_tail_calls(selection->else_statement(), procedure_decl);
+    }
+    return;
+  }
+
+  if (const auto call = dynamic_cast<ProcedureCall*>(statement)) {
+    // a function still has to return its result after the call
+    if (procedure_decl->is_function()) {
+      return;
+    }
+    const auto callee = symbol_table_.lookup(call->name())->procedure;
+    call->set_tail(reuses_frame(call->level(), call->arguments(), callee));
+    return;
+  }
+
+  // F := G(...) returning G's result as F's own, which is not stored or
+  // checked on the way, so G has to return what F may
+  const auto assign = dynamic_cast<Assign*>(statement);
+  if (assign == nullptr || !procedure_decl->is_function()) {
+    return;
+  }
+  const auto left = assign->left();
+  const auto call = dynamic_cast<FunctionCall*>(assign->right());
+  if (call == nullptr || call->host() != nullptr ||
+      left->level() != symbol_table_.level() ||
+      left->slot() != procedure_decl->result_slot()) {
+    return;
+  }
+  const auto callee = symbol_table_.lookup(call->name())->procedure;
+  const auto result = procedure_decl->return_type();
+  if (callee->return_type()->value() != result->value() ||
+      callee->return_type()->range() != result->range()) {
+    return;
+  }
+  call->set_tail(reuses_frame(call->level(), call->arguments(), callee));
+}
+
+template <class Statement>
+void SemanticAnalyzer::check_condition(Statement* statement,
+                                       const std::string& name) {
+  const auto condition = statement->condition_release();
+  const auto [condition_typed, condition_type] = condition->accept(this);
+  delete condition;
+  statement->set_condition(condition_typed);
+
+  if (condition_type != ValueAST::ValueType::BOOLEAN) {
+    error("condition of " + name + " is not boolean!");
+  }
+}
+
+void SemanticAnalyzer::check(If* statement) {
+  if (DEBUG) {
+    indent() << "check if" << std::endl;
+  }
+  depth_++;
+  check_condition(statement, "IF");
+  statement->then_statement()->accept(this);
+  if (statement->else_statement() != nullptr) {
+    statement->else_statement()->accept(this);
+  }
+  depth_--;
+}
+
+void SemanticAnalyzer::check(While* loop) {
+  if (DEBUG) {
+    indent() << "check while" << std::endl;
+  }
+  depth_++;
+  check_condition(loop, "WHILE");
+  loop->body()->accept(this);
+  depth_--;
+}
+
+void SemanticAnalyzer::check(Repeat* loop) {
+  if (DEBUG) {
+    indent() << "check repeat" << std::endl;
+  }
+  depth_++;
+  loop->body()->accept(this);
+  check_condition(loop, "REPEAT");
+  depth_--;
+}
+
+void SemanticAnalyzer::check(For* loop) {
+  if (DEBUG) {
+    indent() << "check for" << std::endl;
+  }
+  depth_++;
+
+  const auto variable = loop->variable();
+  const auto symbol = symbol_table_.lookup(variable->value());
+  if (symbol == nullptr || symbol->kind != T::Symbol::Kind::VARIABLE) {
+    error("variable " + variable->value() + " has not been declared!");
+  }
+  // any INTEGER or INT64, including the subranges of either
+  const auto type = symbol->type;
+  if (!is_integer(type) || !variable->whole()) {
+    error("control variable " + variable->value() + " is not integer!");
+  }
+  variable->set_address(symbol->level, symbol->slot, symbol->by_reference);
+  variable->set_range(symbol->range);
+
+  const auto start = loop->start_release();
+  const auto [start_typed, start_type] = start->accept(this);
+  delete start;
+  loop->set_start(start_typed);
+
+  const auto end = loop->end_release();
+  const auto [end_typed, end_type] = end->accept(this);
+  delete end;
+  loop->set_end(end_typed);
+
+  if (!is_integer(start_type) || !is_integer(end_type)) {
+    error("bounds of FOR " + variable->value() + " are not integer!");
+  }
+  // converted like values assigned to the control variable
+  loop->set_start(convert(loop->start_release(), start_type, type));
+  loop->set_end(convert(loop->end_release(), end_type, type));
+
+  loop->body()->accept(this);
+
+  // the control variable is re-read after every iteration, unless the
+  // body provably does not change it
+  Effects body(&symbol_table_);
+  loop->body()->accept(&body);
+  loop->set_counted(!body.may_write(variable));
+
+  depth_--;
+}
+
 ValueAST::ValueType SemanticAnalyzer::check(Type* type) {
   return type->value();
 }
@@ -82,15 +616,28 @@ void SemanticAnalyzer::check(VariableDeclaration* var_decl) {
   if (DEBUG) {
     indent() << "variables: ";
   }
+  const auto declared = var_decl->type();
   for (const auto& var : var_names) {
     if (DEBUG) {
-      std::cout << var->value() << ", ";
+      *out_ << var->value() << ", ";
     }
-    if (!symbol_table_.define(var->value(), type)) {
+    const auto symbol = symbol_table_.define(
+        var->value(), type, false, declared->array(), declared->range(),
+        declared->array() != nullptr ? declared->array()->record
+                                     : declared->record(),
+        declared->array() != nullptr ? declared->array()->pointer
+                                     : declared->pointer(),
+        declared->file());
+    if (symbol == nullptr) {
       error("variable " + var->value() + " has been declared!");
     }
+    var->set_address(symbol->level, symbol->slot);
+    var->set_array(symbol->array);
+    var->set_record(symbol->record);
+    var->set_pointer(symbol->pointer);
+    var->set_range(symbol->range);
   }
-  std::cout << "\n";
+  *out_ << "\n";
 
   depth_--;
 }
@@ -116,7 +663,7 @@ void SemanticAnalyzer::check(Assign* assign) {
   const auto left_var = assign->left();
 
   const auto right_expr = assign->right_release();
-  const auto [right_typed, right_type] = right_expr->accept(this);
+  auto [right_typed, right_type] = right_expr->accept(this);
 
   delete right_expr;
 
@@ -125,12 +672,43 @@ void SemanticAnalyzer::check(Assign* assign) {
   assert(right_typed->type_checked());
 
   // check whether defined
-  if (!symbol_table_.is_defined(left_var->value(), true)) {
+  const auto symbol = symbol_table_.lookup(left_var->value());
+  if (symbol == nullptr) {
     error("variable " + left_var->value() + " has not been declared!");
   }
 
+  auto left_type = symbol->type;
+  if (symbol->kind == T::Symbol::Kind::VARIABLE) {
+    left_type = select(left_var, *symbol);
+  } else {
+    // assigning to the name of an enclosing function sets its result
+    const auto function = symbol->procedure;
+    if (!function->is_function() || symbol->level >= symbol_table_.level() ||
+        symbol_table_.owner(symbol->level + 1) != function) {
+      error("variable " + left_var->value() + " has not been declared!");
+    }
+    if (!left_var->whole()) {
+      error("function " + left_var->value() + " is not an array or record!");
+    }
+    left_var->set_address(symbol->level + 1, function->result_slot());
+    left_var->set_range(function->return_type()->range());
+    left_var->set_pointer(function->return_type()->pointer());
+    left_type = function->return_type()->value();
+  }
+
+  if (promotes(right_type, left_type)) {
+    assign->set_right(convert(assign->right_release(), right_type, left_type));
+    right_type = left_type;
+  }
+
   // check whether type is equal
-  if (symbol_table_.get_type(left_var->value()).value() != right_type) {
+  if (left_type != right_type ||
+      (left_type == ValueAST::ValueType::ARRAY &&
+       *left_var->array() != *static_cast<Variable*>(right_typed)->array()) ||
+      (left_type == ValueAST::ValueType::RECORD &&
+       *left_var->record() != *static_cast<Variable*>(right_typed)->record()) ||
+      (left_type == ValueAST::ValueType::POINTER &&
+       !compatible(left_var->pointer().get(), pointer(right_typed)))) {
     error("type of left expression is not equal to type of right expression!");
   }
 
@@ -150,12 +728,206 @@ std::pair<ValueAST*, ValueAST::ValueType> SemanticAnalyzer::check(
   if (DEBUG) {
     indent() << "variable name: " << var_name << std::endl;
   }
-  if (!symbol_table_.is_defined(var_name, true)) {
+  const auto symbol = symbol_table_.lookup(var_name);
+  if (((symbol != nullptr && symbol->kind == T::Symbol::Kind::PROCEDURE &&
+        symbol->procedure->is_function()) ||
+       (symbol == nullptr && host_function(var_name) != nullptr)) &&
+      variable->whole()) {
+    // a function without parameters is called by its name alone
+    depth_--;
+    FunctionCall call(var_name, {});
+    return check(&call);
+  }
+  if (symbol == nullptr || symbol->kind != T::Symbol::Kind::VARIABLE) {
     error("variable " + var_name + " has not been declared!");
   }
+  const auto type = select(variable, *symbol);
+  if (type == ValueAST::ValueType::FILE) {
+    error("file " + var_name + " can only be used by RESET, READ and EOF!");
+  }
+
+  if (DEBUG) {
+    indent() << "address: (" << symbol->level << ", " << symbol->slot << ")"
+             << std::endl;
+  }
 
   depth_--;
-  return variable->wrap_with_type(symbol_table_.get_type(var_name).value());
+  return variable->wrap_with_type(type);
+}
+
+ValueAST::ValueType SemanticAnalyzer::select(Variable* variable,
+                                             const T::Symbol& symbol) {
+  const auto type = select_element(variable, symbol);
+  return variable->dereferences().empty() ? type
+                                          : dereference(variable, type);
+}
+
+// What a variable selects is found at a byte offset fixed here, plus a
+// multiple of a stride for an array element, so running a selection costs
+// no lookup of fields.
+ValueAST::ValueType SemanticAnalyzer::select_element(Variable* variable,
+                                                     const T::Symbol& symbol) {
+  variable->set_address(symbol.level, symbol.slot, symbol.by_reference);
+  variable->set_array(symbol.array);
+  variable->set_record(symbol.record);
+  variable->set_pointer(symbol.pointer);
+  if (variable->indices().empty() && variable->fields().empty()) {
+    variable->set_range(symbol.range);
+    return symbol.type;
+  }
+
+  auto type = symbol.type;
+  auto range = symbol.range;
+  if (!variable->indices().empty()) {
+    // only single elements are selected, never rows
+    if (symbol.array == nullptr ||
+        variable->indices().size() != symbol.array->dimensions.size()) {
+      error("variable " + variable->value() + " needs " +
+            std::to_string(symbol.array == nullptr
+                               ? 0
+                               : symbol.array->dimensions.size()) +
+            " indices!");
+    }
+    for (size_t i = 0; i < variable->indices().size(); ++i) {
+      const auto index = variable->index_release(i);
+      const auto [index_typed, index_type] = index->accept(this);
+      delete index;
+      variable->set_index(i, index_typed);
+      if (index_type != ValueAST::ValueType::INTEGER) {
+        error("index of " + variable->value() + " is not integer!");
+      }
+    }
+    type = symbol.array->element;
+    range = symbol.array->range;
+  }
+
+  // a record is only ever a whole variable
+  if (variable->fields().empty()) {
+    if (type == ValueAST::ValueType::RECORD) {
+      error("element of " + variable->value() + " is a record!");
+    }
+    const int64_t size = symbol.array->element_size();
+    variable->set_selection(size, 0,
+                            narrow(type, size) ? static_cast<int>(size) : 0);
+    variable->set_range(range);
+    return type;
+  }
+  const RecordType* record = type == ValueAST::ValueType::RECORD
+                                 ? symbol.record.get()
+                                 : nullptr;
+  const RecordType::Field* field = nullptr;
+  int64_t offset = 0;
+  for (const auto& name : variable->fields()) {
+    if (record == nullptr) {
+      error("variable " + variable->value() + " has no field " + name + "!");
+    }
+    field = record->field(name);
+    if (field == nullptr) {
+      error("variable " + variable->value() + " has no field " + name + "!");
+    }
+    offset += field->offset;
+    record = field->record.get();
+  }
+  if (field->type == ValueAST::ValueType::RECORD) {
+    error("field " + field->name + " of " + variable->value() +
+          " is a record!");
+  }
+  int64_t stride = 0;
+  if (!variable->indices().empty()) {
+    std::tie(stride, offset) = symbol.array->field(offset, field->size);
+  }
+  variable->set_selection(
+      stride, offset,
+      narrow(field->type, field->size) ? static_cast<int>(field->size) : 0);
+  variable->set_range(field->range);
+  variable->set_pointer(field->pointer);
+  return field->type;
+}
+
+// Each dereference starts at the target of the pointer selected so far,
+// and its fields at an offset fixed here like those of a variable.
+ValueAST::ValueType SemanticAnalyzer::dereference(Variable* variable,
+                                                  ValueAST::ValueType type) {
+  const auto& dereferences = variable->dereferences();
+  int64_t size = 0;
+  for (size_t i = 0; i < dereferences.size(); ++i) {
+    if (type != ValueAST::ValueType::POINTER) {
+      error("variable " + variable->value() + " is not a pointer!");
+    }
+    const auto target = variable->pointer()->target();
+    type = target->value();
+    auto range = target->range();
+    auto pointer = target->pointer();
+    const RecordType* record = target->record().get();
+    size = record != nullptr
+               ? record->size
+               : scalar_size(type, range, target->packed());
+    int64_t offset = 0;
+    for (const auto& name : dereferences[i].fields) {
+      const auto field = record != nullptr ? record->field(name) : nullptr;
+      if (field == nullptr) {
+        error("target of " + variable->value() + " has no field " + name +
+              "!");
+      }
+      offset += field->offset;
+      type = field->type;
+      range = field->range;
+      pointer = field->pointer;
+      size = field->size;
+      record = field->record.get();
+    }
+    if (type == ValueAST::ValueType::RECORD) {
+      error("target of " + variable->value() + " is a record!");
+    }
+    variable->set_dereference_offset(i, offset);
+    variable->set_range(range);
+    variable->set_pointer(std::move(pointer));
+  }
+  variable->set_packed_size(narrow(type, size) ? static_cast<int>(size) : 0);
+  return type;
+}
+
+const PointerType* SemanticAnalyzer::pointer(const ValueAST* expr) const {
+  if (const auto variable = dynamic_cast<const Variable*>(expr)) {
+    return variable->pointer().get();
+  }
+  if (const auto call = dynamic_cast<const FunctionCall*>(expr)) {
+    const auto function = symbol_table_.lookup(call->name())->procedure;
+    return function->return_type()->pointer().get();
+  }
+  return nullptr;
+}
+
+bool SemanticAnalyzer::compatible(const PointerType* left,
+                                  const PointerType* right) {
+  return left == nullptr || right == nullptr || *left == *right;
+}
+
+ValueAST* SemanticAnalyzer::convert(ValueAST* expr, ValueAST::ValueType from,
+                                    ValueAST::ValueType to) {
+  if (from == to) {
+    return expr;
+  }
+  // only narrowing a constant could fail, which is left to the run
+  if (const auto number = dynamic_cast<Number*>(expr);
+      number != nullptr && to != ValueAST::ValueType::INTEGER) {
+    const int64_t value = from == ValueAST::ValueType::INTEGER
+                              ? std::get<int>(number->value())
+                              : std::get<int64_t>(number->value());
+    delete expr;
+    const auto token =
+        to == ValueAST::ValueType::REAL
+            ? Token(Token::Type::REAL_CONST, static_cast<double>(value))
+            : Token(Token::Type::INTEGER_CONST, value);
+    return Number(token).wrap_with_type(to).first;
+  }
+  UnaryOperation conversion(std::unique_ptr<ValueAST>(expr),
+                            UnaryOperation::Operator::CONVERT);
+  // every INTEGER is an INT64, and every INT64 a REAL, rounded if need be
+  if (to != ValueAST::ValueType::INTEGER) {
+    conversion.set_checked(false);
+  }
+  return conversion.wrap_with_type(to).first;
 }
 
 std::pair<ValueAST*, ValueAST::ValueType> SemanticAnalyzer::check(
@@ -163,8 +935,8 @@ std::pair<ValueAST*, ValueAST::ValueType> SemanticAnalyzer::check(
   const auto left = op->left_release();
   const auto right = op->right_release();
 
-  const auto [left_typed, left_type] = left->accept(this);
-  const auto [right_typed, right_type] = right->accept(this);
+  auto [left_typed, left_type] = left->accept(this);
+  auto [right_typed, right_type] = right->accept(this);
 
   delete left;
   delete right;
@@ -175,29 +947,156 @@ std::pair<ValueAST*, ValueAST::ValueType> SemanticAnalyzer::check(
   assert(left_typed->type_checked());
   assert(right_typed->type_checked());
 
-  if (op->op() != BinaryOperation::Operator::INTEGER_DIV &&
-      op->op() != BinaryOperation::Operator::REAL_DIV) {
-    if (left_type != right_type) {
-      error(
-          "type of left expression is not equal to type of right expression!");
-    }
-  } else if (op->op() == BinaryOperation::Operator::INTEGER_DIV) {
+  if (left_type == ValueAST::ValueType::ARRAY ||
+      right_type == ValueAST::ValueType::ARRAY) {
+    error("an array cannot be an operand!");
+  }
+  if (left_type == ValueAST::ValueType::RECORD ||
+      right_type == ValueAST::ValueType::RECORD) {
+    error("a record cannot be an operand!");
+  }
+
+  using Operator = BinaryOperation::Operator;
+  if (op->op() == Operator::IN) {
     if (left_type != ValueAST::ValueType::INTEGER ||
-        right_type != ValueAST::ValueType::INTEGER) {
-      error("type of left expression or right expression is not integer!");
-    }
-  } else if (op->op() == BinaryOperation::Operator::REAL_DIV) {
-    if (left_type != ValueAST::ValueType::REAL ||
-        right_type != ValueAST::ValueType::REAL) {
-      error("type of left expression or right expression is not real!");
+        right_type != ValueAST::ValueType::SET) {
+      error("IN needs an integer and a set!");
     }
+    return op->wrap_with_type(ValueAST::ValueType::BOOLEAN);
+  }
+  if (left_type == ValueAST::ValueType::SET &&
+      right_type == ValueAST::ValueType::SET) {
+    return set_operation(op);
+  }
+
+  // an INTEGER or INT64 operand of a REAL one, and both operands of /, are
+  // promoted to REAL, and an INTEGER operand of an INT64 one is widened, so
+  // that every operation has operands of one type
+  const auto real = ValueAST::ValueType::REAL;
+  if ((is_integer(left_type) || left_type == real) &&
+      (is_integer(right_type) || right_type == real) &&
+      (left_type == real || right_type == real ||
+       op->op() == Operator::REAL_DIV)) {
+    op->set_left(convert(op->left_release(), left_type, real));
+    op->set_right(convert(op->right_release(), right_type, real));
+    left_type = right_type = real;
+  } else if (is_integer(left_type) && is_integer(right_type) &&
+             left_type != right_type) {
+    const auto type = ValueAST::ValueType::INT64;
+    op->set_left(convert(op->left_release(), left_type, type));
+    op->set_right(convert(op->right_release(), right_type, type));
+    left_type = right_type = type;
+  }
+
+  switch (op->op()) {
+    case Operator::INTEGER_DIV:
+      if (!is_integer(left_type) || left_type != right_type) {
+        error("type of left expression or right expression is not integer!");
+      }
+      break;
+    case Operator::REAL_DIV:
+      if (left_type != ValueAST::ValueType::REAL ||
+          right_type != ValueAST::ValueType::REAL) {
+        error("type of left expression or right expression is not real!");
+      }
+      break;
+    case Operator::AND:
+    case Operator::OR:
+      if (left_type != ValueAST::ValueType::BOOLEAN ||
+          right_type != ValueAST::ValueType::BOOLEAN) {
+        error("type of left expression or right expression is not boolean!");
+      }
+      break;
+    default:
+      if (left_type != right_type) {
+        error(
+            "type of left expression is not equal to type of right "
+            "expression!");
+      }
+      break;
   }
 
-  return op->wrap_with_type(left_type);
+  switch (op->op()) {
+    case Operator::PLUS:
+    case Operator::MINUS:
+    case Operator::MULTIPLY:
+      // + also concatenates strings
+      if (left_type == ValueAST::ValueType::BOOLEAN ||
+          left_type == ValueAST::ValueType::POINTER ||
+          (left_type == ValueAST::ValueType::STRING &&
+           op->op() != Operator::PLUS)) {
+        error("type of left expression or right expression is not a number!");
+      }
+      return op->wrap_with_type(left_type);
+    case Operator::INTEGER_DIV:
+    case Operator::REAL_DIV:
+      return op->wrap_with_type(left_type);
+    default:
+      // pointers are only compared for identity
+      if (left_type == ValueAST::ValueType::POINTER) {
+        if (op->op() != Operator::EQUAL && op->op() != Operator::NOT_EQUAL) {
+          error("operator is not defined on pointers!");
+        }
+        if (!compatible(pointer(op->left()), pointer(op->right()))) {
+          error(
+              "type of left expression is not equal to type of right "
+              "expression!");
+        }
+      }
+      return op->wrap_with_type(ValueAST::ValueType::BOOLEAN);
+  }
+}
+
+std::pair<ValueAST*, ValueAST::ValueType> SemanticAnalyzer::set_operation(
+    BinaryOperation* op) {
+  using Operator = BinaryOperation::Operator;
+  auto type = ValueAST::ValueType::BOOLEAN;
+  switch (op->op()) {
+    case Operator::PLUS:
+      op->set_op(Operator::UNION);
+      type = ValueAST::ValueType::SET;
+      break;
+    case Operator::MULTIPLY:
+      op->set_op(Operator::INTERSECTION);
+      type = ValueAST::ValueType::SET;
+      break;
+    case Operator::MINUS:
+      op->set_op(Operator::DIFFERENCE);
+      type = ValueAST::ValueType::SET;
+      break;
+    case Operator::EQUAL:
+      op->set_op(Operator::SET_EQUAL);
+      break;
+    case Operator::NOT_EQUAL:
+      op->set_op(Operator::SET_NOT_EQUAL);
+      break;
+    case Operator::LESS_EQUAL:
+      op->set_op(Operator::SUBSET);
+      break;
+    case Operator::GREATER_EQUAL:
+      op->set_op(Operator::SUPERSET);
+      break;
+    default:
+      error("operator is not defined on sets!");
+  }
+  return op->wrap_with_type(type);
 }
 
 std::pair<ValueAST*, ValueAST::ValueType> SemanticAnalyzer::check(
     UnaryOperation* op) {
+  // EOF takes the FILE variable itself, which no other expression may
+  if (op->op() == UnaryOperation::Operator::END_OF_FILE) {
+    const auto variable = static_cast<Variable*>(op->expr_release());
+    const auto symbol = symbol_table_.lookup(variable->value());
+    if (symbol == nullptr || symbol->kind != T::Symbol::Kind::VARIABLE ||
+        select(variable, *symbol) != ValueAST::ValueType::FILE) {
+      error("EOF needs a file!");
+    }
+    op->set_expr(variable->wrap_with_type(ValueAST::ValueType::FILE).first);
+    delete variable;
+    return op->wrap_with_type(ValueAST::ValueType::BOOLEAN);
+  }
+
   const auto expr = op->expr_release();
   const auto [expr_typed, expr_type] = expr->accept(this);
   delete expr;
@@ -206,9 +1105,73 @@ std::pair<ValueAST*, ValueAST::ValueType> SemanticAnalyzer::check(
 
   assert(expr_typed->type_checked());
 
+  // the size of a set cannot overflow
+  if (op->op() == UnaryOperation::Operator::CARD) {
+    if (expr_type != ValueAST::ValueType::SET) {
+      error("CARD needs a set!");
+    }
+    op->set_checked(false);
+    return op->wrap_with_type(ValueAST::ValueType::INTEGER);
+  }
+
+  if ((op->op() == UnaryOperation::Operator::NOT) !=
+          (expr_type == ValueAST::ValueType::BOOLEAN) ||
+      expr_type == ValueAST::ValueType::ARRAY ||
+      expr_type == ValueAST::ValueType::SET ||
+      expr_type == ValueAST::ValueType::RECORD ||
+      expr_type == ValueAST::ValueType::STRING ||
+      expr_type == ValueAST::ValueType::POINTER) {
+    error("type of expression does not match its operator!");
+  }
+
   return op->wrap_with_type(expr_type);
 }
 
+// a set of constants is built once, here
+std::pair<ValueAST*, ValueAST::ValueType> SemanticAnalyzer::check(
+    SetConstructor* constructor) {
+  bool constant = true;
+  Set members;
+  const auto member = [&](ValueAST* expr) {
+    const auto [typed, type] = expr->accept(this);
+    if (type != ValueAST::ValueType::INTEGER) {
+      error("member of a set is not integer!");
+    }
+    const auto number = dynamic_cast<const Number*>(typed);
+    constant = constant && number != nullptr;
+    return std::pair{typed, number != nullptr
+                                ? std::get<int>(number->value())
+                                : 0};
+  };
+
+  for (size_t i = 0; i < constructor->elements().size(); ++i) {
+    const auto low = constructor->low_release(i);
+    const auto [low_typed, low_value] = member(low);
+    delete low;
+    constructor->set_low(i, low_typed);
+    int high_value = low_value;
+    if (constructor->elements()[i].high != nullptr) {
+      const auto high = constructor->high_release(i);
+      const auto [high_typed, value] = member(high);
+      delete high;
+      constructor->set_high(i, high_typed);
+      high_value = value;
+    }
+    if (constant && low_value <= high_value) {
+      if (low_value < 0 || high_value > Set::MAX_MEMBER) {
+        error("set member " +
+              std::to_string(low_value < 0 ? low_value : high_value) +
+              " is out of range!");
+      }
+      members.insert(low_value, high_value);
+    }
+  }
+  if (constant) {
+    constructor->set_constant(members);
+  }
+  return constructor->wrap_with_type(ValueAST::ValueType::SET);
+}
+
 std::pair<ValueAST*, ValueAST::ValueType> SemanticAnalyzer::check(
     Number* number) {
 
@@ -224,4 +1187,224 @@ std::pair<ValueAST*, ValueAST::ValueType> SemanticAnalyzer::check(
   return number->wrap_with_type(type);
 }
 
+// only scalars and strings can be written, in a width and a REAL with a
+// number of decimals
+void SemanticAnalyzer::check(Write* write) {
+  if (DEBUG) {
+    indent() << "check write" << std::endl;
+  }
+  const auto integer = [&](std::unique_ptr<ValueAST>* expr, size_t i,
+                           const std::string& what) {
+    const auto [typed, type] = (*expr)->accept(this);
+    expr->reset(typed);
+    if (type != ValueAST::ValueType::INTEGER) {
+      error(what + " of argument " + std::to_string(i + 1) +
+            " of WRITE is not integer!");
+    }
+  };
+
+  for (size_t i = 0; i < write->arguments().size(); ++i) {
+    auto& argument = write->argument(i);
+    const auto [typed, type] = argument.value->accept(this);
+    argument.value.reset(typed);
+    if (type != ValueAST::ValueType::INTEGER &&
+        type != ValueAST::ValueType::INT64 &&
+        type != ValueAST::ValueType::REAL &&
+        type != ValueAST::ValueType::BOOLEAN &&
+        type != ValueAST::ValueType::STRING) {
+      error("argument " + std::to_string(i + 1) + " of WRITE is of type " +
+            ValueAST::type_to_string(type) + ", which cannot be written!");
+    }
+    argument.type = type;
+    if (argument.width != nullptr) {
+      integer(&argument.width, i, "width");
+    }
+    if (argument.precision != nullptr) {
+      if (type != ValueAST::ValueType::REAL) {
+        error("argument " + std::to_string(i + 1) +
+              " of WRITE has decimals but is not real!");
+      }
+      integer(&argument.precision, i, "number of decimals");
+    }
+  }
+}
+
+// READ takes variables of the numeric types from the text input; from a
+// FILE it takes variables of its element type, and whole arrays of them
+void SemanticAnalyzer::check(Read* read) {
+  if (DEBUG) {
+    indent() << "check read" << std::endl;
+  }
+  const auto& variables = read->variables();
+  std::shared_ptr<const FileType> file;
+  std::vector<ValueAST::ValueType> types;
+  for (size_t i = 0; i < variables.size(); ++i) {
+    const auto variable = variables[i].get();
+    const auto symbol = symbol_table_.lookup(variable->value());
+    if (symbol == nullptr || symbol->kind != T::Symbol::Kind::VARIABLE) {
+      error("variable " + variable->value() + " has not been declared!");
+    }
+    const auto type = select(variable, *symbol);
+    types.push_back(type);
+    if (i == 0 && type == ValueAST::ValueType::FILE) {
+      file = symbol->file;
+      continue;
+    }
+
+    if (file == nullptr) {
+      if (type != ValueAST::ValueType::INTEGER &&
+          type != ValueAST::ValueType::INT64 &&
+          type != ValueAST::ValueType::REAL) {
+        error("variable " + variable->value() +
+              " cannot be read from text!");
+      }
+      continue;
+    }
+    const auto& array = variable->array();
+    bool matches;
+    if (type == ValueAST::ValueType::ARRAY) {
+      // a packed array keeps the fields of its records apart
+      matches = file->record != nullptr
+                    ? array->record != nullptr && !array->packed &&
+                          *array->record == *file->record
+                    : array->record == nullptr &&
+                          array->element == file->element &&
+                          !array->range.has_value();
+    } else if (type == ValueAST::ValueType::RECORD) {
+      matches = file->record != nullptr &&
+                *variable->record() == *file->record;
+    } else {
+      matches = file->record == nullptr && type == file->element;
+    }
+    if (!matches) {
+      error("variable " + variable->value() +
+            " does not hold elements of file " + variables[0]->value() +
+            "!");
+    }
+  }
+  if (file != nullptr && read->line()) {
+    error("READLN cannot read file " + variables[0]->value() + "!");
+  }
+  read->set_types(file != nullptr, std::move(types));
+}
+
+void SemanticAnalyzer::check(Reset* reset) {
+  if (DEBUG) {
+    indent() << "check reset" << std::endl;
+  }
+  const auto variable = reset->variable();
+  const auto symbol = symbol_table_.lookup(variable->value());
+  if (symbol == nullptr || symbol->kind != T::Symbol::Kind::VARIABLE) {
+    error("variable " + variable->value() + " has not been declared!");
+  }
+  if (select(variable, *symbol) != ValueAST::ValueType::FILE) {
+    error("variable " + variable->value() + " is not a file!");
+  }
+  const auto path = reset->path_release();
+  const auto [path_typed, path_type] = path->accept(this);
+  delete path;
+  reset->set_path(path_typed);
+  if (path_type != ValueAST::ValueType::STRING) {
+    error("path of file " + variable->value() + " is not a string!");
+  }
+  reset->set_element_size(symbol->file->element_size());
+}
+
+void SemanticAnalyzer::check(HeapOperation* operation) {
+  if (DEBUG) {
+    indent() << "check heap operation" << std::endl;
+  }
+  const auto variable = operation->variable();
+  const auto symbol = symbol_table_.lookup(variable->value());
+  if (symbol == nullptr || symbol->kind != T::Symbol::Kind::VARIABLE) {
+    error("variable " + variable->value() + " has not been declared!");
+  }
+  if (select(variable, *symbol) != ValueAST::ValueType::POINTER) {
+    error("variable " + variable->value() + " is not a pointer!");
+  }
+  const auto target = variable->pointer()->target();
+  const auto& record = target->record();
+  operation->set_target(
+      record != nullptr
+          ? record->size
+          : scalar_size(target->value(), target->range(), target->packed()),
+      record, target->range());
+}
+
+void SemanticAnalyzer::check(Case* statement) {
+  if (DEBUG) {
+    indent() << "check case" << std::endl;
+  }
+  depth_++;
+
+  const auto selector = statement->selector_release();
+  const auto [selector_typed, selector_type] = selector->accept(this);
+  delete selector;
+  statement->set_selector(selector_typed);
+  if (!is_integer(selector_type) &&
+      selector_type != ValueAST::ValueType::BOOLEAN) {
+    error("selector of CASE is not ordinal!");
+  }
+
+  std::vector<Case::Range> ranges;
+  const auto& branches = statement->branches();
+  for (size_t i = 0; i < branches.size(); ++i) {
+    for (const auto& label : branches[i].labels) {
+      // INTEGER labels select INT64 values, INT64 ones need an INT64
+      if (label.type != selector_type &&
+          !(label.type == ValueAST::ValueType::INTEGER &&
+            selector_type == ValueAST::ValueType::INT64)) {
+        error("CASE label does not match the type of the selector!");
+      }
+      if (label.low > label.high) {
+        error("CASE label range " + std::to_string(label.low) + ".." +
+              std::to_string(label.high) + " is empty!");
+      }
+      ranges.push_back({label.low, label.high, static_cast<int>(i)});
+    }
+    branches[i].statement->accept(this);
+  }
+  if (statement->else_statement() != nullptr) {
+    statement->else_statement()->accept(this);
+  }
+
+  std::sort(ranges.begin(), ranges.end(),
+            [](const auto& a, const auto& b) { return a.low < b.low; });
+  for (size_t i = 1; i < ranges.size(); ++i) {
+    if (ranges[i].low <= ranges[i - 1].high) {
+      error("CASE label " + std::to_string(ranges[i].low) +
+            " appears more than once!");
+    }
+  }
+
+  // the labels of INT64 selectors may span more than an int64_t holds, but
+  // never more than a uint64_t
+  const auto distance = [](int64_t low, int64_t high) {
+    return static_cast<uint64_t>(high) - static_cast<uint64_t>(low);
+  };
+  const uint64_t span = distance(ranges.front().low, ranges.back().high);
+  uint64_t labels = 0;
+  if (span < CASE_TABLE_SIZE) {
+    for (const auto& range : ranges) {
+      labels += distance(range.low, range.high) + 1;
+    }
+  }
+  if (ranges.size() <= CASE_LINEAR_RANGES) {
+    statement->set_dispatch(Case::Dispatch::LINEAR, std::move(ranges), {});
+  } else if (span < CASE_TABLE_SIZE && 2 * labels >= span + 1) {
+    std::vector<int> table(span + 1, -1);
+    for (const auto& range : ranges) {
+      std::fill(table.begin() + (range.low - ranges.front().low),
+                table.begin() + (range.high - ranges.front().low + 1),
+                range.branch);
+    }
+    statement->set_dispatch(Case::Dispatch::TABLE, std::move(ranges),
+                            std::move(table));
+  } else {
+    statement->set_dispatch(Case::Dispatch::SEARCH, std::move(ranges), {});
+  }
+
+  depth_--;
+}
+
 }  // namespace Pascal
@@ -3,10 +3,17 @@
 #pragma once
 
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 #include "ast.h"
+#include "compilation_cache.h"
+#include "host_function.h"
 #include "symbol_table.h"
+#include "thread_pool.h"
 
 namespace Pascal {
 
@@ -15,17 +22,137 @@ class SemanticAnalyzer : public Checker {
   T::SymbolTable symbol_table_;
   void error(const std::string& msg);
 
+  // sibling procedures are checked concurrently when there are at least
+  // this many of them and a pool is set
+  static constexpr size_t PARALLEL_PROCEDURES = 16;
+  ThreadPool* pool_ = nullptr;
+
+  // CASE dispatch: up to this many label ranges are compared one by one;
+  // more use a jump table when it spans at most CASE_TABLE_SIZE values of
+  // which at least half are labels, and a binary search otherwise
+  static constexpr size_t CASE_LINEAR_RANGES = 4;
+  static constexpr uint64_t CASE_TABLE_SIZE = 4096;
+
+  // pre-parsed procedures are checked when first referenced, against a
+  // snapshot of the scopes they were declared in; shared by every analyzer
+  // working on the same program
+  struct Deferred {
+    std::shared_ptr<const T::SymbolTable> scope;
+    uint64_t scope_hash;
+    int depth;
+    // the first reference parses and checks the body, later ones only
+    // need the declaration
+    bool claimed;
+  };
+  struct DeferredProcedures {
+    // guards procedures only, never held while a body is analyzed
+    std::mutex mutex;
+    std::unordered_map<ProcedureDeclaration*, Deferred> procedures;
+    CompilationCache* cache = nullptr;
+    bool optimize = true;
+    const HostFunctions* host = nullptr;
+  };
+  std::shared_ptr<DeferredProcedures> deferred_ =
+      std::make_shared<DeferredProcedures>();
+
+  // checks one procedure on top of a snapshot of the enclosing scopes
+  SemanticAnalyzer(const T::SymbolTable* enclosing,
+                   std::shared_ptr<DeferredProcedures> deferred,
+                   std::ostream* out, int depth);
+
+  // names of procedures declared outside the analyzed body that it calls
+  std::vector<std::string> external_calls_;
+
+  void check_procedures_parallel(Block*);
+
+  void defer(Block*);
+
+  // parse and check a pre-parsed procedure unless that already happened
+  void analyze_deferred(ProcedureDeclaration*);
+
+  // resolve a procedure or function call and check its arguments
+  template <class Call>
+  const ProcedureDeclaration* check_call(Call* call, bool function);
+
+  // the host function a call of name not declared in the program calls,
+  // nullptr if there is none
+  const HostFunction* host_function(const std::string& name) const;
+
+  // check the arguments of a call of a host function like those of value
+  // parameters
+  std::pair<ValueAST*, ValueAST::ValueType> check_host_call(
+      FunctionCall* call, const HostFunction* function);
+
+  // resolve a variable declared as symbol and check its array indices;
+  // returns the type of what it selects
+  ValueAST::ValueType select(Variable* variable, const T::Symbol& symbol);
+
+  // the element or field a variable selects before any dereference
+  ValueAST::ValueType select_element(Variable* variable,
+                                     const T::Symbol& symbol);
+
+  // what the dereferences of a variable select from a value of type
+  ValueAST::ValueType dereference(Variable* variable,
+                                  ValueAST::ValueType type);
+
+  // the target of a checked POINTER expression, nullptr for NIL
+  const PointerType* pointer(const ValueAST* expr) const;
+
+  // NIL is a pointer to anything
+  static bool compatible(const PointerType* left, const PointerType* right);
+
+  // a checked expr of type from, INTEGER or INT64, as one of type to,
+  // INTEGER, INT64 or REAL; constants are converted here, other expressions
+  // get a CONVERT
+  ValueAST* convert(ValueAST* expr, ValueAST::ValueType from,
+                    ValueAST::ValueType to);
+
+  // replace the operator of a binary operation on two sets by its set
+  // counterpart
+  std::pair<ValueAST*, ValueAST::ValueType> set_operation(BinaryOperation* op);
+
+  // check the condition of an IF, WHILE or REPEAT statement
+  template <class Statement>
+  void check_condition(Statement* statement, const std::string& name);
+
+  // mark the calls in tail position of a body that can reuse its frame
+  void mark_tail_calls(NonValueAST* statement,
+                       const ProcedureDeclaration* procedure_decl);
+
+  bool reuses_frame(int callee_level,
+                    const std::vector<std::unique_ptr<ValueAST>>& arguments,
+                    const ProcedureDeclaration* callee) const;
+
   // debug usage
   int depth_ = 0;
+  std::ostream* out_ = &std::cout;
   std::ostream& indent() const;
 
  public:
+  SemanticAnalyzer() = default;
+
+  void set_thread_pool(ThreadPool* pool) { pool_ = pool; }
+
+  // reuse checked bodies of pre-parsed procedures across analyses
+  void set_cache(CompilationCache* cache) { deferred_->cache = cache; }
+
+  // the host functions calls may resolve to; they have to outlive the
+  // checked program
+  void set_host_functions(const HostFunctions* functions) {
+    deferred_->host = functions;
+  }
+
+  // run the Optimizer over every checked block, on by default
+  void set_optimize(bool optimize) { deferred_->optimize = optimize; }
+
   void analyze(Program*);
 
   std::pair<ValueAST*, ValueAST::ValueType> check(BinaryOperation*) override;
   std::pair<ValueAST*, ValueAST::ValueType> check(UnaryOperation*) override;
   std::pair<ValueAST*, ValueAST::ValueType> check(Number*) override;
   std::pair<ValueAST*, ValueAST::ValueType> check(Variable*) override;
+  std::pair<ValueAST*, ValueAST::ValueType> check(FunctionCall*) override;
+  std::pair<ValueAST*, ValueAST::ValueType> check(SetConstructor*) override;
   void check(Compound*) override;
   void check(Assign*) override;
   void check(Program*) override;
@@ -33,6 +160,17 @@ class SemanticAnalyzer : public Checker {
   void check(VariableDeclaration*) override;
   ValueAST::ValueType check(Type*) override;
   void check(ProcedureDeclaration*) override;
+  void check(Parameter*) override;
+  void check(ProcedureCall*) override;
+  void check(If*) override;
+  void check(While*) override;
+  void check(Repeat*) override;
+  void check(For*) override;
+  void check(Case*) override;
+  void check(HeapOperation*) override;
+  void check(Write*) override;
+  void check(Read*) override;
+  void check(Reset*) override;
 };
 
 }  // namespace Pascal
@@ -0,0 +1,86 @@
+// Copyright 2023 Zhu Junhui
+
+#include "string_value.h"
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_set>
+
+namespace Pascal {
+
+namespace {
+
+// the smallest buffer a concatenation starts
+constexpr size_t MIN_CAPACITY = 64;
+
+// texts of long literals; a node never moves, so neither do its characters
+const char* intern(std::string_view text) {
+  static std::mutex mutex;
+  static std::unordered_set<std::string> texts;
+  std::lock_guard lock(mutex);
+  return texts.emplace(text).first->data();
+}
+
+}  // namespace
+
+String String::literal(std::string_view text) {
+  String result;
+  result.length = static_cast<uint32_t>(text.size());
+  if (text.size() <= INLINE) {
+    std::memcpy(result.chars, text.data(), text.size());
+  } else {
+    result.storage = Storage::INTERNED;
+    result.heap = {intern(text), nullptr};
+  }
+  return result;
+}
+
+std::string String::to_string() const {
+  std::string text = "'";
+  for (const char c : view()) {
+    text += c;
+    if (c == '\'') {
+      text += c;
+    }
+  }
+  return text + "'";
+}
+
+String StringHeap::concat(const String& left, const String& right) {
+  const size_t length = size_t{left.length} + right.length;
+  if (length > UINT32_MAX) {
+    throw std::runtime_error("string is too long");
+  }
+  String result;
+  result.length = static_cast<uint32_t>(length);
+  if (length <= String::INLINE) {
+    std::memcpy(result.chars, left.view().data(), left.length);
+    std::memcpy(result.chars + left.length, right.view().data(),
+                right.length);
+    return result;
+  }
+
+  // the right operand may be in the same buffer, but only before its end
+  result.storage = String::Storage::BUILT;
+  auto buffer = left.storage == String::Storage::BUILT ? left.heap.buffer
+                                                       : nullptr;
+  if (buffer != nullptr && buffer->size == left.length &&
+      buffer->capacity - buffer->size >= right.length) {
+    std::memcpy(buffer->chars.get() + buffer->size, right.view().data(),
+                right.length);
+    buffer->size = length;
+    result.heap = {buffer->chars.get(), buffer};
+    return result;
+  }
+
+  const size_t capacity = std::max(MIN_CAPACITY, 2 * length);
+  buffer = &buffers_.emplace_back(String::Buffer{
+      std::make_unique<char[]>(capacity), length, capacity});
+  std::memcpy(buffer->chars.get(), left.view().data(), left.length);
+  std::memcpy(buffer->chars.get() + left.length, right.view().data(),
+              right.length);
+  result.heap = {buffer->chars.get(), buffer};
+  return result;
+}
+
+}  // namespace Pascal
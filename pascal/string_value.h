@@ -0,0 +1,91 @@
+// Copyright 2023 Zhu Junhui
+
+#pragma once
+
+#include <compare>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace Pascal {
+
+// A STRING value. It is copied like a scalar, so that assigning one or
+// passing it through a ValueAST::Value never copies its characters: up to
+// INLINE characters are stored in the value itself, longer ones in storage
+// the value only points to. That is either the text of a literal, interned
+// for the life of the process, or a buffer of the StringHeap of a run.
+struct String {
+  static constexpr uint32_t INLINE = 16;
+
+  // a buffer of the StringHeap; the strings built in it start at chars,
+  // and only ever get characters appended past their end
+  struct Buffer {
+    std::unique_ptr<char[]> chars;
+    size_t size;
+    size_t capacity;
+  };
+
+  enum class Storage : uint8_t { INLINE, INTERNED, BUILT };
+
+  uint32_t length = 0;
+  Storage storage = Storage::INLINE;
+  union {
+    char chars[INLINE];
+    struct {
+      const char* data;
+      Buffer* buffer;
+    } heap;
+  };
+
+  String() : chars{} {}
+
+  // a short text is stored inline, a longer one is interned
+  static String literal(std::string_view text);
+
+  std::string_view view() const {
+    return {storage == Storage::INLINE ? chars : heap.data, length};
+  }
+
+  // interned texts are equal if they are the same text, inline ones are
+  // compared as a whole, padding included
+  bool operator==(const String& other) const {
+    if (length != other.length) {
+      return false;
+    }
+    if (storage == Storage::INTERNED && other.storage == Storage::INTERNED) {
+      return heap.data == other.heap.data;
+    }
+    if (storage == Storage::INLINE && other.storage == Storage::INLINE) {
+      return std::memcmp(chars, other.chars, INLINE) == 0;
+    }
+    return view() == other.view();
+  }
+
+  std::strong_ordering operator<=>(const String& other) const {
+    return view() <=> other.view();
+  }
+
+  // e.g. 'it''s'
+  std::string to_string() const;
+};
+
+// The buffers the STRING values of a run are built in. Concatenation
+// appends to the buffer of its left operand when that operand ends where
+// the buffer does, which it does when a loop keeps appending to the same
+// variable, and otherwise starts a buffer with room to grow; building a
+// string piece by piece is linear in its length. Buffers are kept until
+// the heap is cleared, since any value may still point into them.
+class StringHeap {
+ private:
+  std::deque<String::Buffer> buffers_;
+
+ public:
+  String concat(const String& left, const String& right);
+
+  void clear() { buffers_.clear(); }
+};
+
+}  // namespace Pascal
@@ -1,147 +1,375 @@
 // Copyright 2023 Zhu Junhui
 
 #include "symbol_table.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
 
 namespace Pascal {
 
 namespace T {
 
-bool Scope::define(const std::string& name, ValueAST::ValueType type) {
-  if (symbols_.find(name) != symbols_.end()) {
-    return false;
-  }
-  symbols_[name] = type;
-  return true;
+SymbolTable::SymbolTable() : index_(64, EMPTY) {
+  scopes_.reserve(16);
 }
 
-Scope::Scope(const std::string& block_name,
-             std::shared_ptr<Scope> enclosing_scope)
-    : block_name_(block_name), enclosing_scope_(enclosing_scope) {}
+SymbolTable::SymbolTable(const SymbolTable* enclosing) : SymbolTable() {
+  enclosing_ = enclosing;
+  base_level_ =
+      enclosing->base_level_ + static_cast<int>(enclosing->scopes_.size());
+}
 
-std::optional<ValueAST::ValueType> Scope::get_type(
-    const std::string& name) const {
-  if (auto it = symbols_.find(name); it != symbols_.end()) {
-    return it->second;
+// bucket holding name, or the empty bucket where it would go
+size_t SymbolTable::find_bucket(std::string_view name, size_t hash) const {
+  const size_t mask = index_.size() - 1;
+  size_t bucket = hash & mask;
+  while (index_[bucket] != EMPTY) {
+    const auto& entry = entries_[index_[bucket]];
+    if (entry.hash == hash && entry.name == name) {
+      break;
+    }
+    bucket = (bucket + 1) & mask;
   }
-  return std::nullopt;
+  return bucket;
 }
 
-bool Scope::is_defined(const std::string& name) const {
-  if (auto it = symbols_.find(name); it != symbols_.end()) {
-    return true;
+// backward shift deletion keeps probe sequences intact without tombstones
+void SymbolTable::erase_bucket(size_t bucket) {
+  const size_t mask = index_.size() - 1;
+  size_t hole = bucket;
+  size_t next = (hole + 1) & mask;
+  while (index_[next] != EMPTY) {
+    const size_t home = entries_[index_[next]].hash & mask;
+    // move next into the hole unless its home lies cyclically in (hole, next]
+    const bool stays = hole <= next ? (hole < home && home <= next)
+                                    : (hole < home || home <= next);
+    if (!stays) {
+      index_[hole] = index_[next];
+      hole = next;
+    }
+    next = (next + 1) & mask;
   }
-  return false;
+  index_[hole] = EMPTY;
+  live_--;
 }
 
-std::shared_ptr<Scope> Scope::enclosing_scope() const {
-  return enclosing_scope_;
+void SymbolTable::grow() {
+  std::vector<int> old(index_.size() * 2, EMPTY);
+  old.swap(index_);
+  const size_t mask = index_.size() - 1;
+  for (const auto entry : old) {
+    if (entry == EMPTY) {
+      continue;
+    }
+    size_t bucket = entries_[entry].hash & mask;
+    while (index_[bucket] != EMPTY) {
+      bucket = (bucket + 1) & mask;
+    }
+    index_[bucket] = entry;
+  }
 }
 
-SymbolTable::SymbolTable() {
-  current_scope_ = nullptr;
-}
+void SymbolTable::push(const Entry& entry) {
+  if ((live_ + 1) * 2 > index_.size()) {
+    grow();
+  }
 
-bool SymbolTable::define(const std::string& name, ValueAST::ValueType type) {
-  if (current_scope_ == nullptr) {
-    return false;
+  const size_t bucket = find_bucket(entry.name, entry.hash);
+  const int shadowed = index_[bucket];
+  if (shadowed == EMPTY) {
+    live_++;
   }
-  return current_scope_->define(name, type);
+  index_[bucket] = static_cast<int>(entries_.size());
+  entries_.push_back(entry);
+  entries_.back().shadowed = shadowed;
 }
 
-std::optional<ValueAST::ValueType> SymbolTable::get_type(
-    const std::string& name) const {
-  if (current_scope_ == nullptr) {
-    return std::nullopt;
+const Symbol* SymbolTable::define(std::string_view name,
+                                  const Symbol& symbol) {
+  const size_t hash = std::hash<std::string_view>{}(name);
+  const int existing = index_[find_bucket(name, hash)];
+  if (existing != EMPTY &&
+      static_cast<size_t>(existing) >= scopes_.back().first_entry) {
+    return nullptr;
   }
-  return current_scope_->get_type(name);
+
+  push(Entry{name, hash, symbol, EMPTY});
+  return &entries_.back().symbol;
 }
 
-bool SymbolTable::is_defined(const std::string& name, bool local) const {
-  if (current_scope_ == nullptr) {
-    return false;
+const Symbol* SymbolTable::define(std::string_view name,
+                                  ValueAST::ValueType type, bool by_reference,
+                                  std::shared_ptr<const ArrayType> array,
+                                  const std::optional<Interval>& range,
+                                  std::shared_ptr<const RecordType> record,
+                                  std::shared_ptr<const PointerType> pointer,
+                                  std::shared_ptr<const FileType> file) {
+  if (scopes_.empty()) {
+    return nullptr;
   }
-  if (local) {
-    return current_scope_->is_defined(name);
-  }
-  const Scope* scope = current_scope_.get();
-  while (scope != nullptr) {
-    if (scope->is_defined(name)) {
-      return true;
-    }
-    scope = scope->enclosing_scope().get();
-  }
-  return false;
-}
 
-void SymbolTable::enter_scope(const std::string& name) {
-  current_scope_ = std::make_shared<Scope>(name, current_scope_);
+  const auto symbol = define(
+      name, Symbol{Symbol::Kind::VARIABLE, type, level(),
+                   scopes_.back().next_slot, by_reference, nullptr,
+                   std::move(array), range, std::move(record),
+                   std::move(pointer), std::move(file)});
+  if (symbol != nullptr) {
+    scopes_.back().next_slot++;
+  }
+  return symbol;
 }
 
-void SymbolTable::exit_scope() {
-  if (current_scope_ == nullptr) {
-    return;
+const Symbol* SymbolTable::define_procedure(std::string_view name,
+                                            ProcedureDeclaration* procedure,
+                                            int index) {
+  if (scopes_.empty()) {
+    return nullptr;
   }
 
-  current_scope_ = current_scope_->enclosing_scope();
+  return define(name, Symbol{Symbol::Kind::PROCEDURE, {}, level(), index,
+                             false, procedure});
 }
-}  // namespace T
 
-namespace V {
+void SymbolTable::flatten_into(SymbolTable* table) const {
+  if (enclosing_ != nullptr) {
+    enclosing_->flatten_into(table);
+  }
+  for (size_t i = 0; i < scopes_.size(); ++i) {
+    const auto first = scopes_[i].first_entry;
+    const auto last =
+        i + 1 < scopes_.size() ? scopes_[i + 1].first_entry : entries_.size();
+    table->scopes_.push_back(Marker{table->entries_.size(),
+                                    scopes_[i].next_slot, scopes_[i].owner});
+    for (auto entry = first; entry < last; ++entry) {
+      table->push(entries_[entry]);
+    }
+  }
+}
 
-Scope::Scope(const std::string& block_name,
-             std::shared_ptr<Scope> enclosing_scope)
-    : block_name_(block_name), enclosing_scope_(enclosing_scope) {}
+uint64_t SymbolTable::fingerprint() const {
+  uint64_t seed = enclosing_ != nullptr ? enclosing_->fingerprint() : 0;
+  for (const auto& scope : scopes_) {
+    seed = hash_combine(seed, scope.first_entry);
+    seed = hash_combine(seed, scope.next_slot);
+    // assignments to a function's name resolve against the owner
+    if (scope.owner != nullptr) {
+      seed = hash_combine(seed, std::hash<std::string>{}(scope.owner->name()));
+    }
+  }
+  for (const auto& entry : entries_) {
+    const auto& symbol = entry.symbol;
+    seed = hash_combine(seed, entry.hash);
+    seed = hash_combine(seed, static_cast<uint64_t>(symbol.kind));
+    seed = hash_combine(seed, static_cast<uint64_t>(symbol.type));
+    seed = hash_combine(seed, symbol.level);
+    seed = hash_combine(seed, symbol.slot);
+    seed = hash_combine(seed, symbol.by_reference);
+    if (symbol.array != nullptr) {
+      seed = hash_combine(seed, std::hash<std::string>{}(
+                                    symbol.array->to_string()));
+    }
+    if (symbol.record != nullptr) {
+      seed = hash_combine(seed, std::hash<std::string>{}(
+                                    symbol.record->to_string()));
+    }
+    if (symbol.pointer != nullptr) {
+      seed = hash_combine(seed, std::hash<std::string>{}(
+                                    symbol.pointer->to_string()));
+    }
+    if (symbol.range.has_value()) {
+      seed = hash_combine(seed, symbol.range->low);
+      seed = hash_combine(seed, symbol.range->high);
+    }
+    if (symbol.kind == Symbol::Kind::PROCEDURE) {
+      // callers depend on the signature, not on the body
+      if (symbol.procedure->is_function()) {
+        const auto type = symbol.procedure->return_type();
+        seed = hash_combine(seed, static_cast<uint64_t>(type->value()) + 1);
+        seed = hash_combine(seed, std::hash<std::string>{}(type->to_string()));
+      }
+      for (const auto& parameter : symbol.procedure->parameters()) {
+        const auto type = parameter->type();
+        seed = hash_combine(seed, static_cast<uint64_t>(type->value()));
+        seed = hash_combine(seed, std::hash<std::string>{}(type->to_string()));
+        seed = hash_combine(seed, parameter->by_reference());
+      }
+    }
+  }
+  return seed;
+}
 
-std::shared_ptr<Scope> Scope::enclosing_scope() const {
-  return enclosing_scope_;
+std::shared_ptr<const SymbolTable> SymbolTable::snapshot() const {
+  auto table = std::make_shared<SymbolTable>();
+  flatten_into(table.get());
+  return table;
 }
 
-void Scope::define(const std::string& name, int value) {
-  integer_map_[name] = value;
+const Symbol* SymbolTable::lookup(std::string_view name) const {
+  return lookup(name, std::hash<std::string_view>{}(name));
 }
 
-void Scope::define(const std::string& name, double value) {
-  real_map_[name] = value;
+const Symbol* SymbolTable::lookup(std::string_view name, size_t hash) const {
+  const int entry = index_[find_bucket(name, hash)];
+  if (entry == EMPTY) {
+    return enclosing_ != nullptr ? enclosing_->lookup(name, hash) : nullptr;
+  }
+  return &entries_[entry].symbol;
 }
 
-int Scope::get_integer(const std::string& name) const {
-  return integer_map_.at(name);
+int SymbolTable::reserve_slot() {
+  return scopes_.back().next_slot++;
 }
 
-double Scope::get_real(const std::string& name) const {
-  return real_map_.at(name);
+int SymbolTable::frame_size() const {
+  if (scopes_.empty()) {
+    return 0;
+  }
+  return scopes_.back().next_slot;
 }
 
-SymbolTable::SymbolTable() {
-  current_scope_ = nullptr;
+const ProcedureDeclaration* SymbolTable::owner(int level) const {
+  if (level < base_level_) {
+    return enclosing_->owner(level);
+  }
+  return scopes_[level - base_level_].owner;
 }
 
-void SymbolTable::enter_scope(const std::string& name) {
-  current_scope_ = std::make_shared<Scope>(name, current_scope_);
+void SymbolTable::enter_scope(const std::string&,
+                              const ProcedureDeclaration* owner) {
+  scopes_.push_back(Marker{entries_.size(), 0, owner});
 }
 
 void SymbolTable::exit_scope() {
-  if (current_scope_ == nullptr) {
+  if (scopes_.empty()) {
     return;
   }
 
-  current_scope_ = current_scope_->enclosing_scope();
+  const size_t first = scopes_.back().first_entry;
+  while (entries_.size() > first) {
+    const auto& entry = entries_.back();
+    const size_t bucket = find_bucket(entry.name, entry.hash);
+    if (entry.shadowed != EMPTY) {
+      index_[bucket] = entry.shadowed;
+    } else {
+      erase_bucket(bucket);
+    }
+    entries_.pop_back();
+  }
+  scopes_.pop_back();
+}
+}  // namespace T
+
+namespace V {
+
+std::byte* ChunkedStack::grow(size_t bytes) {
+  // the chunks above the top hold nothing; one too small for the push is
+  // replaced with those after it
+  const size_t next = chunks_.empty() ? 0 : chunk_ + 1;
+  if (next < chunks_.size() && chunks_[next].size < bytes) {
+    for (size_t i = next; i < chunks_.size(); ++i) {
+      capacity_ -= chunks_[i].size;
+    }
+    chunks_.resize(next);
+  }
+  if (next == chunks_.size()) {
+    const size_t doubled = first_ << std::min<size_t>(next, 12);
+    const size_t size = std::max(
+        bytes, std::min(doubled, limit_ - std::min(limit_, capacity_)));
+    if (size > limit_ - std::min(limit_, capacity_)) {
+      throw std::runtime_error(full_);
+    }
+    std::byte* chunk;
+    try {
+      chunk = static_cast<std::byte*>(
+          ::operator new[](size, std::align_val_t{CACHE_LINE}));
+    } catch (const std::bad_alloc&) {
+      throw std::runtime_error(full_);
+    }
+    chunks_.push_back(Chunk{decltype(Chunk::bytes)(chunk), size});
+    capacity_ += size;
+  }
+  chunk_ = next;
+  top_ = bytes;
+  return chunks_[next].bytes.get();
+}
+
+SymbolTable::SymbolTable(size_t slots, size_t frames)
+    : slots_(size_t{1} << 15, slots * sizeof(Slot), "stack overflow"),
+      max_frames_(frames),
+      arena_(size_t{1} << 16, SIZE_MAX, "out of memory for arrays") {}
+
+Frame* SymbolTable::push_frame(const Block* block, int level) {
+  if (frame_top_ == max_frames_) {
+    throw std::runtime_error("stack overflow");
+  }
+  const size_t size = block->frame_size();
+  const auto slot_mark = slots_.mark();
+  const auto slots = reinterpret_cast<Slot*>(slots_.push(size * sizeof(Slot)));
+  std::fill_n(slots, size, Slot{});
+
+  if (frame_top_ == frames_.size()) {
+    frames_.emplace_back();
+  }
+  Frame* frame = &frames_[frame_top_++];
+  *frame =
+      Frame{slots, block, level, nullptr, nullptr, slot_mark, arena_.mark()};
+  return frame;
 }
 
-void SymbolTable::define(const std::string& name, int value) {
-  current_scope_->define(name, value);
+void SymbolTable::enter_frame(Frame* frame) {
+  const auto level = frame->level;
+  if (static_cast<int>(display_.size()) <= level) {
+    display_.resize(level + 1, nullptr);
+  }
+  frame->static_link = level > 0 ? display_[level - 1] : nullptr;
+  frame->saved_display = display_[level];
+  display_[level] = frame;
 }
 
-void SymbolTable::define(const std::string& name, double value) {
-  current_scope_->define(name, value);
+void SymbolTable::exit_frame() {
+  Frame* frame = &frames_[--frame_top_];
+  display_[frame->level] = frame->saved_display;
+  slots_.release(frame->slot_mark);
+  arena_.release(frame->arena_mark);
+}
+
+Frame* SymbolTable::replace_frame() {
+  const Frame* top = &frames_[frame_top_ - 1];
+  Frame* frame = &frames_[frame_top_ - 2];
+  display_[frame->level] = frame->saved_display;
+
+  // the moved frame has not allocated anything yet, the running one's
+  // arrays go with it; its slots move down to where the running one's
+  // start, unless they do not fit in that chunk and already are in the
+  // next one, where they stay
+  const size_t size = top->block->frame_size();
+  slots_.release(frame->slot_mark);
+  arena_.release(frame->arena_mark);
+  const auto slots = reinterpret_cast<Slot*>(slots_.push(size * sizeof(Slot)));
+  if (slots != top->slots) {
+    std::copy_n(top->slots, size, slots);
+  }
+  *frame = Frame{slots,   top->block,       top->level,       nullptr,
+                 nullptr, frame->slot_mark, frame->arena_mark};
+  frame_top_--;
+  return frame;
 }
 
-int SymbolTable::get_integer(const std::string& name) const {
-  return current_scope_->get_integer(name);
+void* SymbolTable::allocate(size_t bytes) {
+  const size_t size = (bytes + CACHE_LINE - 1) & ~(CACHE_LINE - 1);
+  const auto result = arena_.push(size);
+  std::memset(result, 0, bytes);
+  return result;
 }
 
-double SymbolTable::get_real(const std::string& name) const {
-  return current_scope_->get_real(name);
+void SymbolTable::reset() {
+  slots_.release({0, 0});
+  frame_top_ = 0;
+  arena_.release({0, 0});
+  display_.clear();
 }
 
 }  // namespace V
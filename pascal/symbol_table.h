@@ -2,94 +2,314 @@
 
 #pragma once
 
+#include <cstddef>
+#include <deque>
 #include <memory>
+#include <new>
 #include <optional>
 #include <string>
-#include <unordered_map>
+#include <string_view>
+#include <vector>
 #include "ast.h"
 
 namespace Pascal {
 
+struct FileCursor;
+
 namespace T {
-class Scope {
+
+// what the analyzer knows about a declared name: for a variable its type
+// and where it lives at runtime, for a procedure its declaration and its
+// position among the procedures of the declaring block
+struct Symbol {
+  enum class Kind { VARIABLE, PROCEDURE };
+
+  Kind kind;
+  ValueAST::ValueType type;
+  int level;
+  int slot;
+  bool by_reference;
+  ProcedureDeclaration* procedure;
+  // shape of an ARRAY variable
+  std::shared_ptr<const ArrayType> array = nullptr;
+  // bounds of a variable of a subrange type
+  std::optional<Interval> range = std::nullopt;
+  // layout of a RECORD variable, or of the elements of an ARRAY one
+  std::shared_ptr<const RecordType> record = nullptr;
+  // target of a POINTER variable, or of the elements of an ARRAY one
+  std::shared_ptr<const PointerType> pointer = nullptr;
+  // elements of a FILE variable
+  std::shared_ptr<const FileType> file = nullptr;
+};
+
+// All visible declarations live on one contiguous stack; a scope is just
+// a marker into it. An open addressing index maps every name to its
+// innermost declaration, and each entry remembers the declaration it
+// shadows, so leaving a scope only pops entries and patches the index.
+class SymbolTable {
  private:
-  std::string block_name_;
-  std::unordered_map<std::string, ValueAST::ValueType> symbols_;
-  std::shared_ptr<Scope> enclosing_scope_;
+  struct Entry {
+    // points into the declaring AST node, which outlives the analysis
+    std::string_view name;
+    size_t hash;
+    Symbol symbol;
+    int shadowed;
+  };
 
- public:
-  explicit Scope(const std::string& block_name,
-                 std::shared_ptr<Scope> enclosing_scope = nullptr);
+  struct Marker {
+    size_t first_entry;
+    int next_slot;
+    // procedure whose body the scope belongs to, nullptr for the program
+    const ProcedureDeclaration* owner;
+  };
 
-  bool define(const std::string& name, ValueAST::ValueType type);
+  static constexpr int EMPTY = -1;
 
-  std::optional<ValueAST::ValueType> get_type(const std::string& name) const;
+  // a deque, so that the symbols handed out stay where they are while
+  // later declarations are pushed
+  std::deque<Entry> entries_;
+  std::vector<Marker> scopes_;
 
-  bool is_defined(const std::string& name) const;
+  // entry indices, EMPTY for free buckets; size is a power of two
+  std::vector<int> index_;
+  size_t live_ = 0;
 
-  std::shared_ptr<Scope> enclosing_scope() const;
-};
+  // read-only outer scopes shared with other tables, searched on a miss
+  const SymbolTable* enclosing_ = nullptr;
+  int base_level_ = 0;
 
-class SymbolTable {
- private:
-  std::shared_ptr<Scope> current_scope_;
+  size_t find_bucket(std::string_view name, size_t hash) const;
+
+  void erase_bucket(size_t bucket);
+
+  const Symbol* define(std::string_view name, const Symbol& symbol);
+
+  const Symbol* lookup(std::string_view name, size_t hash) const;
+
+  // push an entry as the innermost declaration of its name
+  void push(const Entry& entry);
+
+  void flatten_into(SymbolTable* table) const;
+
+  void grow();
 
  public:
   SymbolTable();
 
-  bool define(const std::string& name, ValueAST::ValueType type);
+  // a table whose outermost scopes are enclosing's current ones; enclosing
+  // must not change while this table is in use, but can be shared by
+  // several tables at once
+  explicit SymbolTable(const SymbolTable* enclosing);
+
+  // returns the new symbol, or nullptr if name is already declared
+  // in the current scope; the symbol stays valid until its scope is exited
+  const Symbol* define(std::string_view name, ValueAST::ValueType type,
+                       bool by_reference = false,
+                       std::shared_ptr<const ArrayType> array = nullptr,
+                       const std::optional<Interval>& range = std::nullopt,
+                       std::shared_ptr<const RecordType> record = nullptr,
+                       std::shared_ptr<const PointerType> pointer = nullptr,
+                       std::shared_ptr<const FileType> file = nullptr);
+
+  // procedures do not take a frame slot, index is their position in the
+  // declaring block
+  const Symbol* define_procedure(std::string_view name,
+                                 ProcedureDeclaration* procedure, int index);
+
+  // find the innermost declaration of name, searching enclosing scopes;
+  // valid as long as that declaration is visible
+  const Symbol* lookup(std::string_view name) const;
+
+  // allocate an anonymous slot in the current scope
+  int reserve_slot();
+
+  // number of slots allocated in the current scope so far
+  int frame_size() const;
+
+  // lexical level of the current scope
+  int level() const {
+    return base_level_ + static_cast<int>(scopes_.size()) - 1;
+  }
+
+  // owner of the visible scope at level
+  const ProcedureDeclaration* owner(int level) const;
 
-  std::optional<ValueAST::ValueType> get_type(const std::string& name) const;
+  // lexical level of the outermost scope owned by this table
+  int base_level() const { return base_level_; }
 
-  bool is_defined(const std::string& name, bool local) const;
+  // a self-contained copy of everything visible from the current scope,
+  // which stays valid after this table or its enclosing ones change
+  std::shared_ptr<const SymbolTable> snapshot() const;
 
-  void enter_scope(const std::string& name);
+  // hash of every visible declaration and where it lives; two tables with
+  // the same fingerprint resolve every name the same way
+  uint64_t fingerprint() const;
+
+  void enter_scope(const std::string& name,
+                   const ProcedureDeclaration* owner = nullptr);
 
   void exit_scope();
 };
 }  // namespace T
 
 namespace V {
-class Scope {
- private:
-  std::string block_name_;
-  std::unordered_map<std::string, int> integer_map_;
-  std::unordered_map<std::string, double> real_map_;
-  std::shared_ptr<Scope> enclosing_scope_;
 
+// one variable cell; which member is live is fixed by the analyzer
+union Slot {
+  int integer;
+  double real;
+  int64_t int64;
+  Slot* reference;
+  // elements of an ARRAY, in the aggregate arena
+  void* array;
+  // members of a SET, in the aggregate arena
+  Set* set;
+  // fields of a RECORD, in the aggregate arena
+  void* record;
+  // a STRING, in the aggregate arena
+  String* string;
+  // the target of a POINTER, in the heap of the run; nullptr for NIL
+  void* pointer;
+  // where a FILE is, in the aggregate arena
+  FileCursor* file;
+};
+
+// Bytes pushed and popped like a stack, in chunks that never move, so
+// what is pushed stays where it is while the stack grows. A chunk is only
+// allocated once the stack first grows into it, and kept for later pushes
+// when it is popped. Every push is contiguous and aligned to a cache line
+// at the start of a chunk.
+class ChunkedStack {
  public:
-  explicit Scope(const std::string& block_name,
-                 std::shared_ptr<Scope> enclosing_scope = nullptr);
+  static constexpr size_t CACHE_LINE = 64;
+
+  // where the top was, to pop back to
+  struct Mark {
+    size_t chunk;
+    size_t top;
+  };
+
+ private:
+  struct AlignedDelete {
+    void operator()(std::byte* bytes) const {
+      ::operator delete[](bytes, std::align_val_t{CACHE_LINE});
+    }
+  };
+
+  struct Chunk {
+    std::unique_ptr<std::byte[], AlignedDelete> bytes;
+    size_t size;
+  };
+
+  std::vector<Chunk> chunks_;
+  size_t chunk_ = 0;
+  size_t top_ = 0;
+
+  // chunks double from first_ bytes, a push larger than that gets one of
+  // its own; at most limit_ bytes are allocated in all
+  size_t first_;
+  size_t limit_;
+  size_t capacity_ = 0;
+
+  // the error a push beyond the limit or the memory fails with
+  const char* full_;
 
-  std::shared_ptr<Scope> enclosing_scope() const;
+  // move on to the next chunk, which holds at least bytes
+  std::byte* grow(size_t bytes);
 
-  void define(const std::string& name, int value);
+ public:
+  ChunkedStack(size_t first, size_t limit, const char* full)
+      : first_(first), limit_(limit), full_(full) {}
+
+  std::byte* push(size_t bytes) {
+    if (!chunks_.empty() && bytes <= chunks_[chunk_].size - top_) {
+      const auto result = chunks_[chunk_].bytes.get() + top_;
+      top_ += bytes;
+      return result;
+    }
+    return grow(bytes);
+  }
+
+  Mark mark() const { return {chunk_, top_}; }
+
+  // pop everything pushed since mark was taken
+  void release(const Mark& mark) {
+    chunk_ = mark.chunk;
+    top_ = mark.top;
+  }
+};
+
+// activation record of a running block
+struct Frame {
+  Slot* slots;
+  const Block* block;
+  int level;
 
-  void define(const std::string& name, double value);
+  // frame of the lexically enclosing block
+  Frame* static_link;
 
-  int get_integer(const std::string& name) const;
+  // display entry this frame replaced, restored when it is popped
+  Frame* saved_display;
 
-  double get_real(const std::string& name) const;
+  // tops of the slot stack and of the aggregate arena when the frame was
+  // pushed; the slots and the arrays of the frame are above them
+  ChunkedStack::Mark slot_mark;
+  ChunkedStack::Mark arena_mark;
 };
 
+// Runtime storage: activation records and their slots are bump allocated
+// on two stacks that grow in chunks, so a call only touches the heap the
+// first time the stacks get that deep. display_[level] caches the static
+// chain of the running block, which makes any visible variable one indexed
+// load away. Arrays and sets live in a third stack, the aggregate arena,
+// in blocks aligned to a cache line.
 class SymbolTable {
  private:
-  std::shared_ptr<Scope> current_scope_;
+  ChunkedStack slots_;
+  // frames stay where they are as more are appended
+  std::deque<Frame> frames_;
+  size_t frame_top_ = 0;
+  size_t max_frames_;
+
+  ChunkedStack arena_;
+
+  std::vector<Frame*> display_;
 
  public:
-  SymbolTable();
+  static constexpr size_t CACHE_LINE = ChunkedStack::CACHE_LINE;
 
-  void define(const std::string& name, int value);
+  // nothing is allocated before the first frame is pushed; the slots of
+  // all frames and the frames themselves are limited, the arena is not
+  explicit SymbolTable(size_t slots = 1 << 20, size_t frames = 1 << 16);
 
-  void define(const std::string& name, double value);
+  Slot& slot(int level, int index) { return display_[level]->slots[index]; }
 
-  int get_integer(const std::string& name) const;
+  const Slot& slot(int level, int index) const {
+    return display_[level]->slots[index];
+  }
 
-  double get_real(const std::string& name) const;
+  Frame* frame(int level) const { return display_[level]; }
 
-  void enter_scope(const std::string& name);
+  // allocate a zeroed frame for block running at level; it becomes visible
+  // through the display only once entered, so arguments can be evaluated
+  // in the caller's scope and stored into it
+  Frame* push_frame(const Block* block, int level);
 
-  void exit_scope();
+  void enter_frame(Frame* frame);
+
+  // leave and pop the innermost frame
+  void exit_frame();
+
+  // leave and pop the running frame from under the frame pushed on top of
+  // it, moving that frame down into its place; returns the moved frame,
+  // which still has to be entered
+  Frame* replace_frame();
+
+  // zeroed storage for an array, set or record of the innermost frame,
+  // freed with it
+  void* allocate(size_t bytes);
+
+  void reset();
 };
 
 }  // namespace V
@@ -0,0 +1,141 @@
+// Copyright 2023 Zhu Junhui
+
+#include "thread_pool.h"
+#include <pthread.h>
+#include <sched.h>
+#include <algorithm>
+
+namespace Pascal {
+
+ThreadPool::ThreadPool(size_t threads, bool pinned) {
+  threads = std::max<size_t>(threads, 1);
+  for (size_t i = 0; i < threads; ++i) {
+    workers_.push_back(std::make_unique<Worker>());
+  }
+  for (size_t i = 0; i < threads; ++i) {
+    threads_.emplace_back([this, i] { work(i); });
+  }
+  if (pinned) {
+    pin();
+  }
+}
+
+void ThreadPool::pin() {
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (::sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+    return;
+  }
+  std::vector<int> cpus;
+  for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+    if (CPU_ISSET(cpu, &allowed)) {
+      cpus.push_back(cpu);
+    }
+  }
+  if (cpus.empty()) {
+    return;
+  }
+  for (size_t i = 0; i < threads_.size(); ++i) {
+    cpu_set_t cpu;
+    CPU_ZERO(&cpu);
+    CPU_SET(cpus[i % cpus.size()], &cpu);
+    ::pthread_setaffinity_np(threads_[i].native_handle(), sizeof(cpu), &cpu);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard lock(mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_all();
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+bool ThreadPool::pop(size_t worker, size_t* index) {
+  {
+    auto& own = *workers_[worker];
+    std::lock_guard lock(own.mutex);
+    if (!own.indices.empty()) {
+      *index = own.indices.back();
+      own.indices.pop_back();
+      return true;
+    }
+  }
+
+  for (size_t i = 1; i < workers_.size(); ++i) {
+    auto& victim = *workers_[(worker + i) % workers_.size()];
+    std::lock_guard lock(victim.mutex);
+    if (!victim.indices.empty()) {
+      *index = victim.indices.front();
+      victim.indices.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::work(size_t worker) {
+  size_t seen = 0;
+  while (true) {
+    const Task* task;
+    {
+      std::unique_lock lock(mutex_);
+      wake_.wait(lock, [&] { return stopping_ || generation_ != seen; });
+      if (stopping_) {
+        return;
+      }
+      seen = generation_;
+      task = task_;
+      if (task == nullptr) {
+        continue;
+      }
+      active_++;
+    }
+
+    size_t index;
+    size_t finished = 0;
+    while (pop(worker, &index)) {
+      (*task)(index, worker);
+      finished++;
+    }
+
+    std::lock_guard lock(mutex_);
+    remaining_ -= finished;
+    active_--;
+    if (remaining_ == 0 && active_ == 0) {
+      done_.notify_all();
+    }
+  }
+}
+
+void ThreadPool::parallel_for(size_t count, const Task& task) {
+  if (count == 0) {
+    return;
+  }
+
+  // hand every worker a contiguous run of indices to start from
+  const size_t chunk = (count + workers_.size() - 1) / workers_.size();
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    auto& worker = *workers_[i];
+    std::lock_guard lock(worker.mutex);
+    for (size_t index = i * chunk; index < std::min(count, (i + 1) * chunk);
+         ++index) {
+      worker.indices.push_back(index);
+    }
+  }
+
+  std::unique_lock lock(mutex_);
+  task_ = &task;
+  remaining_ = count;
+  generation_++;
+  wake_.notify_all();
+  // also wait for every worker to leave its pop loop, so none of them
+  // can pick up indices of the next call with this task
+  done_.wait(lock, [&] { return remaining_ == 0 && active_ == 0; });
+  task_ = nullptr;
+}
+
+}  // namespace Pascal
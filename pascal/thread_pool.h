@@ -0,0 +1,68 @@
+// Copyright 2023 Zhu Junhui
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Pascal {
+
+// A fixed set of workers, each owning a deque of task indices. A worker
+// pops from the back of its own deque and, once that is empty, steals
+// from the front of the others, so uneven tasks still balance out.
+class ThreadPool {
+ public:
+  // task(index, worker) where worker is in [0, size())
+  using Task = std::function<void(size_t, size_t)>;
+
+ private:
+  struct Worker {
+    std::mutex mutex;
+    std::deque<size_t> indices;
+  };
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::vector<std::thread> threads_;
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable done_;
+  const Task* task_ = nullptr;
+  size_t generation_ = 0;
+  size_t remaining_ = 0;
+  size_t active_ = 0;
+  bool stopping_ = false;
+
+  bool pop(size_t worker, size_t* index);
+
+  void work(size_t worker);
+
+  // pin worker i to the i-th CPU the process may run on, round robin;
+  // best effort, a worker that cannot be pinned stays where it is
+  void pin();
+
+ public:
+  // pinned workers keep their caches, and what they allocate stays on
+  // their NUMA node
+  explicit ThreadPool(size_t threads = std::thread::hardware_concurrency(),
+                      bool pinned = false);
+
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  size_t size() const { return workers_.size(); }
+
+  // run task for every index in [0, count) and wait for all of them;
+  // tasks must not throw
+  void parallel_for(size_t count, const Task& task);
+};
+
+}  // namespace Pascal
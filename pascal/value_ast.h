@@ -2,23 +2,148 @@
 
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <map>
 #include <memory>
+#include <optional>
 #include <string>
 #include <utility>
 #include <variant>
 #include <vector>
 #include "meta.h"
+#include "string_value.h"
 
 namespace Pascal {
 
 class ValueASTVisitor;
 class ValueASTChecker;
 
+// A SET value: bit m of the words is set when m is a member. Every set
+// has room for the members 0..MAX_MEMBER, so the set operations combine
+// the words one by one, which compilers turn into a few SIMD instructions,
+// and the size of a set is a sum of popcounts.
+struct Set {
+  static constexpr int MAX_MEMBER = 255;
+  static constexpr int WORD_BITS = 64;
+
+  std::array<uint64_t, (MAX_MEMBER + 1) / WORD_BITS> words{};
+
+  bool contains(int member) const {
+    return static_cast<unsigned>(member) <= MAX_MEMBER &&
+           ((words[member / WORD_BITS] >> (member % WORD_BITS)) & 1) != 0;
+  }
+
+  // add the members low..high, which are within 0..MAX_MEMBER
+  void insert(int low, int high) {
+    for (int word = low / WORD_BITS; word <= high / WORD_BITS; ++word) {
+      const int first = std::max(low - word * WORD_BITS, 0);
+      const int last = std::min(high - word * WORD_BITS, WORD_BITS - 1);
+      words[word] |= (~uint64_t{0} >> (WORD_BITS - 1 - (last - first)))
+                     << first;
+    }
+  }
+
+  Set operator|(const Set& other) const {
+    Set result;
+    for (size_t i = 0; i < words.size(); ++i) {
+      result.words[i] = words[i] | other.words[i];
+    }
+    return result;
+  }
+
+  Set operator&(const Set& other) const {
+    Set result;
+    for (size_t i = 0; i < words.size(); ++i) {
+      result.words[i] = words[i] & other.words[i];
+    }
+    return result;
+  }
+
+  Set operator-(const Set& other) const {
+    Set result;
+    for (size_t i = 0; i < words.size(); ++i) {
+      result.words[i] = words[i] & ~other.words[i];
+    }
+    return result;
+  }
+
+  bool subset_of(const Set& other) const {
+    uint64_t outside = 0;
+    for (size_t i = 0; i < words.size(); ++i) {
+      outside |= words[i] & ~other.words[i];
+    }
+    return outside == 0;
+  }
+
+  int size() const {
+    int result = 0;
+    for (const auto word : words) {
+      result += std::popcount(word);
+    }
+    return result;
+  }
+
+  // the smallest member, or -1 for the empty set
+  int first() const {
+    for (size_t i = 0; i < words.size(); ++i) {
+      if (words[i] != 0) {
+        return static_cast<int>(i) * WORD_BITS + std::countr_zero(words[i]);
+      }
+    }
+    return -1;
+  }
+
+  bool operator==(const Set&) const = default;
+
+  // the members as ranges, e.g. [1..3, 7]
+  std::string to_string() const {
+    std::string text = "[";
+    for (int member = 0; member <= MAX_MEMBER; ++member) {
+      if (!contains(member)) {
+        continue;
+      }
+      int last = member;
+      while (last < MAX_MEMBER && contains(last + 1)) {
+        ++last;
+      }
+      text += (text.size() > 1 ? ", " : "") + std::to_string(member);
+      if (last > member) {
+        text += ".." + std::to_string(last);
+      }
+      member = last;
+    }
+    return text + "]";
+  }
+};
+
 class ValueAST {
  public:
   virtual ~ValueAST() = default;
-  using Value = std::variant<int, double>;
-  enum class ValueType { INTEGER, REAL };
+  using Value = std::variant<int, double, Set, int64_t, String, void*>;
+  // BOOLEAN values are the integers 0 and 1; an ARRAY is only ever a
+  // whole variable, its shape is described by an ArrayType; a SET variable
+  // holds a Set in the aggregate arena like an array, and so does a RECORD
+  // variable, whose layout is a RecordType. INT64 values are 64-bit
+  // integers, which INTEGER ones are converted to explicitly. A STRING
+  // variable holds a String in the aggregate arena like a set. A POINTER
+  // value is the address of a block NEW allocated, nullptr for NIL, and
+  // what it points to is described by a PointerType.
+  enum class ValueType {
+    INTEGER,
+    REAL,
+    BOOLEAN,
+    ARRAY,
+    SET,
+    RECORD,
+    INT64,
+    STRING,
+    POINTER,
+    FILE
+  };
   // Type to string
   static std::string type_to_string(ValueType type) {
     switch (type) {
@@ -26,6 +151,22 @@ class ValueAST {
         return "INTEGER";
       case ValueType::REAL:
         return "REAL";
+      case ValueType::BOOLEAN:
+        return "BOOLEAN";
+      case ValueType::ARRAY:
+        return "ARRAY";
+      case ValueType::SET:
+        return "SET";
+      case ValueType::RECORD:
+        return "RECORD";
+      case ValueType::INT64:
+        return "INT64";
+      case ValueType::STRING:
+        return "STRING";
+      case ValueType::POINTER:
+        return "POINTER";
+      case ValueType::FILE:
+        return "FILE";
       default:
         throw std::runtime_error("Invalid type");
     }
@@ -77,14 +218,21 @@ class BinaryOperation;
 class UnaryOperation;
 class Number;
 class Variable;
+class FunctionCall;
+class SetConstructor;
 class Type;
 
+// a C++ function programs can call, see host_function.h
+struct HostFunction;
+
 class ValueASTVisitor {
  public:
   virtual ValueAST::Value visit(const BinaryOperation*) = 0;
   virtual ValueAST::Value visit(const UnaryOperation*) = 0;
   virtual ValueAST::Value visit(const Number*) = 0;
   virtual ValueAST::Value visit(const Variable*) = 0;
+  virtual ValueAST::Value visit(const FunctionCall*) = 0;
+  virtual ValueAST::Value visit(const SetConstructor*) = 0;
   virtual ValueAST::ValueType visit(const Type*) = 0;
 };
 
@@ -94,13 +242,441 @@ class ValueASTChecker {
   virtual std::pair<ValueAST*, ValueAST::ValueType> check(UnaryOperation*) = 0;
   virtual std::pair<ValueAST*, ValueAST::ValueType> check(Number*) = 0;
   virtual std::pair<ValueAST*, ValueAST::ValueType> check(Variable*) = 0;
+  virtual std::pair<ValueAST*, ValueAST::ValueType> check(FunctionCall*) = 0;
+  virtual std::pair<ValueAST*, ValueAST::ValueType> check(SetConstructor*) = 0;
   virtual ValueAST::ValueType check(Type*) = 0;
 };
 
+// The integers low..high. A declared subrange such as 1..100 is one, and so
+// is what the range analyzer knows about the values of an expression; the
+// bounds are wide enough for sums and products of two INTEGER bounds.
+struct Interval {
+  int64_t low;
+  int64_t high;
+
+  // every INTEGER value
+  static Interval integer() {
+    return {std::numeric_limits<int>::min(), std::numeric_limits<int>::max()};
+  }
+
+  // every INT64 value
+  static Interval int64() {
+    return {std::numeric_limits<int64_t>::min(),
+            std::numeric_limits<int64_t>::max()};
+  }
+
+  bool empty() const { return low > high; }
+
+  bool contains(const Interval& other) const {
+    return other.empty() || (low <= other.low && other.high <= high);
+  }
+
+  Interval meet(const Interval& other) const {
+    return {std::max(low, other.low), std::min(high, other.high)};
+  }
+
+  Interval join(const Interval& other) const {
+    if (empty()) {
+      return other;
+    }
+    if (other.empty()) {
+      return *this;
+    }
+    return {std::min(low, other.low), std::max(high, other.high)};
+  }
+
+  bool operator==(const Interval&) const = default;
+
+  std::string to_string() const {
+    return std::to_string(low) + ".." + std::to_string(high);
+  }
+};
+
+// Bytes a scalar of an array or record takes: 8 for REAL, INT64 and
+// POINTER, 4 otherwise. PACKED storage keeps a BOOLEAN in 1 byte and a
+// subrange in the fewest of 1, 2 or 4 bytes that hold its bounds.
+inline int64_t scalar_size(ValueAST::ValueType type,
+                           const std::optional<Interval>& range, bool packed) {
+  if (type == ValueAST::ValueType::REAL) {
+    return sizeof(double);
+  }
+  if (packed && type == ValueAST::ValueType::BOOLEAN) {
+    return 1;
+  }
+  if (packed && range.has_value()) {
+    // a subrange with negative values is stored signed
+    if (Interval{INT8_MIN, INT8_MAX}.contains(*range) ||
+        Interval{0, UINT8_MAX}.contains(*range)) {
+      return 1;
+    }
+    if (Interval{INT16_MIN, INT16_MAX}.contains(*range) ||
+        Interval{0, UINT16_MAX}.contains(*range)) {
+      return 2;
+    }
+    if (Interval::integer().contains(*range) ||
+        Interval{0, UINT32_MAX}.contains(*range)) {
+      return 4;
+    }
+  }
+  if (type == ValueAST::ValueType::POINTER) {
+    return sizeof(void*);
+  }
+  return type == ValueAST::ValueType::INT64 ? sizeof(int64_t) : sizeof(int);
+}
+
+// a scalar whose bytes are all there is to it, so that it can be read from
+// a file or shared with the host as it is: an INTEGER, INT64 or REAL that
+// is neither a subrange nor packed
+inline bool plain(ValueAST::ValueType type,
+                  const std::optional<Interval>& range, bool packed) {
+  return (type == ValueAST::ValueType::INTEGER ||
+          type == ValueAST::ValueType::INT64 ||
+          type == ValueAST::ValueType::REAL) &&
+         !range.has_value() && !packed;
+}
+
+// a scalar stored in fewer bytes than the slot member of its type
+inline bool narrow(ValueAST::ValueType type, int64_t size) {
+  return size < scalar_size(type, std::nullopt, false);
+}
+
+// What a pointer type ^T points to. A named target is only referred to
+// weakly, since a record type may point to itself: the TypeScope declaring
+// it keeps it, and it is found when the pointer type is parsed, or at the
+// end of its TYPE section, which may declare it further down.
+class PointerType {
+ private:
+  // the type identifier of a named target, empty for an anonymous one
+  std::string name_;
+  std::weak_ptr<const Type> named_;
+  std::shared_ptr<const Type> anonymous_;
+
+ public:
+  explicit PointerType(std::string name) : name_(std::move(name)) {}
+
+  explicit PointerType(std::shared_ptr<const Type> target)
+      : anonymous_(std::move(target)) {}
+
+  const std::string& name() const { return name_; }
+
+  void resolve(const std::shared_ptr<const Type>& target) { named_ = target; }
+
+  // nullptr for a named target not resolved yet
+  std::shared_ptr<const Type> target() const {
+    return name_.empty() ? anonymous_ : named_.lock();
+  }
+
+  // pointers to the same named type, or to equal anonymous ones
+  bool operator==(const PointerType& other) const;
+
+  // e.g. ^node
+  std::string to_string() const;
+};
+
+// Layout of a RECORD type, fixed when the type is parsed, so every field
+// is at a constant offset. Fields are placed in declaration order, each
+// aligned to its size; a PACKED record has no padding and narrow scalars.
+// Two record types are the same if their fields are.
+struct RecordType {
+  struct Field {
+    std::string name;
+    ValueAST::ValueType type;
+    // the bounds of a subrange field
+    std::optional<Interval> range;
+    // the layout of a RECORD field
+    std::shared_ptr<const RecordType> record;
+    // the target of a POINTER field
+    std::shared_ptr<const PointerType> pointer;
+    // stored like in a PACKED record, e.g. a BYTE
+    bool packed = false;
+    int64_t offset = 0;
+    int64_t size = 0;
+
+    bool operator==(const Field& other) const {
+      return name == other.name && type == other.type &&
+             range == other.range && packed == other.packed &&
+             offset == other.offset &&
+             size == other.size &&
+             (record == nullptr ? other.record == nullptr
+                                : other.record != nullptr &&
+                                      *record == *other.record) &&
+             (pointer == nullptr ? other.pointer == nullptr
+                                 : other.pointer != nullptr &&
+                                       *pointer == *other.pointer);
+    }
+  };
+
+  std::vector<Field> fields;
+  bool packed;
+  int64_t size = 0;
+  int64_t alignment = 1;
+
+  explicit RecordType(std::vector<Field> fields, bool packed)
+      : fields(std::move(fields)), packed(packed) {
+    for (auto& field : this->fields) {
+      if (this->field(field.name) != &field) {
+        throw std::runtime_error("field " + field.name +
+                                 " is declared twice!");
+      }
+      int64_t align = 1;
+      if (field.type == ValueAST::ValueType::RECORD) {
+        field.size = field.record->size;
+        align = field.record->alignment;
+      } else {
+        field.size =
+            scalar_size(field.type, field.range, packed || field.packed);
+        align = field.size;
+      }
+      if (!packed) {
+        size = (size + align - 1) / align * align;
+        alignment = std::max(alignment, align);
+      }
+      field.offset = size;
+      size += field.size;
+    }
+    size = (size + alignment - 1) / alignment * alignment;
+  }
+
+  const Field* field(const std::string& name) const {
+    for (const auto& field : fields) {
+      if (field.name == name) {
+        return &field;
+      }
+    }
+    return nullptr;
+  }
+
+  // the scalar fields, those of nested records included, with offsets from
+  // the start of this record
+  std::vector<Field> scalars() const {
+    std::vector<Field> result;
+    for (const auto& field : fields) {
+      if (field.record == nullptr) {
+        result.push_back(field);
+        continue;
+      }
+      for (auto scalar : field.record->scalars()) {
+        scalar.offset += field.offset;
+        result.push_back(std::move(scalar));
+      }
+    }
+    return result;
+  }
+
+  // an unpacked record of plain scalars only, laid out like a C struct
+  bool plain() const {
+    if (packed) {
+      return false;
+    }
+    for (const auto& scalar : scalars()) {
+      if (!Pascal::plain(scalar.type, scalar.range, scalar.packed)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool operator==(const RecordType&) const = default;
+
+  std::string to_string() const {
+    std::string result = packed ? "PACKED RECORD " : "RECORD ";
+    for (const auto& field : fields) {
+      result += field.name + ": ";
+      if (field.record != nullptr) {
+        result += field.record->to_string();
+      } else if (field.pointer != nullptr) {
+        result += field.pointer->to_string();
+      } else if (field.range.has_value()) {
+        result += field.range->to_string();
+      } else {
+        result += ValueAST::type_to_string(field.type);
+      }
+      result += "; ";
+    }
+    return result + "END";
+  }
+};
+
+// Shape of an ARRAY type, outermost dimension first. ARRAY[1..3, 0..4] OF T
+// and ARRAY[1..3] OF ARRAY[0..4] OF T are the same type. Elements are
+// stored in row-major order, each taking scalar_size bytes, or the size of
+// its record. A PACKED array of records is stored as one column per scalar
+// field instead, widest first, so a field of consecutive elements is
+// contiguous.
+struct ArrayType {
+  struct Dimension {
+    int low;
+    int high;
+    // elements between consecutive indices of this dimension
+    int64_t stride;
+
+    bool operator==(const Dimension&) const = default;
+  };
+
+  std::vector<Dimension> dimensions;
+  ValueAST::ValueType element;
+  // the bounds of subrange elements
+  std::optional<Interval> range;
+  // the layout of RECORD elements
+  std::shared_ptr<const RecordType> record;
+  bool packed;
+  // the target of POINTER elements
+  std::shared_ptr<const PointerType> pointer;
+
+  explicit ArrayType(const std::vector<std::pair<int, int>>& bounds,
+                     ValueAST::ValueType element,
+                     std::optional<Interval> range = std::nullopt,
+                     std::shared_ptr<const RecordType> record = nullptr,
+                     bool packed = false,
+                     std::shared_ptr<const PointerType> pointer = nullptr)
+      : element(element),
+        range(range),
+        record(std::move(record)),
+        packed(packed),
+        pointer(std::move(pointer)) {
+    int64_t stride = 1;
+    dimensions.resize(bounds.size());
+    for (size_t i = bounds.size(); i-- > 0;) {
+      const auto [low, high] = bounds[i];
+      if (low > high) {
+        throw std::runtime_error("array range " + std::to_string(low) + ".." +
+                                 std::to_string(high) + " is empty");
+      }
+      dimensions[i] = Dimension{low, high, stride};
+      stride *= static_cast<int64_t>(high) - low + 1;
+      if (stride > MAX_ELEMENTS) {
+        throw std::runtime_error("array is too large");
+      }
+    }
+  }
+
+  // the offset of any element fits in an int
+  static constexpr int64_t MAX_ELEMENTS = 1 << 28;
+
+  int64_t size() const {
+    const auto& outer = dimensions.front();
+    return outer.stride * (static_cast<int64_t>(outer.high) - outer.low + 1);
+  }
+
+  // bytes per element; the columns of a packed array of records have no
+  // padding
+  size_t element_size() const {
+    if (record == nullptr) {
+      return scalar_size(element, range, packed);
+    }
+    if (!packed) {
+      return record->size;
+    }
+    int64_t result = 0;
+    for (const auto& scalar : record->scalars()) {
+      result += scalar.size;
+    }
+    return result;
+  }
+
+  size_t bytes() const { return size() * element_size(); }
+
+  // the scalar field at offset in a record element, of the given size, is
+  // at k * first + second bytes for the element at offset k
+  std::pair<int64_t, int64_t> field(int64_t offset, int64_t size) const {
+    if (!packed) {
+      return {record->size, offset};
+    }
+    auto scalars = record->scalars();
+    std::stable_sort(
+        scalars.begin(), scalars.end(),
+        [](const auto& a, const auto& b) { return a.size > b.size; });
+    int64_t start = 0;
+    for (const auto& scalar : scalars) {
+      if (scalar.offset == offset) {
+        break;
+      }
+      start += this->size() * scalar.size;
+    }
+    return {size, start};
+  }
+
+  bool operator==(const ArrayType& other) const {
+    return dimensions == other.dimensions && element == other.element &&
+           range == other.range && packed == other.packed &&
+           (record == nullptr ? other.record == nullptr
+                              : other.record != nullptr &&
+                                    *record == *other.record) &&
+           (pointer == nullptr ? other.pointer == nullptr
+                               : other.pointer != nullptr &&
+                                     *pointer == *other.pointer);
+  }
+
+  std::string to_string() const {
+    std::string result = packed ? "PACKED ARRAY[" : "ARRAY[";
+    for (size_t i = 0; i < dimensions.size(); ++i) {
+      result += (i > 0 ? ", " : "") + std::to_string(dimensions[i].low) +
+                ".." + std::to_string(dimensions[i].high);
+    }
+    result += "] OF ";
+    if (record != nullptr) {
+      return result + record->to_string();
+    }
+    if (pointer != nullptr) {
+      return result + pointer->to_string();
+    }
+    if (range.has_value()) {
+      return result + range->to_string();
+    }
+    return result + ValueAST::type_to_string(element);
+  }
+};
+
+// The elements of a FILE OF type: INTEGER, INT64 or REAL values, or
+// records of them, laid out in the file as they are in memory, so that
+// reading one is a copy of its bytes.
+struct FileType {
+  ValueAST::ValueType element;
+  // the layout of RECORD elements
+  std::shared_ptr<const RecordType> record;
+
+  int64_t element_size() const {
+    return record != nullptr ? record->size
+                             : scalar_size(element, std::nullopt, false);
+  }
+
+  bool operator==(const FileType& other) const {
+    return element == other.element &&
+           (record == nullptr ? other.record == nullptr
+                              : other.record != nullptr &&
+                                    *record == *other.record);
+  }
+
+  std::string to_string() const {
+    return "FILE OF " + (record != nullptr ? record->to_string()
+                                           : ValueAST::type_to_string(element));
+  }
+};
+
 class Type {
  private:
   ValueAST::ValueType value_;
 
+  // the shape of an ARRAY type, shared with the variables declared with it
+  std::shared_ptr<const ArrayType> array_;
+
+  // the bounds of an INTEGER subrange type, or the members a SET type
+  // may have
+  std::optional<Interval> range_;
+
+  // a subrange stored in the fewest bytes even where it is not PACKED,
+  // BYTE, WORD and CARDINAL
+  bool packed_ = false;
+
+  // the layout of a RECORD type
+  std::shared_ptr<const RecordType> record_;
+
+  // the target of a POINTER type
+  std::shared_ptr<const PointerType> pointer_;
+
+  // the elements of a FILE type
+  std::shared_ptr<const FileType> file_;
+
  public:
   explicit Type(Token token) {
     switch (token.type()) {
@@ -110,11 +686,37 @@ class Type {
       case Token::Type::REAL_TYPE:
         value_ = ValueAST::ValueType::REAL;
         break;
+      case Token::Type::BOOLEAN_TYPE:
+        value_ = ValueAST::ValueType::BOOLEAN;
+        break;
+      case Token::Type::INT64_TYPE:
+        value_ = ValueAST::ValueType::INT64;
+        break;
+      case Token::Type::STRING_TYPE:
+        value_ = ValueAST::ValueType::STRING;
+        break;
       default:
         throw std::runtime_error("Invalid type");
     }
   }
 
+  explicit Type(std::shared_ptr<const ArrayType> array)
+      : value_(ValueAST::ValueType::ARRAY), array_(std::move(array)) {}
+
+  explicit Type(Interval range,
+                ValueAST::ValueType value = ValueAST::ValueType::INTEGER,
+                bool packed = false)
+      : value_(value), range_(range), packed_(packed) {}
+
+  explicit Type(std::shared_ptr<const RecordType> record)
+      : value_(ValueAST::ValueType::RECORD), record_(std::move(record)) {}
+
+  explicit Type(std::shared_ptr<const PointerType> pointer)
+      : value_(ValueAST::ValueType::POINTER), pointer_(std::move(pointer)) {}
+
+  explicit Type(std::shared_ptr<const FileType> file)
+      : value_(ValueAST::ValueType::FILE), file_(std::move(file)) {}
+
   ValueAST::ValueType accept(ValueASTVisitor* visitor) {
     return visitor->visit(this);
   }
@@ -126,31 +728,336 @@ class Type {
   std::string to_string() const {
     switch (value_) {
       case ValueAST::ValueType::INTEGER:
-        return "INTEGER";
+        return range_.has_value() ? range_->to_string() : "INTEGER";
       case ValueAST::ValueType::REAL:
         return "REAL";
+      case ValueAST::ValueType::BOOLEAN:
+        return "BOOLEAN";
+      case ValueAST::ValueType::ARRAY:
+        return array_->to_string();
+      case ValueAST::ValueType::SET:
+        return "SET OF " + range_->to_string();
+      case ValueAST::ValueType::RECORD:
+        return record_->to_string();
+      case ValueAST::ValueType::INT64:
+        return range_.has_value() ? range_->to_string() : "INT64";
+      case ValueAST::ValueType::STRING:
+        return "STRING";
+      case ValueAST::ValueType::POINTER:
+        return pointer_->to_string();
+      case ValueAST::ValueType::FILE:
+        return file_->to_string();
       default:
         throw std::runtime_error("Invalid type");
     }
   }
 
   ValueAST::ValueType value() const { return value_; }
+
+  const std::shared_ptr<const ArrayType>& array() const { return array_; }
+
+  const std::optional<Interval>& range() const { return range_; }
+
+  const std::shared_ptr<const RecordType>& record() const { return record_; }
+
+  const std::shared_ptr<const PointerType>& pointer() const {
+    return pointer_;
+  }
+
+  const std::shared_ptr<const FileType>& file() const { return file_; }
+
+  bool packed() const { return packed_; }
+};
+
+inline bool PointerType::operator==(const PointerType& other) const {
+  if (name_.empty() != other.name_.empty()) {
+    return false;
+  }
+  if (name_.empty()) {
+    return anonymous_->to_string() == other.anonymous_->to_string();
+  }
+  return name_ == other.name_ && target() == other.target();
+}
+
+inline std::string PointerType::to_string() const {
+  return "^" + (name_.empty() ? anonymous_->to_string() : name_);
+}
+
+// The types a block declares by name, which the blocks nested in it see
+// unless they declare the same names.
+struct TypeScope {
+  std::shared_ptr<const TypeScope> enclosing;
+  std::map<std::string, std::shared_ptr<const Type>> types;
+
+  // the innermost visible declaration of name, nullptr if there is none
+  std::shared_ptr<const Type> lookup(const std::string& name) const {
+    for (auto scope = this; scope != nullptr; scope = scope->enclosing.get()) {
+      if (const auto it = scope->types.find(name); it != scope->types.end()) {
+        return it->second;
+      }
+    }
+    return nullptr;
+  }
+
+  // hash of every visible declaration
+  uint64_t fingerprint() const {
+    uint64_t seed = enclosing != nullptr ? enclosing->fingerprint() : 0;
+    for (const auto& [name, type] : types) {
+      seed = hash_combine(seed, std::hash<std::string>{}(name));
+      seed = hash_combine(seed, std::hash<std::string>{}(type->to_string()));
+    }
+    return seed;
+  }
 };
 
 class Variable : public ValueAST {
+ public:
+  // p^.f^ selects what the pointer field f of the target of the pointer p
+  // points to: each dereference loads a pointer and adds the offset of the
+  // fields after it, set by the semantic analyzer
+  struct Dereference {
+    std::vector<std::string> fields;
+    int64_t offset = 0;
+  };
+
  private:
   std::string value_;
 
+  // lexical address resolved by the semantic analyzer:
+  // level is the nesting level of the declaring scope (0 for the program),
+  // slot is the index of the variable inside that scope's frame
+  int level_ = -1;
+  int slot_ = -1;
+
+  // the slot holds a reference to the variable, e.g. for VAR parameters
+  bool by_reference_ = false;
+
+  // a[i, j] or a[i][j] selects one element of the array a
+  std::vector<std::unique_ptr<ValueAST>> indices_;
+
+  // r.f.g selects the field g of the field f of the record r, and a[i].f
+  // the field f of an element of an array of records
+  std::vector<std::string> fields_;
+
+  std::vector<Dereference> dereferences_;
+
+  // shape of the variable if it is an array, set by the semantic analyzer
+  std::shared_ptr<const ArrayType> array_;
+
+  // layout of the variable if it is a record, or an array of records
+  std::shared_ptr<const RecordType> record_;
+
+  // target of the variable if it is a pointer
+  std::shared_ptr<const PointerType> pointer_;
+
+  // what the indices and fields select is at offset + k * stride bytes
+  // from the start of the variable's storage, k being the offset of the
+  // selected element in its array; what the variable selects in the end,
+  // past any dereferences, takes packed_size bytes if that is fewer than a
+  // slot member of its type. Set by the semantic analyzer
+  int64_t stride_ = 0;
+  int64_t offset_ = 0;
+  int packed_size_ = 0;
+
+  // bounds of the variable if its type is a subrange, the members it may
+  // have if it is a set
+  std::optional<Interval> range_;
+
+  // the indices are compared with the bounds of the array, unless the
+  // range analyzer proved them within
+  bool checked_ = true;
+
  public:
   explicit Variable(Token token)
       : value_(std::get<std::string>(token.value())) {
     assert(token.type() == Token::Type::ID);
   }
 
-  explicit Variable(Variable&& other) : value_(std::move(other.value_)) {}
+  explicit Variable(Variable&& other)
+      : value_(std::move(other.value_)),
+        level_(other.level_),
+        slot_(other.slot_),
+        by_reference_(other.by_reference_),
+        indices_(std::move(other.indices_)),
+        fields_(std::move(other.fields_)),
+        dereferences_(std::move(other.dereferences_)),
+        array_(std::move(other.array_)),
+        record_(std::move(other.record_)),
+        pointer_(std::move(other.pointer_)),
+        stride_(other.stride_),
+        offset_(other.offset_),
+        packed_size_(other.packed_size_),
+        range_(other.range_),
+        checked_(other.checked_) {}
 
   const std::string& value() const { return value_; }
 
+  int level() const { return level_; }
+
+  int slot() const { return slot_; }
+
+  bool resolved() const { return slot_ >= 0; }
+
+  bool by_reference() const { return by_reference_; }
+
+  void set_address(int level, int slot, bool by_reference = false) {
+    level_ = level;
+    slot_ = slot;
+    by_reference_ = by_reference;
+  }
+
+  const std::vector<std::unique_ptr<ValueAST>>& indices() const {
+    return indices_;
+  }
+
+  void add_index(std::unique_ptr<ValueAST> index) {
+    indices_.push_back(std::move(index));
+  }
+
+  ValueAST* index_release(size_t i) { return indices_[i].release(); }
+
+  void set_index(size_t i, ValueAST* index) { indices_[i].reset(index); }
+
+  const std::vector<std::string>& fields() const { return fields_; }
+
+  // a field after a dereference is a field of its target
+  void add_field(std::string field) {
+    auto& fields = dereferences_.empty() ? fields_
+                                         : dereferences_.back().fields;
+    fields.push_back(std::move(field));
+  }
+
+  const std::vector<Dereference>& dereferences() const {
+    return dereferences_;
+  }
+
+  void add_dereference() { dereferences_.emplace_back(); }
+
+  void set_dereference_offset(size_t i, int64_t offset) {
+    dereferences_[i].offset = offset;
+  }
+
+  // the variable is not an element or a field of another, nor what a
+  // pointer points to
+  bool whole() const {
+    return indices_.empty() && fields_.empty() && dereferences_.empty();
+  }
+
+  const ArrayType* array() const { return array_.get(); }
+
+  void set_array(std::shared_ptr<const ArrayType> array) {
+    array_ = std::move(array);
+  }
+
+  const std::shared_ptr<const RecordType>& record() const { return record_; }
+
+  void set_record(std::shared_ptr<const RecordType> record) {
+    record_ = std::move(record);
+  }
+
+  const std::shared_ptr<const PointerType>& pointer() const {
+    return pointer_;
+  }
+
+  void set_pointer(std::shared_ptr<const PointerType> pointer) {
+    pointer_ = std::move(pointer);
+  }
+
+  int64_t stride() const { return stride_; }
+
+  int64_t offset() const { return offset_; }
+
+  int packed_size() const { return packed_size_; }
+
+  void set_selection(int64_t stride, int64_t offset, int packed_size) {
+    stride_ = stride;
+    offset_ = offset;
+    packed_size_ = packed_size;
+  }
+
+  void set_packed_size(int packed_size) { packed_size_ = packed_size; }
+
+  const std::optional<Interval>& range() const { return range_; }
+
+  void set_range(const std::optional<Interval>& range) { range_ = range; }
+
+  bool checked() const { return checked_; }
+
+  void set_checked(bool checked) { checked_ = checked; }
+
+  ValueAST::Value accept(ValueASTVisitor* visitor) const override {
+    return visitor->visit(this);
+  }
+
+  std::pair<ValueAST*, ValueAST::ValueType> accept(
+      ValueASTChecker* checker) override {
+    return checker->check(this);
+  }
+
+  std::pair<ValueAST*, ValueType> wrap_with_type(
+      ValueAST::ValueType type) override {
+    return {new TypeChecked(type, std::move(*this)), type};
+  }
+};
+
+class FunctionCall : public ValueAST {
+ private:
+  std::string name_;
+  std::vector<std::unique_ptr<ValueAST>> arguments_;
+
+  // resolved by the semantic analyzer like ProcedureCall
+  int level_ = -1;
+  int index_ = -1;
+
+  // the call is the last thing its function does, so the caller's frame
+  // is released before the callee's is pushed
+  bool tail_ = false;
+
+  // the host function called instead of a Pascal one
+  const HostFunction* host_ = nullptr;
+
+ public:
+  explicit FunctionCall(std::string name,
+                        std::vector<std::unique_ptr<ValueAST>> arguments)
+      : name_(std::move(name)), arguments_(std::move(arguments)) {}
+
+  explicit FunctionCall(FunctionCall&& other)
+      : name_(std::move(other.name_)),
+        arguments_(std::move(other.arguments_)),
+        level_(other.level_),
+        index_(other.index_),
+        tail_(other.tail_),
+        host_(other.host_) {}
+
+  const std::string& name() const { return name_; }
+
+  const std::vector<std::unique_ptr<ValueAST>>& arguments() const {
+    return arguments_;
+  }
+
+  ValueAST* argument_release(size_t i) { return arguments_[i].release(); }
+
+  void set_argument(size_t i, ValueAST* argument) {
+    arguments_[i].reset(argument);
+  }
+
+  int level() const { return level_; }
+
+  int index() const { return index_; }
+
+  void set_target(int level, int index) {
+    level_ = level;
+    index_ = index;
+  }
+
+  bool tail() const { return tail_; }
+
+  void set_tail(bool tail) { tail_ = tail; }
+
+  const HostFunction* host() const { return host_; }
+
+  void set_host(const HostFunction* host) { host_ = host; }
+
   ValueAST::Value accept(ValueASTVisitor* visitor) const override {
     return visitor->visit(this);
   }
@@ -168,20 +1075,37 @@ class Variable : public ValueAST {
 
 class Number : public ValueAST {
  private:
-  std::variant<int, double> value_;
+  ValueAST::Value value_;
   ValueAST::ValueType type_;
 
  public:
   explicit Number(Token token) {
     switch (token.type()) {
       case Token::Type::INTEGER_CONST:
-        type_ = ValueAST::ValueType::INTEGER;
-        value_ = std::get<int>(token.value());
+        if (std::holds_alternative<int64_t>(token.value())) {
+          type_ = ValueAST::ValueType::INT64;
+          value_ = std::get<int64_t>(token.value());
+        } else {
+          type_ = ValueAST::ValueType::INTEGER;
+          value_ = std::get<int>(token.value());
+        }
         break;
       case Token::Type::REAL_CONST:
         type_ = ValueAST::ValueType::REAL;
         value_ = std::get<double>(token.value());
         break;
+      case Token::Type::BOOLEAN_CONST:
+        type_ = ValueAST::ValueType::BOOLEAN;
+        value_ = std::get<int>(token.value());
+        break;
+      case Token::Type::STRING_CONST:
+        type_ = ValueAST::ValueType::STRING;
+        value_ = String::literal(std::get<std::string>(token.value()));
+        break;
+      case Token::Type::NIL:
+        type_ = ValueAST::ValueType::POINTER;
+        value_ = static_cast<void*>(nullptr);
+        break;
       default:
         throw std::runtime_error("Invalid token type");
     }
@@ -190,7 +1114,7 @@ class Number : public ValueAST {
   explicit Number(Number&& number)
       : value_(std::move(number.value_)), type_(number.type_) {}
 
-  std::variant<int, double> value() const { return value_; }
+  ValueAST::Value value() const { return value_; }
 
   ValueAST::ValueType type() const { return type_; }
 
@@ -217,6 +1141,29 @@ class BinaryOperation : public ValueAST {
     MULTIPLY,
     INTEGER_DIV,
     REAL_DIV,
+    EQUAL,
+    NOT_EQUAL,
+    LESS,
+    LESS_EQUAL,
+    GREATER,
+    GREATER_EQUAL,
+    AND,
+    OR,
+
+    // left DIV 2^right, computed with a shift; made by the Optimizer
+    SHIFT_DIV,
+
+    // INTEGER IN SET
+    IN,
+    // +, *, -, =, <>, <= and >= on sets; the semantic analyzer replaces
+    // the operators of the numbers by these
+    UNION,
+    INTERSECTION,
+    DIFFERENCE,
+    SET_EQUAL,
+    SET_NOT_EQUAL,
+    SUBSET,
+    SUPERSET,
   };
 
  private:
@@ -224,6 +1171,10 @@ class BinaryOperation : public ValueAST {
   std::unique_ptr<ValueAST> right_;
   Operator op_;
 
+  // INTEGER +, -, * and DIV fail on overflow and DIV on a zero divisor,
+  // unless the range analyzer proved that they cannot
+  bool checked_ = true;
+
  public:
   explicit BinaryOperation(std::unique_ptr<ValueAST> left,
                            std::unique_ptr<ValueAST> right, Token op_token)
@@ -244,15 +1195,47 @@ class BinaryOperation : public ValueAST {
       case Token::Type::REAL_DIV:
         op_ = Operator::REAL_DIV;
         break;
+      case Token::Type::EQUAL:
+        op_ = Operator::EQUAL;
+        break;
+      case Token::Type::NOT_EQUAL:
+        op_ = Operator::NOT_EQUAL;
+        break;
+      case Token::Type::LESS:
+        op_ = Operator::LESS;
+        break;
+      case Token::Type::LESS_EQUAL:
+        op_ = Operator::LESS_EQUAL;
+        break;
+      case Token::Type::GREATER:
+        op_ = Operator::GREATER;
+        break;
+      case Token::Type::GREATER_EQUAL:
+        op_ = Operator::GREATER_EQUAL;
+        break;
+      case Token::Type::AND:
+        op_ = Operator::AND;
+        break;
+      case Token::Type::OR:
+        op_ = Operator::OR;
+        break;
+      case Token::Type::IN:
+        op_ = Operator::IN;
+        break;
       default:
         throw std::runtime_error("Invalid operator");
     }
   }
 
+  explicit BinaryOperation(std::unique_ptr<ValueAST> left,
+                           std::unique_ptr<ValueAST> right, Operator op)
+      : left_(std::move(left)), right_(std::move(right)), op_(op) {}
+
   explicit BinaryOperation(BinaryOperation&& other)
       : left_(std::move(other.left_)),
         right_(std::move(other.right_)),
-        op_(other.op_) {}
+        op_(other.op_),
+        checked_(other.checked_) {}
 
   ValueAST* left() const { return left_.get(); }
 
@@ -264,6 +1247,12 @@ class BinaryOperation : public ValueAST {
 
   Operator op() const { return op_; }
 
+  void set_op(Operator op) { op_ = op; }
+
+  bool checked() const { return checked_; }
+
+  void set_checked(bool checked) { checked_ = checked; }
+
   ValueAST::Value accept(ValueASTVisitor* visitor) const override {
     return visitor->visit(this);
   }
@@ -288,12 +1277,26 @@ class UnaryOperation : public ValueAST {
   enum class Operator {
     PLUS,
     MINUS,
+    NOT,
+    // the number of members of a set
+    CARD,
+    // the value of the operand as the type of the operation, inserted by
+    // the semantic analyzer between INTEGER, INT64 and REAL; a narrowing
+    // conversion fails when the value does not fit unless proven to
+    CONVERT,
+    // whether every element of a FILE has been read; the operand is the
+    // FILE variable
+    END_OF_FILE,
   };
 
  private:
   std::unique_ptr<ValueAST> expr_;
   Operator op_;
 
+  // INTEGER and INT64 negation fails on overflow, and a narrowing CONVERT
+  // on a value that does not fit, unless proven not to
+  bool checked_ = true;
+
  public:
   explicit UnaryOperation(std::unique_ptr<ValueAST> expr, Token op_token)
       : expr_(std::move(expr)) {
@@ -304,13 +1307,27 @@ class UnaryOperation : public ValueAST {
       case Token::Type::MINUS:
         op_ = Operator::MINUS;
         break;
+      case Token::Type::NOT:
+        op_ = Operator::NOT;
+        break;
+      case Token::Type::CARD:
+        op_ = Operator::CARD;
+        break;
+      case Token::Type::EOF_FUNCTION:
+        op_ = Operator::END_OF_FILE;
+        break;
       default:
         throw std::runtime_error("Invalid operator");
     }
   }
 
+  explicit UnaryOperation(std::unique_ptr<ValueAST> expr, Operator op)
+      : expr_(std::move(expr)), op_(op) {}
+
   explicit UnaryOperation(UnaryOperation&& other)
-      : expr_(std::move(other.expr_)), op_(other.op_) {}
+      : expr_(std::move(other.expr_)),
+        op_(other.op_),
+        checked_(other.checked_) {}
 
   ValueAST* expr() const { return expr_.get(); }
 
@@ -318,6 +1335,10 @@ class UnaryOperation : public ValueAST {
 
   Operator op() const { return op_; }
 
+  bool checked() const { return checked_; }
+
+  void set_checked(bool checked) { checked_ = checked; }
+
   ValueAST::Value accept(ValueASTVisitor* visitor) const override {
     return visitor->visit(this);
   }
@@ -335,4 +1356,55 @@ class UnaryOperation : public ValueAST {
   }
 };
 
+// [a, b..c]: the set of the listed members and ranges of members
+class SetConstructor : public ValueAST {
+ public:
+  struct Element {
+    std::unique_ptr<ValueAST> low;
+    // nullptr for a single member
+    std::unique_ptr<ValueAST> high;
+  };
+
+ private:
+  std::vector<Element> elements_;
+
+  // the value of a set of constants, computed by the semantic analyzer
+  std::optional<Set> constant_;
+
+ public:
+  explicit SetConstructor(std::vector<Element> elements)
+      : elements_(std::move(elements)) {}
+
+  explicit SetConstructor(SetConstructor&& other)
+      : elements_(std::move(other.elements_)), constant_(other.constant_) {}
+
+  const std::vector<Element>& elements() const { return elements_; }
+
+  ValueAST* low_release(size_t i) { return elements_[i].low.release(); }
+
+  void set_low(size_t i, ValueAST* low) { elements_[i].low.reset(low); }
+
+  ValueAST* high_release(size_t i) { return elements_[i].high.release(); }
+
+  void set_high(size_t i, ValueAST* high) { elements_[i].high.reset(high); }
+
+  const std::optional<Set>& constant() const { return constant_; }
+
+  void set_constant(const Set& constant) { constant_ = constant; }
+
+  ValueAST::Value accept(ValueASTVisitor* visitor) const override {
+    return visitor->visit(this);
+  }
+
+  std::pair<ValueAST*, ValueAST::ValueType> accept(
+      ValueASTChecker* checker) override {
+    return checker->check(this);
+  }
+
+  std::pair<ValueAST*, ValueType> wrap_with_type(
+      ValueAST::ValueType type) override {
+    return {new TypeChecked(type, std::move(*this)), type};
+  }
+};
+
 }  // namespace Pascal